@@ -23,14 +23,114 @@
 #pragma once
 
 #include <map>
+#include <array>
+#include <cmath>
 #include <ctime>
+#include <deque>
+#include <mutex>
 #include <atomic>
 #include <chrono>
+#include <limits>
+#include <condition_variable>
+#include <new>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#include <shared_mutex>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PROFANE_HAS_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#else
+#define PROFANE_HAS_TSC 0
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PROFANE_HAS_MMAP 1
+#define PROFANE_HAS_SIGNALS 1
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define PROFANE_HAS_MMAP 0
+#define PROFANE_HAS_SIGNALS 0
+#endif
+
+#if defined(__linux__)
+#define PROFANE_HAS_PERF_EVENTS 1
+#define PROFANE_HAS_SCHED_STATS 1
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#else
+#define PROFANE_HAS_PERF_EVENTS 0
+#define PROFANE_HAS_SCHED_STATS 0
+#endif
+
+#if PROFANE_HAS_MMAP && defined(__GNUC__)
+#define PROFANE_HAS_DLADDR 1
+#include <cxxabi.h>
+#include <dlfcn.h>
+#else
+#define PROFANE_HAS_DLADDR 0
+#endif
+
+// Stack sampling (see PerfLogger::StackSamplingInterval) is compiled in only if PROFANE_SAMPLE_STACKS is defined before including this header,
+// as it makes the program depend on timer_create() and dladdr(), i.e. on -lrt and -ldl with glibc older than 2.34.
+#if defined(PROFANE_SAMPLE_STACKS) && defined(__linux__) && PROFANE_HAS_DLADDR && (defined(__x86_64__) || defined(__aarch64__))
+#define PROFANE_HAS_STACK_SAMPLING 1
+#include <pthread.h>
+#include <ucontext.h>
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#else
+#define PROFANE_HAS_STACK_SAMPLING 0
+#endif
+
+#if defined(_MSC_VER)
+#define PROFANE_NOINLINE __declspec(noinline)
+#elif defined(__GNUC__)
+#define PROFANE_NOINLINE __attribute__((noinline))
+#else
+#define PROFANE_NOINLINE
+#endif
+
+// Mask of the categories, which may be traced at all (see IsCategoryEnabled()).
+// Traces of the other categories compile down to nothing.
+#ifndef PROFANE_COMPILED_CATEGORIES
+#define PROFANE_COMPILED_CATEGORIES (~0ull)
+#endif
+
+// Number of numeric arguments a span may carry (see PerfLogger::Tracer::Arg()), from 0 to 255.
+// Arguments are stored inline in every event, so each one adds 12 bytes to it. With 3 of them an event of ActorBasedTraits fills a cache line.
+#ifndef PROFANE_MAX_SPAN_ARGS
+#define PROFANE_MAX_SPAN_ARGS 3
+#endif
 
 namespace profane
 {
@@ -45,10 +145,371 @@ namespace profane
             obj = std::forward<OtherT>(new_value);
             return obj_copy;
         }
+
+        // Returns a process-wide unique, non-zero identifier of a tracing session.
+        inline uint64_t NextSessionId()
+        {
+            static std::atomic<uint64_t> lastSessionId = {0};
+            return ++lastSessionId;
+        }
+
+        // A file mapped to the memory of the process with its changes shared, so that whatever is stored to the memory survives a crash of the process.
+        // Pages are written back to the file by the operating system.
+        //
+        class MappedFile
+        {
+            void* m_data = nullptr;
+            size_t m_size = 0;
+
+        public:
+            MappedFile() = default;
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            ~MappedFile()
+            {
+                Unmap();
+            }
+
+            // Creates the file of the given size, filled with zeros, and maps it.
+            //
+            void Map(const std::string& path, size_t size)
+            {
+                Unmap();
+#if PROFANE_HAS_MMAP
+                const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0)
+                    throw std::runtime_error{"Cannot create file: " + path};
+
+                MapDescriptor(fd, size, true, path);
+#else
+                (void)path;
+                (void)size;
+                throw std::runtime_error{"Memory mapped files are not supported on this platform."};
+#endif
+            }
+
+            // Creates the named POSIX shared memory object of the given size, filled with zeros, and maps it.
+            // If the size is 0, the existing object is mapped as a whole instead.
+            //
+            void MapSharedMemory(const std::string& name, size_t size)
+            {
+                Unmap();
+#if PROFANE_HAS_MMAP
+                const int fd = (size != 0)
+                    ? ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600)
+                    : ::shm_open(name.c_str(), O_RDWR, 0);
+                if (fd < 0)
+                    throw std::runtime_error{"Cannot open shared memory: " + name};
+
+                struct stat status;
+                if (size == 0 && ::fstat(fd, &status) == 0)
+                    MapDescriptor(fd, static_cast<size_t>(status.st_size), false, name);
+                else
+                    MapDescriptor(fd, size, true, name);
+#else
+                (void)name;
+                (void)size;
+                throw std::runtime_error{"Shared memory is not supported on this platform."};
+#endif
+            }
+
+            void Unmap() noexcept
+            {
+#if PROFANE_HAS_MMAP
+                if (m_data != nullptr)
+                    ::munmap(m_data, m_size);
+#endif
+                m_data = nullptr;
+                m_size = 0;
+            }
+
+            char* Data() const noexcept
+            {
+                return static_cast<char*>(m_data);
+            }
+
+            size_t Size() const noexcept
+            {
+                return m_size;
+            }
+
+        private:
+#if PROFANE_HAS_MMAP
+            // Maps the open file, resizing it first if requested, and closes its descriptor.
+            //
+            void MapDescriptor(int fd, size_t size, bool resize, const std::string& name)
+            {
+                void* data = MAP_FAILED;
+                if (size != 0 && (!resize || ::ftruncate(fd, static_cast<off_t>(size)) == 0))
+                    data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                ::close(fd);
+
+                if (data == MAP_FAILED)
+                    throw std::runtime_error{"Cannot map: " + name};
+
+                m_data = data;
+                m_size = size;
+            }
+#endif
+        };
+    }
+
+    // Non-owning reference to a sequence of characters (as std::string_view is not available in C++11).
+    //
+    struct StringRef
+    {
+        const char* data;
+        size_t size;
+
+        StringRef(const char* data_, size_t size_) noexcept : data{data_}, size{size_} {}
+        StringRef(const char* text) noexcept : data{text}, size{std::strlen(text)} {}
+        StringRef(const std::string& text) noexcept : data{text.data()}, size{text.size()} {}
+
+        bool operator==(const StringRef& other) const noexcept
+        {
+            return size == other.size && (size == 0 || std::memcmp(data, other.data, size) == 0);
+        }
+    };
+
+    // Identifier of a worker routine registered in the RoutineRegistry. 0 means no routine.
+    using RoutineId = uint32_t;
+
+    // Process-wide registry of worker routine names, which lets events refer to a routine with a small integer identifier.
+    // A name is split into the worker and routine names upon registration, so no string processing is needed per event.
+    //
+    class RoutineRegistry
+    {
+    public:
+        struct Routine
+        {
+            std::string workerName;
+            std::string routineName;
+        };
+
+        // Gets notified of every newly registered routine.
+        // Notifications are made under the lock of the registry, so an observer must not register routines itself.
+        //
+        class Observer
+        {
+        public:
+            virtual void OnRoutineRegistered(RoutineId routineId, const Routine& routine) = 0;
+
+        protected:
+            ~Observer() = default;
+        };
+
+    private:
+        std::mutex m_mutex;
+        std::deque<Routine> m_routines;                         // The routine of identifier N is stored at index N - 1.
+        std::unordered_map<const char*, RoutineId> m_routineIds;
+        std::vector<Observer*> m_observers;
+
+    public:
+        static RoutineRegistry& Instance()
+        {
+            static RoutineRegistry registry;
+            return registry;
+        }
+
+        // Registers the name in form of "<workerName>.<routineName>" and returns its identifier.
+        // The name is identified by its pointer, so registering the same string literal again yields the same identifier.
+        // Repeated registrations are resolved by a thread-local cache, without locking.
+        //
+        RoutineId Register(const char* workerRoutineName)
+        {
+            static thread_local std::unordered_map<const char*, RoutineId> localRoutineIds;
+
+            const auto localFound = localRoutineIds.find(workerRoutineName);
+            if (localFound != std::end(localRoutineIds))
+                return localFound->second;
+
+            std::lock_guard<std::mutex> lock{m_mutex};
+
+            auto insertion = m_routineIds.insert(std::make_pair(workerRoutineName, RoutineId{0}));
+            if (insertion.second)
+            {
+                Routine routine;
+                SplitWorkerRoutineName(workerRoutineName, routine.workerName, routine.routineName);
+                m_routines.push_back(std::move(routine));
+                insertion.first->second = static_cast<RoutineId>(m_routines.size());
+
+                for (Observer* observer : m_observers)
+                    observer->OnRoutineRegistered(insertion.first->second, m_routines.back());
+            }
+
+            localRoutineIds.insert(*insertion.first);
+            return insertion.first->second;
+        }
+
+        const Routine& Get(RoutineId routineId)
+        {
+            assert(routineId != 0);
+            std::lock_guard<std::mutex> lock{m_mutex};
+            return m_routines[routineId - 1];
+        }
+
+        // Adds the observer and notifies it of all the routines registered so far.
+        //
+        void AddObserver(Observer* observer)
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_observers.push_back(observer);
+
+            for (size_t routineIdx = 0; routineIdx < m_routines.size(); ++routineIdx)
+                observer->OnRoutineRegistered(static_cast<RoutineId>(routineIdx + 1), m_routines[routineIdx]);
+        }
+
+        void RemoveObserver(Observer* observer)
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_observers.erase(std::remove(std::begin(m_observers), std::end(m_observers), observer), std::end(m_observers));
+        }
+
+    private:
+        // Splits an examplar string "Worker.Routine" into "Worker" and "Routine".
+        //
+        static void SplitWorkerRoutineName(const char* workerRoutineName, std::string& outWorkerName, std::string& outRoutineName)
+        {
+            using namespace std;
+            auto workerRoutineNameEnd = workerRoutineName + strlen(workerRoutineName);
+            auto finding = find(workerRoutineName, workerRoutineNameEnd, '.');
+            assert(finding != workerRoutineNameEnd && "workerRoutineName must be in form: <workerName>.<routineName>");
+            outWorkerName = string(workerRoutineName, finding);
+            outRoutineName = string(finding + 1, workerRoutineNameEnd);
+        }
+    };
+
+    // Determines which calls of a routine are traced (see SamplingRule).
+    //
+    enum class SamplingMode : uint8_t
+    {
+        None,               // Every call is traced (e.g. to exempt a routine from the rule of its worker).
+        EveryNth,           // Every N-th call is traced, starting with the first one.
+        Probabilistic,      // Every call is traced with the given probability.
+        MaxPerSecond,       // Calls are traced evenly, but no more than the given number per second and thread.
+    };
+
+    // Limits tracing of a routine of the given name, or of all the routines of the given worker.
+    // A rule for a routine takes precedence over a rule for its worker.
+    //
+    struct SamplingRule
+    {
+        std::string name;       // Either "<workerName>.<routineName>" or "<workerName>".
+        SamplingMode mode;
+        double rate;            // N for EveryNth, the probability for Probabilistic, the number of events for MaxPerSecond.
+    };
+
+    // Registers the worker routine name in the process-wide RoutineRegistry. See RoutineRegistry::Register().
+    // Intended to be called once per call site, e.g. to initialize a static local variable.
+    //
+    inline RoutineId RegisterRoutine(const char* workerRoutineName)
+    {
+        return RoutineRegistry::Instance().Register(workerRoutineName);
+    }
+
+    // Categories let the traces of whole subsystems be turned on and off.
+    // A category is a number from 0 to 63, i.e. a bit of the 64-bit mask of enabled categories, which is process-wide and initially empty.
+    //
+    using CategoryId = uint8_t;
+    using CategoryMask = uint64_t;
+
+    constexpr CategoryMask CompiledCategories = PROFANE_COMPILED_CATEGORIES;
+
+    namespace detail
+    {
+        // Static data members of a class template are defined in a header, yet they exist once per program.
+        template<typename = void>
+        struct CategoryMaskHolder
+        {
+            static std::atomic<CategoryMask> enabledCategories;
+        };
+
+        template<typename T>
+        std::atomic<CategoryMask> CategoryMaskHolder<T>::enabledCategories { 0 };
+    }
+
+    inline void SetEnabledCategories(CategoryMask categories) noexcept
+    {
+        detail::CategoryMaskHolder<>::enabledCategories.store(categories, std::memory_order_relaxed);
+    }
+
+    inline CategoryMask EnabledCategories() noexcept
+    {
+        return detail::CategoryMaskHolder<>::enabledCategories.load(std::memory_order_relaxed);
     }
 
+    // Tells whether the traces of the category are to be recorded.
+    // The category is a compile time constant, so a category out of PROFANE_COMPILED_CATEGORIES folds to false.
+    // Otherwise it costs a single relaxed load and a well predicted branch.
+    //
+    template<CategoryId Category>
+    inline bool IsCategoryEnabled() noexcept
+    {
+        static_assert(Category < 64, "A category has to be a number from 0 to 63");
+        return (CompiledCategories & (CategoryMask{1} << Category)) != 0 && (EnabledCategories() & (CategoryMask{1} << Category)) != 0;
+    }
+
+    // Numeric arguments of a span (e.g. the size of its payload), recorded inline with its event, so that nothing is formatted while tracing.
+    // Arguments are named like counters, i.e. "<groupName>.<argName>", and registered as routines (see RegisterRoutine()). Only the argument name is written to a file.
+    //
+    #pragma pack(push)
+    #pragma pack(1)
+    struct SpanArgs
+    {
+        static constexpr uint8_t Capacity = PROFANE_MAX_SPAN_ARGS;
+
+        uint8_t count;
+        std::array<RoutineId, Capacity> ids;
+        std::array<int64_t, Capacity> values;
+
+        // Returns false if there is no room for another argument.
+        //
+        bool Add(RoutineId argId, int64_t value) noexcept
+        {
+            if (count >= Capacity)
+                return false;
+
+            ids[count] = argId;
+            values[count] = value;
+            ++count;
+            return true;
+        }
+    };
+    #pragma pack(pop)
+
+    // Counters of the processor and of the kernel, which may be counted during every span (see PerfCounterActorBasedTraits).
+    //
+    enum class PerfCounter : uint8_t
+    {
+        Cycles,
+        Instructions,
+        CacheMisses,
+        TaskClock,              // Nanoseconds the thread has been running.
+        PageFaults,
+    };
+
+    constexpr uint8_t PerfCounterCount = 5;
+
+    // Masks of the counters, by bit (1 << PerfCounter).
+    constexpr uint8_t HardwarePerfCounters = 0x07;
+    constexpr uint8_t SoftwarePerfCounters = 0x18;
+    constexpr uint8_t AllPerfCounters = HardwarePerfCounters | SoftwarePerfCounters;
+
+    // Heap allocations made by a thread, counted by the allocation hooks (see AllocationTrackingTraits).
+    //
+    #pragma pack(push)
+    #pragma pack(1)
+    struct AllocationCounters
+    {
+        uint64_t allocationCount;
+        uint64_t allocatedBytes;
+    };
+    #pragma pack(pop)
+
     // A prototype of a single work item serialized to a file by the BinaryWriter, understandable by the Profane Analyser.
     // As custom PerfLogger Traits may trace any time-stamped data, finally it must fill up this structure.
+    // Worker and routine names may be given either as strings, or as an identifier of a registered routine (which is much faster to serialize).
     //
     #pragma pack(push)
     #pragma pack(1)
@@ -62,17 +523,92 @@ namespace profane
         std::string routineName;                // Name of the function or routine. (routines are stacked within a worker)
         std::string comment;                    // Additional description, comment.
         uint32_t taskId;                        // Numeric identifier of a task or a flow.
+        RoutineId routineId;                    // If not 0, it overrides workerName and routineName.
+        uint8_t flags;                          // Combination of WorkItemFlags.
+        SpanArgs args;                          // Numeric arguments of the span. Their names are always given by identifiers of registered routines.
+        uint8_t perfCounterMask;                // Counters counted during the span, by bit (1 << PerfCounter).
+        uint64_t perfCounters[PerfCounterCount];    // Increments of the counters during the span, by PerfCounter.
+        uint64_t allocationCount;               // Heap allocations made by the thread during the span, if flagged with WorkItemFlags::Allocations.
+        uint64_t allocatedBytes;
+        uint64_t cpuTimeNs;                     // CPU time consumed by the thread during the span, if flagged with WorkItemFlags::CpuTime.
+        uint16_t startCpu;                      // CPUs the thread has run on at the start and at the stop of the span, if flagged with WorkItemFlags::Scheduling.
+        uint16_t stopCpu;
+        uint32_t voluntarySwitches;             // Context switches of the thread during the span, upon blocking and upon being preempted.
+        uint32_t involuntarySwitches;
     };
     #pragma pack(pop)
 
+    namespace WorkItemFlags
+    {
+        // The work item is an asynchronous span of a task (see PerfLogger::AsyncSpan), rather than a call on the stack of its worker.
+        constexpr uint8_t Async = 0x01;
+
+        // The heap allocations of the work item have been counted (see AllocationTrackingTraits), even if there were none.
+        constexpr uint8_t Allocations = 0x02;
+
+        // The work item is a wait of a thread for a lock traced by TracedMutex or TracedSharedMutex. Its routine names the waiting thread.
+        constexpr uint8_t LockWait = 0x04;
+
+        // The work item is a hold of a lock traced by TracedMutex or TracedSharedMutex, either exclusive or shared.
+        constexpr uint8_t LockHold = 0x08;
+
+        // The CPU time of the thread during the work item has been measured (see ThreadCpuTimeTraits), even if it was 0.
+        constexpr uint8_t CpuTime = 0x10;
+
+        // The CPUs of the work item and the context switches during it have been recorded (see SchedulingTraits).
+        constexpr uint8_t Scheduling = 0x20;
+
+        // Flags of the work items carrying metrics (see bin::WorkItemMetrics), beside the ones of any counted performance counters.
+        constexpr uint8_t Metrics = Allocations | CpuTime | Scheduling;
+    }
+
     namespace bin
     {
         // The version of binary format. It is written to the manifest section of a file.
-        constexpr uint32_t FormatVersion = 3;
+        constexpr uint32_t FormatVersion = 4;
+
+        // The oldest version of binary format, which is still read (see namespace v3).
+        constexpr uint32_t OldestFormatVersion = 3;
 
         // The string index within a dictionary (which is an array of strings). An index of 0 is always an empty string.
         using StringIdx = uint32_t;
 
+        // Maximal number of frames of a stack sample. Frames beyond it, i.e. the outermost ones, are cut off.
+        constexpr uint32_t StackSampleMaxDepth = 32;
+
+        // Number of duration buckets of a routine aggregate (see RoutineAggregate).
+        // Every power of 2 is split into 4 buckets, so a bucket spans at most a quarter of its lower bound.
+        // The last bucket takes all the durations from 7 * 2^46 ticks up, i.e. about 2 days of a 3 GHz clock.
+        constexpr uint32_t DurationBucketCount = 192;
+
+        // Returns the bucket of the duration given in clock ticks. Durations below 4 ticks get buckets of their own.
+        //
+        inline uint32_t DurationBucketOf(uint64_t ticks) noexcept
+        {
+            if (ticks < 4)
+                return static_cast<uint32_t>(ticks);
+
+#if defined(__GNUC__)
+            const auto log2 = static_cast<uint32_t>(63 - __builtin_clzll(ticks));
+#else
+            uint32_t log2 = 0;
+            for (uint64_t rest = ticks >> 1; rest != 0; rest >>= 1)
+                ++log2;
+#endif
+            const auto bucketIdx = 4 * (log2 - 1) + static_cast<uint32_t>((ticks >> (log2 - 2)) & 3);
+            return std::min(bucketIdx, DurationBucketCount - 1);
+        }
+
+        // Returns the shortest duration in clock ticks, which falls into the bucket.
+        //
+        inline uint64_t DurationBucketLowerBound(uint32_t bucketIdx) noexcept
+        {
+            if (bucketIdx < 4)
+                return bucketIdx;
+
+            return (uint64_t{4} + (bucketIdx & 3)) << (bucketIdx / 4 - 1);
+        }
+
         #pragma pack(push)
         #pragma pack(1)
         struct FileHeader
@@ -84,10 +620,20 @@ namespace profane
         };
         static_assert(sizeof(FileHeader) == 128, "profane::bin::FileHeader is expected to be 128 bytes long");
 
+        enum class SectionType : uint32_t
+        {
+            Manifest,
+            WorkItemArray,
+            CounterSampleArray,
+            StackSampleArray,
+            RoutineAggregateArray,
+        };
+
         struct SectionHeader
         {
             uint64_t dictionaryPos;
             uint64_t nextSectionPos;
+            SectionType sectionType;
         };
 
         struct ManifestSection : public SectionHeader
@@ -96,6 +642,10 @@ namespace profane
             StringIdx programNameIdx;
             StringIdx descriptionIdx;
             uint64_t dateTime;
+            uint64_t routineStatsPos;       // Position of the routine statistics table written upon finish, or -1 if there is none.
+            uint64_t minSpanDurationNs;     // Work items shorter than that have been dropped (see RoutineStats::droppedCount).
+            uint64_t spanOverheadNs;        // Duration added by the tracer to the parent of every work item, or 0 if unknown.
+            uint64_t droppedEventCount;     // Events lost by the tracer, as it has run out of free chunks (see FileContent::droppedEventCount).
         };
 
         struct WorkItemArraySectionHeader : public SectionHeader
@@ -109,6 +659,7 @@ namespace profane
             StringIdx routineNameIdxBase;
             StringIdx commentNameIdxBase;
             uint32_t taskIdBase;
+            uint8_t flagsBase;
 
             // Byte sizes of individual attributes (from 0 to 8).
             // 0 means that the attribute is not encoded at all.
@@ -119,6 +670,91 @@ namespace profane
             uint8_t routineNameIdxSize : 4;
             uint8_t commentNameIdxSize : 4;
             uint8_t taskIdSize : 4;
+            uint8_t flagsSize : 4;
+
+            // The span arguments take the column of their count per work item, followed by the columns of the name index and of the value
+            // (with its sign bit flipped) per argument. A section of no arguments takes just the count column of size 0.
+            uint8_t argCountBase;
+            StringIdx argNameIdxBase;
+            uint64_t argValueBase;
+            uint8_t argCountSize;
+            uint8_t argNameIdxSize;
+            uint8_t argValueSize;
+
+            // The metrics take the column of their presence per work item, followed by the columns of the metrics of the work items having them.
+            // Among them, the mask of the counted performance counters is followed by a column per counter.
+            uint8_t hasMetricsBase;
+            uint8_t hasMetricsSize;
+            uint64_t cpuTimeNsBase;
+            uint8_t cpuTimeNsSize;
+            uint8_t perfCounterMaskBase;
+            uint8_t perfCounterMaskSize;
+            uint64_t perfCounterBase[PerfCounterCount];
+            uint8_t perfCounterSize[PerfCounterCount];
+
+            uint64_t allocationCountBase;
+            uint64_t allocatedBytesBase;
+            uint8_t allocationCountSize;
+            uint8_t allocatedBytesSize;
+
+            uint16_t startCpuBase;
+            uint16_t stopCpuBase;
+            uint32_t voluntarySwitchesBase;
+            uint32_t involuntarySwitchesBase;
+            uint8_t startCpuSize;
+            uint8_t stopCpuSize;
+            uint8_t voluntarySwitchesSize;
+            uint8_t involuntarySwitchesSize;
+        };
+
+        struct CounterSampleArraySectionHeader : public SectionHeader
+        {
+            uint32_t sampleCount;
+
+            uint64_t timeNsBase;
+            uint64_t valueBase;                 // Values are stored with their sign bit flipped, so that they are ordered as unsigned integers.
+            StringIdx counterGroupNameIdxBase;
+            StringIdx counterNameIdxBase;
+
+            // Byte sizes of individual attributes (from 0 to 8).
+            uint8_t timeNsSize : 4;
+            uint8_t valueSize : 4;
+            uint8_t counterGroupNameIdxSize : 4;
+            uint8_t counterNameIdxSize : 4;
+        };
+
+        // Every stack sample is packed as: time, worker name, uint8_t frame count, frame names.
+        struct StackSampleArraySectionHeader : public SectionHeader
+        {
+            uint32_t sampleCount;
+
+            uint64_t timeNsBase;
+            StringIdx workerNameIdxBase;
+            StringIdx frameNameIdxBase;
+
+            // Byte sizes of individual attributes (from 0 to 8).
+            uint8_t timeNsSize : 4;
+            uint8_t workerNameIdxSize : 4;
+            uint8_t frameNameIdxSize : 4;
+        };
+
+        // Every routine aggregate is written as RoutineAggregateRecord, followed by bucketCount pairs of: uint8_t bucket index, uint64_t call count.
+        struct RoutineAggregateArraySectionHeader : public SectionHeader
+        {
+            uint32_t routineCount;
+            uint64_t unaggregatedSpanCount;     // Spans, which the tracer has failed to aggregate (see FileContent::unaggregatedSpanCount).
+        };
+
+        struct RoutineAggregateRecord
+        {
+            StringIdx workerNameIdx;
+            StringIdx routineNameIdx;
+            uint64_t callCount;
+            uint64_t totalDurationNs;
+            uint64_t minDurationNs;
+            uint64_t maxDurationNs;
+            double nsPerTick;
+            uint8_t bucketCount;        // Number of the nonempty buckets following the record.
         };
 
         struct WorkItem
@@ -130,9 +766,170 @@ namespace profane
             StringIdx routineNameIdx;
             StringIdx commentNameIdx;
             uint32_t taskId;
+            uint8_t flags;              // Combination of WorkItemFlags.
+            uint8_t argCount;           // Number of the span arguments, which start at FileContent::spanArgs[argsIdx].
+            uint32_t argsIdx;
+            uint32_t metricsIdx;        // Index of the metrics in FileContent::workItemMetrics, or NoMetrics.
+        };
+
+        constexpr uint32_t NoMetrics = std::numeric_limits<uint32_t>::max();
+
+        // Measurements of a work item beside its time, kept apart from the work items, as most of them have none.
+        struct WorkItemMetrics
+        {
+            uint8_t perfCounterMask;                    // Counters counted during the span, by bit (1 << PerfCounter).
+            uint64_t perfCounters[PerfCounterCount];    // Increments of the counters during the span, 0 for the counters not counted.
+            uint64_t allocationCount;                   // Heap allocations made during the span, if flagged with WorkItemFlags::Allocations.
+            uint64_t allocatedBytes;
+            uint64_t cpuTimeNs;                         // CPU time of the thread during the span, if flagged with WorkItemFlags::CpuTime.
+            uint16_t startCpu;                          // CPUs at the start and at the stop of the span, if flagged with WorkItemFlags::Scheduling.
+            uint16_t stopCpu;
+            uint32_t voluntarySwitches;                 // Context switches of the thread during the span.
+            uint32_t involuntarySwitches;
+        };
+
+        // Copies the metrics of the prototype, returning whether it has any.
+        //
+        template<typename Clock>
+        bool MetricsOf(const WorkItemProto<Clock>& workItemProto, WorkItemMetrics& metrics)
+        {
+            if ((workItemProto.flags & WorkItemFlags::Metrics) == 0 && workItemProto.perfCounterMask == 0)
+                return false;
+
+            metrics.perfCounterMask = workItemProto.perfCounterMask;
+            std::memcpy(metrics.perfCounters, workItemProto.perfCounters, sizeof(metrics.perfCounters));
+            metrics.allocationCount = workItemProto.allocationCount;
+            metrics.allocatedBytes = workItemProto.allocatedBytes;
+            metrics.cpuTimeNs = workItemProto.cpuTimeNs;
+            metrics.startCpu = workItemProto.startCpu;
+            metrics.stopCpu = workItemProto.stopCpu;
+            metrics.voluntarySwitches = workItemProto.voluntarySwitches;
+            metrics.involuntarySwitches = workItemProto.involuntarySwitches;
+            return true;
+        }
+
+        // A numeric argument of a work item (see SpanArgs), kept apart from the work items, as most of them have none.
+        struct SpanArg
+        {
+            StringIdx nameIdx;
+            int64_t value;
+        };
+
+        // Calls of a routine not present in the work items, which let the statistics of the routine be completed.
+        // Statistics of a sampled routine are scaled up by the ratio of its calls to its traced calls.
+        // Dropped calls have been traced, but they have been too short to be written as work items.
+        struct RoutineStats
+        {
+            StringIdx workerNameIdx;
+            StringIdx routineNameIdx;
+            SamplingMode samplingMode;
+            double samplingRate;        // SamplingRule::rate
+            uint64_t callCount;         // Number of calls of the routine (if sampled).
+            uint64_t tracedCount;       // Number of calls chosen for tracing (if sampled).
+            uint64_t droppedCount;      // Number of traced calls shorter than ManifestSection::minSpanDurationNs.
+            uint64_t droppedDurationNs; // Total duration of the dropped calls.
+        };
+
+        // A value of a counter (e.g. a queue depth) at a point of time.
+        // Counters are named like routines, i.e. "<counterGroupName>.<counterName>".
+        struct CounterSample
+        {
+            uint64_t timeNs;
+            StringIdx counterGroupNameIdx;
+            StringIdx counterNameIdx;
+            int64_t value;
+        };
+
+        // The stack of a thread interrupted by the stack sampler, attributed to the worker of the innermost work item open at the time.
+        // Frames are named after the functions, the leaf (i.e. the interrupted one) first.
+        struct StackSample
+        {
+            uint64_t timeNs;
+            StringIdx workerNameIdx;
+            uint8_t frameCount;
+            StringIdx frameNameIdxs[StackSampleMaxDepth];
         };
         #pragma pack(pop)
 
+        // Sections of the version 3 of binary format, which all are work item arrays of no other columns than those of v3::WorkItemArraySectionHeader.
+        // Its manifest puts formatVersion where later versions put SectionHeader::sectionType (which is 0 in their manifest).
+        namespace v3
+        {
+            #pragma pack(push)
+            #pragma pack(1)
+            struct SectionHeader
+            {
+                uint64_t dictionaryPos;
+                uint64_t nextSectionPos;
+            };
+
+            struct ManifestSection : public SectionHeader
+            {
+                uint32_t formatVersion;
+                StringIdx programNameIdx;
+                StringIdx descriptionIdx;
+                uint64_t dateTime;
+            };
+
+            struct WorkItemArraySectionHeader : public SectionHeader
+            {
+                uint32_t workItemCount;
+
+                uint64_t startTimeNsBase;
+                uint64_t durationTimeNsBase;
+                StringIdx categoryNameIdxBase;
+                StringIdx workerNameIdxBase;
+                StringIdx routineNameIdxBase;
+                StringIdx commentNameIdxBase;
+                uint32_t taskIdBase;
+
+                uint8_t startTimeNsSize : 4;
+                uint8_t durationTimeNsSize : 4;
+                uint8_t categoryNameIdxSize : 4;
+                uint8_t workerNameIdxSize : 4;
+                uint8_t routineNameIdxSize : 4;
+                uint8_t commentNameIdxSize : 4;
+                uint8_t taskIdSize : 4;
+            };
+            #pragma pack(pop)
+        }
+
+        // Durations of the calls of a routine, aggregated by the tracer instead of writing their work items (see RecordingMode::Aggregate).
+        // Calls are counted by their durations in clock ticks (see DurationBucketOf()), which nsPerTick converts to nanoseconds.
+        struct RoutineAggregate
+        {
+            StringIdx workerNameIdx;
+            StringIdx routineNameIdx;
+            uint64_t callCount;
+            uint64_t totalDurationNs;
+            uint64_t minDurationNs;
+            uint64_t maxDurationNs;
+            double nsPerTick;
+            uint64_t bucketCounts[DurationBucketCount];
+        };
+
+        // Header of the event buffer file, which backs the event pool of a PerfLogger if PerfLogger::EventBufferFilePath is set.
+        // It is followed by the journal of the routine names and by the events in their in-memory layout, so that they survive a crash of the process.
+        // Routine names are journaled as records of: RoutineId, uint8_t size, worker name, uint8_t size, routine name.
+        //
+        struct EventBufferHeader
+        {
+            char headerText[64] = "PROFANE Event Buffer\n";
+            uint32_t formatVersion = FormatVersion;
+            uint32_t eventSize = 0;                             // sizeof(PerfLogger<Traits>::Event), which tells apart the buffers of different traits.
+            uint32_t eventCount = 0;
+            uint32_t chunkSize = 0;
+            std::atomic<uint32_t> claimedChunkCount = {0};      // Chunks of the event pool claimed so far. The further ones hold no events.
+            std::atomic<uint32_t> routineNamesSize = {0};       // Bytes of the routine name journal written so far.
+            uint64_t routineNamesPos = 0;
+            uint64_t routineNamesCapacity = 0;
+            uint64_t eventsPos = 0;
+            int64_t clockBaseTicks = 0;                         // Clock reading corresponding to clockBaseNs.
+            int64_t clockBaseNs = 0;
+            double clockNsPerTick = 1.0;
+            char programName[128] = {};
+        };
+
         struct FileContent
         {
             struct Issue
@@ -144,7 +941,17 @@ namespace profane
             std::vector<std::string> dictionary { "" };     // String at index 0 in the dictionary is always an empty string.
             StringIdx programNameIdx = 0;
             StringIdx descriptionIdx = 0;
+            uint64_t minSpanDurationNs = 0;
+            uint64_t spanOverheadNs = 0;
+            uint64_t droppedEventCount = 0;                 // Events lost by the tracer for want of room in its event pool, totalled over its threads.
             std::vector<WorkItem> workItems;
+            std::vector<SpanArg> spanArgs;                  // Arguments of all the work items (see WorkItem::argsIdx).
+            std::vector<WorkItemMetrics> workItemMetrics;   // Metrics of the work items having them (see WorkItem::metricsIdx).
+            std::vector<CounterSample> counterSamples;
+            std::vector<StackSample> stackSamples;
+            std::vector<RoutineStats> routineStats;
+            std::vector<RoutineAggregate> routineAggregates;
+            uint64_t unaggregatedSpanCount = 0;             // Spans left out of routineAggregates, e.g. of no routine identifier.
             std::vector<Issue> issues;
         };
 
@@ -182,9 +989,10 @@ namespace profane
                 if (m_max == 0)
                     m_base = 0;
 
-                auto valueRange = m_max - m_base;
+                uint64_t valueRange = m_max - m_base;
 
-                if (ZeroIsAbsolute && valueRange > 0)
+                // Non-zero values are packed off by one, so even a single distinct value takes a byte.
+                if (ZeroIsAbsolute && m_max > 0)
                     ++valueRange;
 
                 uint64_t fullByteValue = 0;
@@ -285,25 +1093,82 @@ namespace profane
 
             in.seekg(std::streamoff{sizeof(FileHeader)}, std::ios::beg);
 
-            ManifestSection manifest;
-            in.read(reinterpret_cast<char*>(&manifest), sizeof(manifest));
-            content.programNameIdx = manifest.programNameIdx;
-            content.descriptionIdx = manifest.descriptionIdx;
+            v3::ManifestSection v3Manifest {};
+            in.read(reinterpret_cast<char*>(&v3Manifest), sizeof(v3Manifest));
 
-            readDictionary(manifest.dictionaryPos);
+            // The columns missing from the older files are left with their defaults (i.e. no flags, arguments nor metrics).
+            if (in && v3Manifest.formatVersion == OldestFormatVersion)
+            {
+                content.programNameIdx = v3Manifest.programNameIdx;
+                content.descriptionIdx = v3Manifest.descriptionIdx;
 
-            std::streampos sectionPos = manifest.nextSectionPos;
+                readDictionary(v3Manifest.dictionaryPos);
 
-            while (sectionPos != -1)
-            {
-                in.seekg(sectionPos);
+                std::streampos sectionPos = v3Manifest.nextSectionPos;
+
+                while (sectionPos != -1)
+                {
+                    in.seekg(sectionPos);
+
+                    v3::WorkItemArraySectionHeader section {};
+                    in.read(reinterpret_cast<char*>(&section), sizeof(section));
+
+                    if (!in || section.workItemCount == 0)
+                        break;
+
+                    content.workItems.reserve(content.workItems.size() + section.workItemCount);
+
+                    IntBitUnpacker<uint64_t, false> startTimeNsUnpacker { section.startTimeNsBase, section.startTimeNsSize };
+                    IntBitUnpacker<uint64_t, false> durationNsPacker { section.durationTimeNsBase, section.durationTimeNsSize };
+                    IntBitUnpacker<StringIdx, true> categoryNameIdxPacker { section.categoryNameIdxBase, section.categoryNameIdxSize };
+                    IntBitUnpacker<StringIdx, true> workerNameIdxPacker { section.workerNameIdxBase, section.workerNameIdxSize };
+                    IntBitUnpacker<StringIdx, true> routineNameIdxPacker { section.routineNameIdxBase, section.routineNameIdxSize };
+                    IntBitUnpacker<StringIdx, true> commentNameIdxPacker { section.commentNameIdxBase, section.commentNameIdxSize };
+                    IntBitUnpacker<uint32_t, false> taskIdPacker { section.taskIdBase, section.taskIdSize };
+
+                    for (uint32_t workItemIdx = 0; workItemIdx < section.workItemCount; ++workItemIdx)
+                    {
+                        WorkItem workItem {};
+                        workItem.startTimeNs = startTimeNsUnpacker.Unpack(in);
+                        workItem.stopTimeNs = workItem.startTimeNs + durationNsPacker.Unpack(in);
+                        workItem.categoryNameIdx = categoryNameIdxPacker.Unpack(in);
+                        workItem.workerNameIdx = workerNameIdxPacker.Unpack(in);
+                        workItem.routineNameIdx = routineNameIdxPacker.Unpack(in);
+                        workItem.commentNameIdx = commentNameIdxPacker.Unpack(in);
+                        workItem.taskId = taskIdPacker.Unpack(in);
+                        workItem.metricsIdx = NoMetrics;
+                        content.workItems.push_back(workItem);
+                    }
+
+                    readDictionary(section.dictionaryPos);
+
+                    sectionPos = section.nextSectionPos;
+                }
+
+                return content;
+            }
+
+            in.clear();
+            in.seekg(std::streamoff{sizeof(FileHeader)}, std::ios::beg);
+
+            ManifestSection manifest;
+            in.read(reinterpret_cast<char*>(&manifest), sizeof(manifest));
+
+            if (!in || manifest.formatVersion != FormatVersion)
+                throw std::runtime_error("Unsupported format version of the performance log (expected " + std::to_string(OldestFormatVersion) + " to " + std::to_string(FormatVersion) + ")");
+
+            content.programNameIdx = manifest.programNameIdx;
+            content.descriptionIdx = manifest.descriptionIdx;
+            content.minSpanDurationNs = manifest.minSpanDurationNs;
+            content.spanOverheadNs = manifest.spanOverheadNs;
+            content.droppedEventCount = manifest.droppedEventCount;
 
+            readDictionary(manifest.dictionaryPos);
+
+            auto readWorkItemArraySection = [&]() {
                 WorkItemArraySectionHeader section {};
                 in.read(reinterpret_cast<char*>(&section), sizeof(section));
 
-                if (section.workItemCount == 0)
-                    break;
-
                 const auto origWorkItemCount = content.workItems.size();
                 content.workItems.reserve(origWorkItemCount + section.workItemCount);
 
@@ -314,48 +1179,359 @@ namespace profane
                 IntBitUnpacker<StringIdx, true> routineNameIdxPacker { section.routineNameIdxBase, section.routineNameIdxSize };
                 IntBitUnpacker<StringIdx, true> commentNameIdxPacker { section.commentNameIdxBase, section.commentNameIdxSize };
                 IntBitUnpacker<uint32_t, false> taskIdPacker { section.taskIdBase, section.taskIdSize };
+                IntBitUnpacker<uint8_t, false> flagsPacker { section.flagsBase, section.flagsSize };
+
+                IntBitUnpacker<uint8_t, false> argCountUnpacker { section.argCountBase, section.argCountSize };
+                IntBitUnpacker<StringIdx, true> argNameIdxUnpacker { section.argNameIdxBase, section.argNameIdxSize };
+                IntBitUnpacker<uint64_t, false> argValueUnpacker { section.argValueBase, section.argValueSize };
+
+                IntBitUnpacker<uint8_t, false> hasMetricsUnpacker { section.hasMetricsBase, section.hasMetricsSize };
+                IntBitUnpacker<uint64_t, false> cpuTimeNsUnpacker { section.cpuTimeNsBase, section.cpuTimeNsSize };
+                IntBitUnpacker<uint8_t, false> perfCounterMaskUnpacker { section.perfCounterMaskBase, section.perfCounterMaskSize };
+                std::vector<IntBitUnpacker<uint64_t, false>> perfCounterUnpackers;
+                for (uint8_t counterIdx = 0; counterIdx < PerfCounterCount; ++counterIdx)
+                    perfCounterUnpackers.emplace_back(section.perfCounterBase[counterIdx], section.perfCounterSize[counterIdx]);
+
+                IntBitUnpacker<uint64_t, false> allocationCountUnpacker { section.allocationCountBase, section.allocationCountSize };
+                IntBitUnpacker<uint64_t, false> allocatedBytesUnpacker { section.allocatedBytesBase, section.allocatedBytesSize };
+                IntBitUnpacker<uint16_t, false> startCpuUnpacker { section.startCpuBase, section.startCpuSize };
+                IntBitUnpacker<uint16_t, false> stopCpuUnpacker { section.stopCpuBase, section.stopCpuSize };
+                IntBitUnpacker<uint32_t, false> voluntarySwitchesUnpacker { section.voluntarySwitchesBase, section.voluntarySwitchesSize };
+                IntBitUnpacker<uint32_t, false> involuntarySwitchesUnpacker { section.involuntarySwitchesBase, section.involuntarySwitchesSize };
 
                 for (uint32_t workItemIdx = 0; workItemIdx < section.workItemCount; ++workItemIdx)
                 {
                     const auto startTimeNs = startTimeNsUnpacker.Unpack(in);
 
-                    auto workItem = WorkItem{
-                        startTimeNs,
-                        startTimeNs + durationNsPacker.Unpack(in),
-                        categoryNameIdxPacker.Unpack(in),
-                        workerNameIdxPacker.Unpack(in),
-                        routineNameIdxPacker.Unpack(in),
-                        commentNameIdxPacker.Unpack(in),
-                        taskIdPacker.Unpack(in)
-                    };
+                    const auto stopTimeNs = startTimeNs + durationNsPacker.Unpack(in);
+
+                    WorkItem workItem {};
+                    workItem.startTimeNs = startTimeNs;
+                    workItem.stopTimeNs = stopTimeNs;
+                    workItem.categoryNameIdx = categoryNameIdxPacker.Unpack(in);
+                    workItem.workerNameIdx = workerNameIdxPacker.Unpack(in);
+                    workItem.routineNameIdx = routineNameIdxPacker.Unpack(in);
+                    workItem.commentNameIdx = commentNameIdxPacker.Unpack(in);
+                    workItem.taskId = taskIdPacker.Unpack(in);
+                    workItem.flags = flagsPacker.Unpack(in);
+
+                    workItem.argCount = argCountUnpacker.Unpack(in);
+                    workItem.argsIdx = static_cast<uint32_t>(content.spanArgs.size());
+                    for (uint8_t argIdx = 0; argIdx < workItem.argCount; ++argIdx)
+                    {
+                        SpanArg arg;
+                        arg.nameIdx = argNameIdxUnpacker.Unpack(in);
+                        arg.value = static_cast<int64_t>(argValueUnpacker.Unpack(in) ^ (uint64_t{1} << 63));
+                        content.spanArgs.push_back(arg);
+                    }
+
+                    workItem.metricsIdx = NoMetrics;
+                    if (hasMetricsUnpacker.Unpack(in) != 0)
+                    {
+                        WorkItemMetrics metrics;
+                        metrics.cpuTimeNs = cpuTimeNsUnpacker.Unpack(in);
+                        metrics.perfCounterMask = perfCounterMaskUnpacker.Unpack(in);
+                        for (uint8_t counterIdx = 0; counterIdx < PerfCounterCount; ++counterIdx)
+                            metrics.perfCounters[counterIdx] = perfCounterUnpackers[counterIdx].Unpack(in);
+
+                        metrics.allocationCount = allocationCountUnpacker.Unpack(in);
+                        metrics.allocatedBytes = allocatedBytesUnpacker.Unpack(in);
+                        metrics.startCpu = startCpuUnpacker.Unpack(in);
+                        metrics.stopCpu = stopCpuUnpacker.Unpack(in);
+                        metrics.voluntarySwitches = voluntarySwitchesUnpacker.Unpack(in);
+                        metrics.involuntarySwitches = involuntarySwitchesUnpacker.Unpack(in);
+
+                        workItem.metricsIdx = static_cast<uint32_t>(content.workItemMetrics.size());
+                        content.workItemMetrics.push_back(metrics);
+                    }
+
+                    content.workItems.push_back(workItem);
+                }
+            };
+
+            auto readCounterSampleArraySection = [&]() {
+                CounterSampleArraySectionHeader section {};
+                in.read(reinterpret_cast<char*>(&section), sizeof(section));
+
+                content.counterSamples.reserve(content.counterSamples.size() + section.sampleCount);
+
+                IntBitUnpacker<uint64_t, false> timeNsUnpacker { section.timeNsBase, section.timeNsSize };
+                IntBitUnpacker<uint64_t, false> valueUnpacker { section.valueBase, section.valueSize };
+                IntBitUnpacker<StringIdx, true> counterGroupNameIdxUnpacker { section.counterGroupNameIdxBase, section.counterGroupNameIdxSize };
+                IntBitUnpacker<StringIdx, true> counterNameIdxUnpacker { section.counterNameIdxBase, section.counterNameIdxSize };
+
+                for (uint32_t sampleIdx = 0; sampleIdx < section.sampleCount; ++sampleIdx)
+                {
+                    CounterSample sample;
+                    sample.timeNs = timeNsUnpacker.Unpack(in);
+                    sample.value = static_cast<int64_t>(valueUnpacker.Unpack(in) ^ (uint64_t{1} << 63));
+                    sample.counterGroupNameIdx = counterGroupNameIdxUnpacker.Unpack(in);
+                    sample.counterNameIdx = counterNameIdxUnpacker.Unpack(in);
+                    content.counterSamples.push_back(sample);
+                }
+            };
+
+            auto readStackSampleArraySection = [&]() {
+                StackSampleArraySectionHeader section {};
+                in.read(reinterpret_cast<char*>(&section), sizeof(section));
+
+                content.stackSamples.reserve(content.stackSamples.size() + section.sampleCount);
+
+                IntBitUnpacker<uint64_t, false> timeNsUnpacker { section.timeNsBase, section.timeNsSize };
+                IntBitUnpacker<StringIdx, true> workerNameIdxUnpacker { section.workerNameIdxBase, section.workerNameIdxSize };
+                IntBitUnpacker<StringIdx, true> frameNameIdxUnpacker { section.frameNameIdxBase, section.frameNameIdxSize };
+
+                for (uint32_t sampleIdx = 0; sampleIdx < section.sampleCount; ++sampleIdx)
+                {
+                    StackSample sample {};
+                    sample.timeNs = timeNsUnpacker.Unpack(in);
+                    sample.workerNameIdx = workerNameIdxUnpacker.Unpack(in);
+                    in.read(reinterpret_cast<char*>(&sample.frameCount), sizeof(sample.frameCount));
+
+                    // Frames beyond the capacity of this reader are skipped.
+                    for (uint8_t frameIdx = 0; frameIdx < sample.frameCount; ++frameIdx)
+                    {
+                        const auto frameNameIdx = frameNameIdxUnpacker.Unpack(in);
+                        if (frameIdx < StackSampleMaxDepth)
+                            sample.frameNameIdxs[frameIdx] = frameNameIdx;
+                    }
+
+                    sample.frameCount = static_cast<uint8_t>(std::min<uint32_t>(sample.frameCount, StackSampleMaxDepth));
+                    content.stackSamples.push_back(sample);
+                }
+            };
+
+            auto readRoutineAggregateArraySection = [&]() {
+                RoutineAggregateArraySectionHeader section {};
+                in.read(reinterpret_cast<char*>(&section), sizeof(section));
+
+                content.routineAggregates.reserve(content.routineAggregates.size() + section.routineCount);
+                content.unaggregatedSpanCount += section.unaggregatedSpanCount;
+
+                for (uint32_t routineIdx = 0; routineIdx < section.routineCount; ++routineIdx)
+                {
+                    RoutineAggregateRecord record {};
+                    in.read(reinterpret_cast<char*>(&record), sizeof(record));
+
+                    RoutineAggregate aggregate {};
+                    aggregate.workerNameIdx = record.workerNameIdx;
+                    aggregate.routineNameIdx = record.routineNameIdx;
+                    aggregate.callCount = record.callCount;
+                    aggregate.totalDurationNs = record.totalDurationNs;
+                    aggregate.minDurationNs = record.minDurationNs;
+                    aggregate.maxDurationNs = record.maxDurationNs;
+                    aggregate.nsPerTick = record.nsPerTick;
+
+                    for (uint8_t idx = 0; idx < record.bucketCount; ++idx)
+                    {
+                        uint8_t bucketIdx = 0;
+                        uint64_t callCount = 0;
+                        in.read(reinterpret_cast<char*>(&bucketIdx), sizeof(bucketIdx));
+                        in.read(reinterpret_cast<char*>(&callCount), sizeof(callCount));
+                        aggregate.bucketCounts[std::min<uint32_t>(bucketIdx, DurationBucketCount - 1)] += callCount;
+                    }
+
+                    content.routineAggregates.push_back(aggregate);
+                }
+            };
+
+            std::streampos sectionPos = manifest.nextSectionPos;
+
+            while (sectionPos != -1)
+            {
+                in.seekg(sectionPos);
+
+                SectionHeader header {};
+                in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+                if (!in)
+                    break;
+
+                in.seekg(sectionPos);
+
+                switch (header.sectionType)
+                {
+                    case SectionType::WorkItemArray:
+                        readWorkItemArraySection();
+                        break;
+
+                    case SectionType::CounterSampleArray:
+                        readCounterSampleArraySection();
+                        break;
 
-                    content.workItems.push_back(std::move(workItem));
+                    case SectionType::StackSampleArray:
+                        readStackSampleArraySection();
+                        break;
+
+                    case SectionType::RoutineAggregateArray:
+                        readRoutineAggregateArraySection();
+                        break;
+
+                    default:
+                        content.issues.push_back(FileContent::Issue{"unknown-section", "Skipped a section of unknown type " + std::to_string(static_cast<uint32_t>(header.sectionType))});
+                        break;
                 }
 
-                readDictionary(section.dictionaryPos);
+                // The dictionary of an unfinished section is not written (e.g. when the program has crashed in the streaming mode).
+                if (header.dictionaryPos == static_cast<uint64_t>(-1))
+                    break;
+
+                readDictionary(header.dictionaryPos);
+
+                sectionPos = header.nextSectionPos;
+            }
+
+            if (manifest.routineStatsPos != static_cast<uint64_t>(-1))
+            {
+                in.seekg(static_cast<std::streamoff>(manifest.routineStatsPos));
+
+                uint32_t routineStatsCount = 0;
+                in.read(reinterpret_cast<char*>(&routineStatsCount), sizeof(routineStatsCount));
 
-                sectionPos = section.nextSectionPos;
+                content.routineStats.resize(routineStatsCount);
+                if (routineStatsCount > 0)
+                    in.read(reinterpret_cast<char*>(&content.routineStats.front()), routineStatsCount * sizeof(RoutineStats));
             }
 
             return content;
         };
 
+        // Dictionary assigning consecutive indices to distinct strings. The index 0 is always an empty string.
+        // Strings are stored back to back in a single character buffer and looked up with an open addressing hash table,
+        // so indexing a string which is already in the dictionary does not allocate.
+        // The names of registered routines are not even looked up, as BinaryWriter caches their indices by the routine identifier.
+        //
+        class StringDictionary
+        {
+            struct Entry
+            {
+                size_t offset;          // Offset of the string in the character buffer.
+                uint32_t size;
+                uint32_t hash;
+            };
+
+            std::vector<char> m_chars;
+            std::vector<Entry> m_entries { Entry{0, 0, 0} };
+            std::vector<StringIdx> m_slots = std::vector<StringIdx>(64, 0);     // Indices of the strings by their hash. 0 marks an empty slot.
+
+        public:
+            StringIdx size() const noexcept
+            {
+                return static_cast<StringIdx>(m_entries.size());
+            }
+
+            StringRef Get(StringIdx idx) const noexcept
+            {
+                assert(idx < m_entries.size());
+                const auto& entry = m_entries[idx];
+                return StringRef{m_chars.data() + entry.offset, entry.size};
+            }
+
+            // Returns the index of the string, adding it to the dictionary if not present yet.
+            //
+            StringIdx Index(StringRef text)
+            {
+                if (text.size == 0)
+                    return 0;
+
+                const auto hash = Hash(text);
+                const auto mask = m_slots.size() - 1;
+
+                for (size_t slotIdx = hash & mask; true; slotIdx = (slotIdx + 1) & mask)
+                {
+                    const auto idx = m_slots[slotIdx];
+
+                    if (idx == 0)
+                    {
+                        const auto newIdx = Add(text, hash);
+                        m_slots[slotIdx] = newIdx;
+                        if (2 * m_entries.size() > m_slots.size())
+                            Rehash();
+                        return newIdx;
+                    }
+
+                    if (m_entries[idx].hash == hash && Get(idx) == text)
+                        return idx;
+                }
+            }
+
+        private:
+            StringIdx Add(StringRef text, uint32_t hash)
+            {
+                m_entries.push_back(Entry{m_chars.size(), static_cast<uint32_t>(text.size), hash});
+                m_chars.insert(std::end(m_chars), text.data, text.data + text.size);
+                return static_cast<StringIdx>(m_entries.size() - 1);
+            }
+
+            void Rehash()
+            {
+                std::vector<StringIdx> slots(2 * m_slots.size(), 0);
+                const auto mask = slots.size() - 1;
+
+                for (StringIdx idx = 1; idx < m_entries.size(); ++idx)
+                {
+                    auto slotIdx = m_entries[idx].hash & mask;
+                    while (slots[slotIdx] != 0)
+                        slotIdx = (slotIdx + 1) & mask;
+                    slots[slotIdx] = idx;
+                }
+
+                m_slots.swap(slots);
+            }
+
+            // FNV-1a hash of the string.
+            static uint32_t Hash(StringRef text) noexcept
+            {
+                uint32_t hash = 2166136261u;
+                for (size_t charIdx = 0; charIdx < text.size; ++charIdx)
+                {
+                    hash ^= static_cast<uint8_t>(text.data[charIdx]);
+                    hash *= 16777619u;
+                }
+                return hash;
+            }
+        };
+
         class BinaryWriter
         {
             // Output stream
             std::ostream& m_out;
-            // Strings already serialized
-            std::map<std::string, StringIdx> m_savedDictionary { std::make_pair(std::string{}, 0) };
-            // Strings to be serialized upon next section closure
-            std::map<std::string, StringIdx> m_dictionary;
+            // All the strings indexed so far
+            StringDictionary m_dictionary;
+            // Number of strings already serialized (the others are serialized upon next section closure)
+            StringIdx m_savedStringCount = 1;
+            // Dictionary indices of the worker and routine names of registered routines, by the routine identifier
+            std::vector<std::pair<StringIdx, StringIdx>> m_routineNameIdxs;
+            // Output position of the manifest section
+            std::streampos m_manifestPos = -1;
+            // Manifest section, rewritten upon finish
+            ManifestSection m_manifest;
             // Output position of current section header
             std::streampos m_lastSectionPos = -1;
             // Work items in current section
             std::vector<WorkItem> m_workItems;
+            // Arguments of the work items in current section
+            std::vector<SpanArg> m_spanArgs;
+            // Metrics of the work items in current section
+            std::vector<WorkItemMetrics> m_workItemMetrics;
+            // Counter samples to be written in a section of their own
+            std::vector<CounterSample> m_counterSamples;
+            // Stack samples to be written in a section of their own
+            std::vector<StackSample> m_stackSamples;
+            // Routine statistics table written upon finish
+            std::vector<RoutineStats> m_routineStats;
+            // Routine aggregates written in the last section upon finish
+            std::vector<RoutineAggregate> m_routineAggregates;
+            uint64_t m_unaggregatedSpanCount = 0;
+            bool m_aggregated = false;
 
         public:
             // Number of work items cached before writing them to the output
             size_t WorkItemsPerSection = 8 * 1024;
+            // Number of counter samples cached before writing them to the output
+            size_t CounterSamplesPerSection = 16 * 1024;
+            // Number of stack samples cached before writing them to the output
+            size_t StackSamplesPerSection = 16 * 1024;
 
             BinaryWriter(std::ostream& out, const std::string& programName, const std::string& description) :
                 m_out{out}
@@ -364,17 +1540,173 @@ namespace profane
                 assert(description.size() <= 255);
 
                 WriteHeader();
-                WriteManifest(programName, description);
+                m_manifestPos = WriteManifest(programName, description);
                 StartWorkItemArraySection();
             }
 
             void Finish()
             {
-                EndWorkItemArraySection();
+                if (!m_counterSamples.empty())
+                    FlushCounterSamples();
+
+                if (!m_stackSamples.empty())
+                    FlushStackSamples();
+
+                EndWorkItemArraySection(!m_aggregated);
+
+                if (m_aggregated)
+                    WriteRoutineAggregateArraySection();
+
+                if (!m_routineStats.empty())
+                    m_manifest.routineStatsPos = static_cast<uint64_t>(WriteRoutineStats());
+
+                m_out.seekp(m_manifestPos);
+                m_out.write(reinterpret_cast<const char*>(&m_manifest), sizeof(m_manifest));
+                m_out.seekp(0, std::ios_base::end);
+
                 m_out.flush();
 
-                assert(m_dictionary.empty());
+                assert(m_savedStringCount == m_dictionary.size());
                 assert(m_workItems.empty());
+                assert(m_counterSamples.empty());
+                assert(m_stackSamples.empty());
+            }
+
+            // Given a string, returns its unique index in the dictionary.
+            // New strings are serialized upon the current section closure.
+            //
+            StringIdx IndexString(StringRef text)
+            {
+                assert(text.size <= 255);
+                return m_dictionary.Index(text);
+            }
+
+            // Adds the statistics of the registered routine to the table written upon Finish().
+            //
+            void AddRoutineStats(RoutineId routineId, SamplingMode samplingMode, double samplingRate, uint64_t callCount, uint64_t tracedCount, uint64_t droppedCount, uint64_t droppedDurationNs)
+            {
+                const auto nameIdxs = IndexRoutine(routineId);
+                m_routineStats.push_back(RoutineStats{nameIdxs.first, nameIdxs.second, samplingMode, samplingRate, callCount, tracedCount, droppedCount, droppedDurationNs});
+            }
+
+            // Adds the aggregated durations of the calls of the registered routine to the section written upon Finish().
+            // Calls are counted by their durations in clock ticks (see DurationBucketOf()).
+            //
+            void AddRoutineAggregate(RoutineId routineId, uint64_t callCount, uint64_t totalDurationNs, uint64_t minDurationNs, uint64_t maxDurationNs, double nsPerTick, const uint64_t* bucketCounts)
+            {
+                const auto nameIdxs = IndexRoutine(routineId);
+                m_aggregated = true;
+                m_routineAggregates.push_back(RoutineAggregate{nameIdxs.first, nameIdxs.second, callCount, totalDurationNs, minDurationNs, maxDurationNs, nsPerTick, {}});
+                std::copy(bucketCounts, bucketCounts + DurationBucketCount, m_routineAggregates.back().bucketCounts);
+            }
+
+            // Sets the number of the spans, which the tracer has failed to aggregate. The routine aggregate section is written even if there are no aggregates.
+            //
+            void SetUnaggregatedSpanCount(uint64_t unaggregatedSpanCount)
+            {
+                m_unaggregatedSpanCount = unaggregatedSpanCount;
+                m_aggregated = true;
+            }
+
+            // Sets the duration below which work items have been dropped, written to the manifest upon Finish().
+            //
+            void SetMinSpanDuration(std::chrono::nanoseconds minSpanDuration)
+            {
+                m_manifest.minSpanDurationNs = static_cast<uint64_t>(minSpanDuration.count());
+            }
+
+            // Sets the tracer overhead per work item measured by the PerfLogger, written to the manifest upon Finish().
+            //
+            void SetSpanOverhead(std::chrono::nanoseconds spanOverhead)
+            {
+                m_manifest.spanOverheadNs = static_cast<uint64_t>(spanOverhead.count());
+            }
+
+            // Sets the number of the events lost by the PerfLogger, written to the manifest upon Finish().
+            //
+            void SetDroppedEventCount(uint64_t droppedEventCount)
+            {
+                m_manifest.droppedEventCount = droppedEventCount;
+            }
+
+            // Adds the sample of the counter registered as a routine (see RegisterRoutine()) to be written to a file.
+            //
+            template<typename TimePoint>
+            void WriteCounterSample(RoutineId counterId, TimePoint time, int64_t value)
+            {
+                using namespace std::chrono;
+                const auto nameIdxs = IndexRoutine(counterId);
+                WriteCounterSample(CounterSample{
+                    static_cast<uint64_t>(duration_cast<nanoseconds>(time.time_since_epoch()).count()),
+                    nameIdxs.first,
+                    nameIdxs.second,
+                    value});
+            }
+
+            // Adds the counter sample, with its strings already indexed, to be written to a file.
+            //
+            void WriteCounterSample(const CounterSample& sample)
+            {
+                m_counterSamples.push_back(sample);
+
+                if (m_counterSamples.size() >= CounterSamplesPerSection)
+                    FlushCounterSamples();
+            }
+
+            // Adds the stack sample of the worker to be written to a file. The worker is given by the routine registered for it (see RegisterRoutine()),
+            // or by its name if routineId is 0. Frames are given by the names of their functions, the leaf first.
+            //
+            template<typename TimePoint>
+            void WriteStackSample(TimePoint time, RoutineId routineId, StringRef workerName, const StringRef* frameNames, uint32_t frameCount)
+            {
+                using namespace std::chrono;
+
+                StackSample sample {};
+                sample.timeNs = static_cast<uint64_t>(duration_cast<nanoseconds>(time.time_since_epoch()).count());
+                sample.workerNameIdx = (routineId != 0) ? IndexRoutine(routineId).first : IndexString(workerName);
+                sample.frameCount = static_cast<uint8_t>(std::min(frameCount, StackSampleMaxDepth));
+
+                for (uint8_t frameIdx = 0; frameIdx < sample.frameCount; ++frameIdx)
+                    sample.frameNameIdxs[frameIdx] = IndexString(frameNames[frameIdx]);
+
+                WriteStackSample(sample);
+            }
+
+            // Adds the stack sample, with its strings already indexed, to be written to a file.
+            //
+            void WriteStackSample(const StackSample& sample)
+            {
+                m_stackSamples.push_back(sample);
+
+                if (m_stackSamples.size() >= StackSamplesPerSection)
+                    FlushStackSamples();
+            }
+
+            // Adds the work item, with its strings already indexed, to be written to a file.
+            // Its arguments are given apart, as many as WorkItem::argCount tells, and so are its metrics, if any (its argsIdx and metricsIdx are ignored).
+            //
+            template<bool AllowFlushWrite = true>
+            void WriteWorkItem(const WorkItem& workItem, const SpanArg* args = nullptr, const WorkItemMetrics* metrics = nullptr)
+            {
+                assert(workItem.argCount == 0 || args != nullptr);
+
+                m_workItems.push_back(workItem);
+                m_workItems.back().argsIdx = static_cast<uint32_t>(m_spanArgs.size());
+                if (args != nullptr)
+                    m_spanArgs.insert(std::end(m_spanArgs), args, args + workItem.argCount);
+
+                m_workItems.back().metricsIdx = NoMetrics;
+                if (metrics != nullptr)
+                {
+                    m_workItems.back().metricsIdx = static_cast<uint32_t>(m_workItemMetrics.size());
+                    m_workItemMetrics.push_back(*metrics);
+                }
+
+                if (AllowFlushWrite && m_workItems.size() >= WorkItemsPerSection)
+                {
+                    EndWorkItemArraySection();
+                    StartWorkItemArraySection();
+                }
             }
 
             // Adds the work item data to be written to a file.
@@ -388,20 +1720,41 @@ namespace profane
                 const uint64_t startTimeNs = duration_cast<nanoseconds>(workItemProto.startTime.time_since_epoch()).count();
                 const uint64_t stopTimeNs = duration_cast<nanoseconds>(workItemProto.stopTime.time_since_epoch()).count();
 
-                m_workItems.push_back(WorkItem{
-                    startTimeNs,
-                    stopTimeNs,
-                    IndexString(std::move(workItemProto.categoryName)),
-                    IndexString(std::move(workItemProto.workerName)),
-                    IndexString(std::move(workItemProto.routineName)),
-                    IndexString(std::move(workItemProto.comment)),
-                    workItemProto.taskId});
+                const auto workerRoutineNameIdxs = (workItemProto.routineId != 0)
+                    ? IndexRoutine(workItemProto.routineId)
+                    : std::make_pair(IndexString(workItemProto.workerName), IndexString(workItemProto.routineName));
+
+                WorkItem workItem {};
+                workItem.startTimeNs = startTimeNs;
+                workItem.stopTimeNs = stopTimeNs;
+                workItem.categoryNameIdx = IndexString(workItemProto.categoryName);
+                workItem.workerNameIdx = workerRoutineNameIdxs.first;
+                workItem.routineNameIdx = workerRoutineNameIdxs.second;
+                workItem.commentNameIdx = IndexString(workItemProto.comment);
+                workItem.taskId = workItemProto.taskId;
+                workItem.flags = workItemProto.flags;
+
+                std::array<SpanArg, SpanArgs::Capacity> args;
+                workItem.argCount = workItemProto.args.count;
+                for (uint8_t argIdx = 0; argIdx < workItemProto.args.count; ++argIdx)
+                    args[argIdx] = SpanArg{IndexRoutine(workItemProto.args.ids[argIdx]).second, workItemProto.args.values[argIdx]};
+
+                WorkItemMetrics metrics;
+                const bool hasMetrics = MetricsOf(workItemProto, metrics);
+
+                WriteWorkItem<AllowFlushWrite>(workItem, args.data(), hasMetrics ? &metrics : nullptr);
+            }
 
-                if (AllowFlushWrite && m_workItems.size() >= WorkItemsPerSection)
-                {
-                    EndWorkItemArraySection();
-                    StartWorkItemArraySection();
-                }
+            // Gives the names of the routine identifier, instead of looking them up in the RoutineRegistry (e.g. for the routines of another process).
+            //
+            void NameRoutine(RoutineId routineId, StringRef workerName, StringRef routineName)
+            {
+                constexpr auto NotIndexed = std::numeric_limits<StringIdx>::max();
+
+                if (routineId >= m_routineNameIdxs.size())
+                    m_routineNameIdxs.resize(routineId + 1, std::make_pair(NotIndexed, NotIndexed));
+
+                m_routineNameIdxs[routineId] = std::make_pair(IndexString(workerName), IndexString(routineName));
             }
 
         private:
@@ -416,40 +1769,42 @@ namespace profane
                 WriteAtom(static_cast<uint64_t>(value));
             }
 
-            void WriteTextIndexed(std::string&& text)
+            void WriteTextIndexed(StringRef text)
             {
-                WriteAtom(IndexString(std::move(text)));
+                WriteAtom(IndexString(text));
             }
 
-            // Given a string, it looks for matching string in dictionaries.
-            // First in dictionary of already serialized strings, if not found then in dictionary of string to be serialized upon current section closure.
-            // If the string is not present in both dictionaries, it is added to the latter dictionary.
-            // Returns the unique index of the string in the dictionary.
+            // Returns the indices of the worker and routine names of the registered routine.
+            // The names are indexed upon the first occurrence of the routine, later it is just an array lookup.
             //
-            StringIdx IndexString(std::string&& text)
+            std::pair<StringIdx, StringIdx> IndexRoutine(RoutineId routineId)
             {
-                const auto iter_1 = m_savedDictionary.find(text);
-                if (iter_1 != std::end(m_savedDictionary)) {
-                    return iter_1->second;
-                }
+                constexpr auto NotIndexed = std::numeric_limits<StringIdx>::max();
+
+                if (routineId >= m_routineNameIdxs.size())
+                    m_routineNameIdxs.resize(routineId + 1, std::make_pair(NotIndexed, NotIndexed));
 
-                const auto idx = static_cast<StringIdx>(m_savedDictionary.size() + m_dictionary.size());
+                auto& nameIdxs = m_routineNameIdxs[routineId];
+                if (nameIdxs.first == NotIndexed)
+                {
+                    const auto& routine = RoutineRegistry::Instance().Get(routineId);
+                    nameIdxs = std::make_pair(IndexString(routine.workerName), IndexString(routine.routineName));
+                }
 
-                const auto iter_2 = m_dictionary.insert(std::make_pair(std::move(text), idx));
-                return iter_2.first->second;
+                return nameIdxs;
             }
 
             // Writes the string to the file.
             // First comes the byte of string size (0 - 255), then the null-terminated string content.
             // The string may contain multi-byte characters, but the null-termination is a single byte '\0'.
             //
-            void WriteTextImmediate(const std::string& text)
+            void WriteTextImmediate(StringRef text)
             {
-                assert(text.size() <= 255);
-                const auto textSize = static_cast<uint8_t>(text.size());
+                assert(text.size <= 255);
+                const auto textSize = static_cast<uint8_t>(text.size);
                 WriteAtom(textSize);
                 if (textSize > 0) {
-                    m_out.write(&text.front(), textSize);
+                    m_out.write(text.data, textSize);
                 }
             }
 
@@ -464,6 +1819,7 @@ namespace profane
             }
 
             // Writes the file manifest section describing its content.
+            // The members not known until the end of the output are patched by Finish().
             // Returns the file offset of the section beginning.
             //
             std::streampos WriteManifest(std::string programName, std::string description)
@@ -473,21 +1829,26 @@ namespace profane
                 // Write the manifest section.
                 // This is always the first section of the file and it occurs once.
                 //
-                ManifestSection manifest;
+                ManifestSection& manifest = m_manifest;
                 manifest.dictionaryPos      = std::streampos{-1};
                 manifest.nextSectionPos     = std::streampos{-1};
+                manifest.sectionType        = SectionType::Manifest;
                 manifest.formatVersion      = FormatVersion;
-                manifest.programNameIdx     = IndexString(std::move(programName));
-                manifest.descriptionIdx     = IndexString(std::move(description));
+                manifest.programNameIdx     = IndexString(programName);
+                manifest.descriptionIdx     = IndexString(description);
                 manifest.dateTime           = static_cast<uint64_t>(std::time(nullptr));
+                manifest.routineStatsPos    = static_cast<uint64_t>(-1);
+                manifest.minSpanDurationNs  = 0;
+                manifest.spanOverheadNs     = 0;
+                manifest.droppedEventCount  = 0;
                 m_out.write(reinterpret_cast<const char*>(&manifest), sizeof(manifest));
 
                 // Write the dictionary of the manifest and patch the section header.
                 //
-                SectionHeader sectionHeader;
-                sectionHeader.dictionaryPos = static_cast<uint64_t>(WriteDictionary());
-                sectionHeader.nextSectionPos = static_cast<uint64_t>(m_out.tellp());
+                manifest.dictionaryPos = static_cast<uint64_t>(WriteDictionary());
+                manifest.nextSectionPos = static_cast<uint64_t>(m_out.tellp());
 
+                const SectionHeader& sectionHeader = manifest;
                 m_out.seekp(startPos);
                 m_out.write(reinterpret_cast<const char*>(&sectionHeader), sizeof(sectionHeader));
 
@@ -504,21 +1865,27 @@ namespace profane
                 WorkItemArraySectionHeader sectionHeader {};
                 sectionHeader.dictionaryPos     = std::streampos{-1};
                 sectionHeader.nextSectionPos    = std::streampos{-1};
+                sectionHeader.sectionType       = SectionType::WorkItemArray;
                 sectionHeader.workItemCount     = 0;
                 // The other member data are irrelevant unless populated by the work items.
                 m_out.write(reinterpret_cast<const char*>(&sectionHeader), sizeof(sectionHeader));
             }
 
-            void EndWorkItemArraySection()
+            // Writes out the work items of the current section, followed by the new strings of the dictionary.
+            // The last section of the file does not point to a next one, so that other data may follow it.
+            //
+            void EndWorkItemArraySection(bool last = false)
             {
                 assert(m_lastSectionPos != -1);
 
                 WorkItemArraySectionHeader sectionHeader = WriteWorkItems();
 
                 sectionHeader.dictionaryPos = static_cast<uint64_t>(WriteDictionary());
-                sectionHeader.nextSectionPos = static_cast<uint64_t>(m_out.tellp());
+                sectionHeader.nextSectionPos = last ? static_cast<uint64_t>(-1) : static_cast<uint64_t>(m_out.tellp());
 
                 m_workItems.clear();
+                m_spanArgs.clear();
+                m_workItemMetrics.clear();
 
                 m_out.seekp(m_lastSectionPos);
                 m_out.write(reinterpret_cast<const char*>(&sectionHeader), sizeof(sectionHeader));
@@ -531,6 +1898,7 @@ namespace profane
                 WorkItemArraySectionHeader sectionHeader;
                 sectionHeader.dictionaryPos     = std::streampos{-1};
                 sectionHeader.nextSectionPos    = std::streampos{-1};
+                sectionHeader.sectionType       = SectionType::WorkItemArray;
                 sectionHeader.workItemCount     = static_cast<uint32_t>(m_workItems.size());
 
                 IntBitPacker<uint64_t, false> startTimeNsPacker;
@@ -540,6 +1908,23 @@ namespace profane
                 IntBitPacker<StringIdx, true> routineNameIdxPacker;
                 IntBitPacker<StringIdx, true> commentNameIdxPacker;
                 IntBitPacker<uint32_t, false> taskIdPacker;
+                IntBitPacker<uint8_t, false> flagsPacker;
+                IntBitPacker<uint8_t, false> argCountPacker;
+                IntBitPacker<StringIdx, true> argNameIdxPacker;
+                IntBitPacker<uint64_t, false> argValuePacker;
+                IntBitPacker<uint8_t, false> hasMetricsPacker;
+                IntBitPacker<uint64_t, false> cpuTimeNsPacker;
+                IntBitPacker<uint8_t, false> perfCounterMaskPacker;
+                IntBitPacker<uint64_t, false> perfCounterPackers[PerfCounterCount];
+                IntBitPacker<uint64_t, false> allocationCountPacker;
+                IntBitPacker<uint64_t, false> allocatedBytesPacker;
+                IntBitPacker<uint16_t, false> startCpuPacker;
+                IntBitPacker<uint16_t, false> stopCpuPacker;
+                IntBitPacker<uint32_t, false> voluntarySwitchesPacker;
+                IntBitPacker<uint32_t, false> involuntarySwitchesPacker;
+
+                // Flipping the sign bit maps the signed values onto unsigned ones of the same order.
+                auto packedValue = [](int64_t value) { return static_cast<uint64_t>(value) ^ (uint64_t{1} << 63); };
 
                 for (const auto& workItem : m_workItems)
                 {
@@ -552,6 +1937,31 @@ namespace profane
                     routineNameIdxPacker.Peek(workItem.routineNameIdx);
                     commentNameIdxPacker.Peek(workItem.commentNameIdx);
                     taskIdPacker.Peek(workItem.taskId);
+                    flagsPacker.Peek(workItem.flags);
+
+                    argCountPacker.Peek(workItem.argCount);
+                    for (uint32_t argIdx = workItem.argsIdx; argIdx < workItem.argsIdx + workItem.argCount; ++argIdx)
+                    {
+                        argNameIdxPacker.Peek(m_spanArgs[argIdx].nameIdx);
+                        argValuePacker.Peek(packedValue(m_spanArgs[argIdx].value));
+                    }
+
+                    hasMetricsPacker.Peek(workItem.metricsIdx != NoMetrics);
+                    if (workItem.metricsIdx != NoMetrics)
+                    {
+                        const auto& metrics = m_workItemMetrics[workItem.metricsIdx];
+                        cpuTimeNsPacker.Peek(metrics.cpuTimeNs);
+                        perfCounterMaskPacker.Peek(metrics.perfCounterMask);
+                        for (uint8_t counterIdx = 0; counterIdx < PerfCounterCount; ++counterIdx)
+                            perfCounterPackers[counterIdx].Peek(metrics.perfCounters[counterIdx]);
+
+                        allocationCountPacker.Peek(metrics.allocationCount);
+                        allocatedBytesPacker.Peek(metrics.allocatedBytes);
+                        startCpuPacker.Peek(metrics.startCpu);
+                        stopCpuPacker.Peek(metrics.stopCpu);
+                        voluntarySwitchesPacker.Peek(metrics.voluntarySwitches);
+                        involuntarySwitchesPacker.Peek(metrics.involuntarySwitches);
+                    }
                 }
 
                 sectionHeader.startTimeNsSize       = startTimeNsPacker.DeterminePackingSize();
@@ -568,6 +1978,41 @@ namespace profane
                 sectionHeader.commentNameIdxBase    = commentNameIdxPacker.base();
                 sectionHeader.taskIdSize            = taskIdPacker.DeterminePackingSize();
                 sectionHeader.taskIdBase            = taskIdPacker.base();
+                sectionHeader.flagsSize             = flagsPacker.DeterminePackingSize();
+                sectionHeader.flagsBase             = flagsPacker.base();
+
+                sectionHeader.argCountSize          = argCountPacker.DeterminePackingSize();
+                sectionHeader.argCountBase          = argCountPacker.base();
+                sectionHeader.argNameIdxSize        = argNameIdxPacker.DeterminePackingSize();
+                sectionHeader.argNameIdxBase        = argNameIdxPacker.base();
+                sectionHeader.argValueSize          = argValuePacker.DeterminePackingSize();
+                sectionHeader.argValueBase          = argValuePacker.base();
+
+                sectionHeader.hasMetricsSize        = hasMetricsPacker.DeterminePackingSize();
+                sectionHeader.hasMetricsBase        = hasMetricsPacker.base();
+                sectionHeader.cpuTimeNsSize         = cpuTimeNsPacker.DeterminePackingSize();
+                sectionHeader.cpuTimeNsBase         = cpuTimeNsPacker.base();
+                sectionHeader.perfCounterMaskSize   = perfCounterMaskPacker.DeterminePackingSize();
+                sectionHeader.perfCounterMaskBase   = perfCounterMaskPacker.base();
+
+                for (uint8_t counterIdx = 0; counterIdx < PerfCounterCount; ++counterIdx)
+                {
+                    sectionHeader.perfCounterSize[counterIdx]   = perfCounterPackers[counterIdx].DeterminePackingSize();
+                    sectionHeader.perfCounterBase[counterIdx]   = perfCounterPackers[counterIdx].base();
+                }
+
+                sectionHeader.allocationCountSize   = allocationCountPacker.DeterminePackingSize();
+                sectionHeader.allocationCountBase   = allocationCountPacker.base();
+                sectionHeader.allocatedBytesSize    = allocatedBytesPacker.DeterminePackingSize();
+                sectionHeader.allocatedBytesBase    = allocatedBytesPacker.base();
+                sectionHeader.startCpuSize          = startCpuPacker.DeterminePackingSize();
+                sectionHeader.startCpuBase          = startCpuPacker.base();
+                sectionHeader.stopCpuSize           = stopCpuPacker.DeterminePackingSize();
+                sectionHeader.stopCpuBase           = stopCpuPacker.base();
+                sectionHeader.voluntarySwitchesSize     = voluntarySwitchesPacker.DeterminePackingSize();
+                sectionHeader.voluntarySwitchesBase     = voluntarySwitchesPacker.base();
+                sectionHeader.involuntarySwitchesSize   = involuntarySwitchesPacker.DeterminePackingSize();
+                sectionHeader.involuntarySwitchesBase   = involuntarySwitchesPacker.base();
 
                 for (const auto& workItem : m_workItems)
                 {
@@ -580,257 +2025,4633 @@ namespace profane
                     routineNameIdxPacker.Pack(m_out, workItem.routineNameIdx);
                     commentNameIdxPacker.Pack(m_out, workItem.commentNameIdx);
                     taskIdPacker.Pack(m_out, workItem.taskId);
+                    flagsPacker.Pack(m_out, workItem.flags);
+
+                    argCountPacker.Pack(m_out, workItem.argCount);
+                    for (uint32_t argIdx = workItem.argsIdx; argIdx < workItem.argsIdx + workItem.argCount; ++argIdx)
+                    {
+                        argNameIdxPacker.Pack(m_out, m_spanArgs[argIdx].nameIdx);
+                        argValuePacker.Pack(m_out, packedValue(m_spanArgs[argIdx].value));
+                    }
+
+                    hasMetricsPacker.Pack(m_out, workItem.metricsIdx != NoMetrics);
+                    if (workItem.metricsIdx != NoMetrics)
+                    {
+                        const auto& metrics = m_workItemMetrics[workItem.metricsIdx];
+                        cpuTimeNsPacker.Pack(m_out, metrics.cpuTimeNs);
+                        perfCounterMaskPacker.Pack(m_out, metrics.perfCounterMask);
+                        for (uint8_t counterIdx = 0; counterIdx < PerfCounterCount; ++counterIdx)
+                            perfCounterPackers[counterIdx].Pack(m_out, metrics.perfCounters[counterIdx]);
+
+                        allocationCountPacker.Pack(m_out, metrics.allocationCount);
+                        allocatedBytesPacker.Pack(m_out, metrics.allocatedBytes);
+                        startCpuPacker.Pack(m_out, metrics.startCpu);
+                        stopCpuPacker.Pack(m_out, metrics.stopCpu);
+                        voluntarySwitchesPacker.Pack(m_out, metrics.voluntarySwitches);
+                        involuntarySwitchesPacker.Pack(m_out, metrics.involuntarySwitches);
+                    }
                 }
 
                 return sectionHeader;
             }
 
-            std::vector<std::string> FetchOrderedDictionary()
+            // Closes the current work item section, writes the cached counter samples in a section of their own and opens a new work item section.
+            //
+            void FlushCounterSamples()
             {
-                const auto startIdx = m_savedDictionary.size();
-
-                std::vector<std::string> orderedDictionary;
-                orderedDictionary.resize(m_dictionary.size());
-
-                for (auto& entryKV : m_dictionary)
-                {
-                    assert(entryKV.second >= startIdx);
-                    orderedDictionary[entryKV.second - startIdx] = std::move(entryKV.first);
-                }
-
-                m_dictionary.clear();
-
-                return orderedDictionary;
+                EndWorkItemArraySection();
+                WriteCounterSampleArraySection();
+                StartWorkItemArraySection();
             }
 
-            std::streampos WriteDictionary()
+            void WriteCounterSampleArraySection()
             {
                 const auto startPos = m_out.tellp();
 
-                auto orderedDictionary = FetchOrderedDictionary();
+                CounterSampleArraySectionHeader sectionHeader {};
+                sectionHeader.dictionaryPos     = std::streampos{-1};
+                sectionHeader.nextSectionPos    = std::streampos{-1};
+                sectionHeader.sectionType       = SectionType::CounterSampleArray;
+                sectionHeader.sampleCount       = static_cast<uint32_t>(m_counterSamples.size());
+
+                // Flipping the sign bit maps the signed values onto unsigned ones of the same order.
+                auto packedValue = [](int64_t value) { return static_cast<uint64_t>(value) ^ (uint64_t{1} << 63); };
 
-                const uint32_t stringCount = static_cast<uint32_t>(orderedDictionary.size());
-                WriteAtom(stringCount);
+                IntBitPacker<uint64_t, false> timeNsPacker;
+                IntBitPacker<uint64_t, false> valuePacker;
+                IntBitPacker<StringIdx, true> counterGroupNameIdxPacker;
+                IntBitPacker<StringIdx, true> counterNameIdxPacker;
 
-                for (uint32_t stringIdx = 0; stringIdx < stringCount; ++stringIdx)
+                for (const auto& sample : m_counterSamples)
                 {
-                    WriteTextImmediate(orderedDictionary[stringIdx]);
-                    m_savedDictionary.insert(std::make_pair(std::move(orderedDictionary[stringIdx]), static_cast<uint32_t>(m_savedDictionary.size())));
+                    timeNsPacker.Peek(sample.timeNs);
+                    valuePacker.Peek(packedValue(sample.value));
+                    counterGroupNameIdxPacker.Peek(sample.counterGroupNameIdx);
+                    counterNameIdxPacker.Peek(sample.counterNameIdx);
                 }
 
-                return startPos;
-            }
-        };
+                sectionHeader.timeNsSize                = timeNsPacker.DeterminePackingSize();
+                sectionHeader.timeNsBase                = timeNsPacker.base();
+                sectionHeader.valueSize                 = valuePacker.DeterminePackingSize();
+                sectionHeader.valueBase                 = valuePacker.base();
+                sectionHeader.counterGroupNameIdxSize   = counterGroupNameIdxPacker.DeterminePackingSize();
+                sectionHeader.counterGroupNameIdxBase   = counterGroupNameIdxPacker.base();
+                sectionHeader.counterNameIdxSize        = counterNameIdxPacker.DeterminePackingSize();
+                sectionHeader.counterNameIdxBase        = counterNameIdxPacker.base();
 
-    } // namespace bin
+                m_out.write(reinterpret_cast<const char*>(&sectionHeader), sizeof(sectionHeader));
 
-    struct ActorBasedTraits
+                for (const auto& sample : m_counterSamples)
+                {
+                    timeNsPacker.Pack(m_out, sample.timeNs);
+                    valuePacker.Pack(m_out, packedValue(sample.value));
+                    counterGroupNameIdxPacker.Pack(m_out, sample.counterGroupNameIdx);
+                    counterNameIdxPacker.Pack(m_out, sample.counterNameIdx);
+                }
+
+                m_counterSamples.clear();
+
+                sectionHeader.dictionaryPos = static_cast<uint64_t>(WriteDictionary());
+                sectionHeader.nextSectionPos = static_cast<uint64_t>(m_out.tellp());
+
+                m_out.seekp(startPos);
+                m_out.write(reinterpret_cast<const char*>(&sectionHeader), sizeof(sectionHeader));
+
+                m_out.seekp(0, std::ios_base::end);
+            }
+
+            // Closes the current work item section, writes the cached stack samples in a section of their own and opens a new work item section.
+            //
+            void FlushStackSamples()
+            {
+                EndWorkItemArraySection();
+                WriteStackSampleArraySection();
+                StartWorkItemArraySection();
+            }
+
+            void WriteStackSampleArraySection()
+            {
+                const auto startPos = m_out.tellp();
+
+                StackSampleArraySectionHeader sectionHeader {};
+                sectionHeader.dictionaryPos     = std::streampos{-1};
+                sectionHeader.nextSectionPos    = std::streampos{-1};
+                sectionHeader.sectionType       = SectionType::StackSampleArray;
+                sectionHeader.sampleCount       = static_cast<uint32_t>(m_stackSamples.size());
+
+                IntBitPacker<uint64_t, false> timeNsPacker;
+                IntBitPacker<StringIdx, true> workerNameIdxPacker;
+                IntBitPacker<StringIdx, true> frameNameIdxPacker;
+
+                for (const auto& sample : m_stackSamples)
+                {
+                    timeNsPacker.Peek(sample.timeNs);
+                    workerNameIdxPacker.Peek(sample.workerNameIdx);
+                    for (uint8_t frameIdx = 0; frameIdx < sample.frameCount; ++frameIdx)
+                        frameNameIdxPacker.Peek(sample.frameNameIdxs[frameIdx]);
+                }
+
+                sectionHeader.timeNsSize            = timeNsPacker.DeterminePackingSize();
+                sectionHeader.timeNsBase            = timeNsPacker.base();
+                sectionHeader.workerNameIdxSize     = workerNameIdxPacker.DeterminePackingSize();
+                sectionHeader.workerNameIdxBase     = workerNameIdxPacker.base();
+                sectionHeader.frameNameIdxSize      = frameNameIdxPacker.DeterminePackingSize();
+                sectionHeader.frameNameIdxBase      = frameNameIdxPacker.base();
+
+                m_out.write(reinterpret_cast<const char*>(&sectionHeader), sizeof(sectionHeader));
+
+                for (const auto& sample : m_stackSamples)
+                {
+                    timeNsPacker.Pack(m_out, sample.timeNs);
+                    workerNameIdxPacker.Pack(m_out, sample.workerNameIdx);
+                    WriteAtom(sample.frameCount);
+                    for (uint8_t frameIdx = 0; frameIdx < sample.frameCount; ++frameIdx)
+                        frameNameIdxPacker.Pack(m_out, sample.frameNameIdxs[frameIdx]);
+                }
+
+                m_stackSamples.clear();
+
+                sectionHeader.dictionaryPos = static_cast<uint64_t>(WriteDictionary());
+                sectionHeader.nextSectionPos = static_cast<uint64_t>(m_out.tellp());
+
+                m_out.seekp(startPos);
+                m_out.write(reinterpret_cast<const char*>(&sectionHeader), sizeof(sectionHeader));
+
+                m_out.seekp(0, std::ios_base::end);
+            }
+
+            // Writes the routine aggregates in the last section of the file, skipping their empty buckets.
+            //
+            void WriteRoutineAggregateArraySection()
+            {
+                const auto startPos = m_out.tellp();
+
+                RoutineAggregateArraySectionHeader sectionHeader {};
+                sectionHeader.dictionaryPos     = std::streampos{-1};
+                sectionHeader.nextSectionPos    = std::streampos{-1};
+                sectionHeader.sectionType       = SectionType::RoutineAggregateArray;
+                sectionHeader.routineCount      = static_cast<uint32_t>(m_routineAggregates.size());
+                sectionHeader.unaggregatedSpanCount = m_unaggregatedSpanCount;
+                m_out.write(reinterpret_cast<const char*>(&sectionHeader), sizeof(sectionHeader));
+
+                for (const auto& aggregate : m_routineAggregates)
+                {
+                    RoutineAggregateRecord record {};
+                    record.workerNameIdx    = aggregate.workerNameIdx;
+                    record.routineNameIdx   = aggregate.routineNameIdx;
+                    record.callCount        = aggregate.callCount;
+                    record.totalDurationNs  = aggregate.totalDurationNs;
+                    record.minDurationNs    = aggregate.minDurationNs;
+                    record.maxDurationNs    = aggregate.maxDurationNs;
+                    record.nsPerTick        = aggregate.nsPerTick;
+                    record.bucketCount      = static_cast<uint8_t>(std::count_if(std::begin(aggregate.bucketCounts), std::end(aggregate.bucketCounts), [](uint64_t callCount) { return callCount != 0; }));
+                    m_out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+
+                    for (uint32_t bucketIdx = 0; bucketIdx < DurationBucketCount; ++bucketIdx)
+                    {
+                        if (aggregate.bucketCounts[bucketIdx] == 0)
+                            continue;
+
+                        WriteAtom(static_cast<uint8_t>(bucketIdx));
+                        WriteAtom(aggregate.bucketCounts[bucketIdx]);
+                    }
+                }
+
+                m_routineAggregates.clear();
+
+                sectionHeader.dictionaryPos = static_cast<uint64_t>(WriteDictionary());
+
+                m_out.seekp(startPos);
+                m_out.write(reinterpret_cast<const char*>(&sectionHeader), sizeof(sectionHeader));
+
+                m_out.seekp(0, std::ios_base::end);
+            }
+
+            // Writes the routine statistics table.
+            // The names of the routines are in the dictionary of the last section, as they have been indexed before its closure.
+            // Returns the file offset of the table beginning.
+            //
+            std::streampos WriteRoutineStats()
+            {
+                const auto startPos = m_out.tellp();
+
+                WriteAtom(static_cast<uint32_t>(m_routineStats.size()));
+                m_out.write(reinterpret_cast<const char*>(m_routineStats.data()), m_routineStats.size() * sizeof(RoutineStats));
+
+                return startPos;
+            }
+
+            // Writes the strings indexed since the last dictionary was written.
+            //
+            std::streampos WriteDictionary()
+            {
+                const auto startPos = m_out.tellp();
+
+                const uint32_t stringCount = m_dictionary.size() - m_savedStringCount;
+                WriteAtom(stringCount);
+
+                for (; m_savedStringCount < m_dictionary.size(); ++m_savedStringCount)
+                {
+                    WriteTextImmediate(m_dictionary.Get(m_savedStringCount));
+                }
+
+                return startPos;
+            }
+        };
+
+    } // namespace bin
+
+#if PROFANE_HAS_MMAP
+    // Shared memory transport, which merges the performance logs of many processes of a host into a single file.
+    // The collector creates a named POSIX shared memory segment divided into regions. Every traced process claims a region of its own
+    // and publishes its work items there as a stream of records, which the collector drains and writes through a single bin::BinaryWriter.
+    // All the processes must timestamp their events with the same clock (e.g. all use ActorBasedTraits).
+    // Some platforms need linking with librt for shm_open().
+    //
+    namespace shm
     {
-        using Clock = std::chrono::high_resolution_clock;
+        using bin::StringIdx;
 
-        #pragma pack(push)
-        #pragma pack(1)
-        struct EventData
+        enum class RegionState : uint32_t
         {
-            const char* workerRoutineName;
-            int16_t workerId;
-            uint32_t taskId;
+            Free,
+            Claimed,            // The process is setting up the region.
+            Active,             // The process publishes its records.
+            Finished,           // The process has published all its records.
         };
-        #pragma pack(pop)
 
-        static void OnWorkItem(const EventData& eventData, WorkItemProto<Clock>& workItemProto)
+        enum class RecordType : uint8_t
         {
-            SplitWorkerRoutineName(eventData.workerRoutineName, workItemProto.workerName, workItemProto.routineName);
-            workItemProto.taskId = eventData.taskId;
+            String,             // StringIdx followed by the characters of the string.
+            WorkItem,           // bin::WorkItem followed by its bin::SpanArg array and its bin::WorkItemMetrics (unless NoMetrics), with the string indices of the process.
+            CounterSample,      // bin::CounterSample, with the string indices of the process.
+        };
+
+        struct SegmentHeader
+        {
+            char headerText[64] = "PROFANE Shared Memory Segment\n";
+            uint32_t formatVersion = bin::FormatVersion;
+            uint32_t regionCount = 0;
+            uint64_t regionSize = 0;                            // Size of a region in bytes, including its header.
+        };
+
+        // A region is a single-producer, single-consumer byte queue of records: uint32_t payload size, RecordType, payload.
+        // The positions only grow, the data is written at their remainders of division by the capacity.
+        //
+        struct alignas(64) RegionHeader
+        {
+            std::atomic<RegionState> state = {RegionState::Free};
+            uint32_t processId = 0;
+            uint64_t processStartTime = 0;                      // See ProcessStartTime(), 0 if unknown.
+            char processName[64] = {};
+            std::atomic<uint64_t> writePos = {0};
+            std::atomic<uint64_t> readPos = {0};
+            std::atomic<uint64_t> droppedRecordCount = {0};     // Records dropped by the process while the region has been full.
+            std::atomic<uint64_t> droppedEventCount = {0};      // Events lost by the tracer of the process, as it has run out of free chunks.
+            std::atomic<uint64_t> minSpanDurationNs = {0};
+            std::atomic<uint64_t> spanOverheadNs = {0};
+        };
+
+        constexpr size_t RecordHeaderSize = sizeof(uint32_t) + sizeof(RecordType);
+
+        // The regions follow the segment header at page boundaries.
+        constexpr uint64_t SegmentHeaderSize = 4096;
+
+        inline RegionHeader* RegionAt(char* segment, uint32_t regionIdx)
+        {
+            const auto* header = reinterpret_cast<const SegmentHeader*>(segment);
+            return reinterpret_cast<RegionHeader*>(segment + SegmentHeaderSize + regionIdx * header->regionSize);
         }
 
-    private:
-        // Splits an examplar string "Worker.Routine" into "Worker" and "Routine".
+        inline uint64_t RegionCapacity(const SegmentHeader& header)
+        {
+            return header.regionSize - sizeof(RegionHeader);
+        }
+
+        // Returns the start time of the process in clock ticks since boot, or 0 if it is unknown (i.e. off Linux, or if there is no such process).
+        // Unlike the identifier of the process, it tells the process apart from a later one, which has reused the identifier.
         //
-        static void SplitWorkerRoutineName(const char* workerRoutineName, std::string& outWorkerName, std::string& outRoutineName)
+        inline uint64_t ProcessStartTime(uint32_t processId)
         {
-            using namespace std;
-            auto workerRoutineNameEnd = workerRoutineName + strlen(workerRoutineName);
-            auto finding = find(workerRoutineName, workerRoutineNameEnd, '.');
-            assert(finding != workerRoutineNameEnd && "workerRoutineName must be in form: <workerName>.<routineName>");
-            outWorkerName = string(workerRoutineName, finding);
-            outRoutineName = string(finding + 1, workerRoutineNameEnd);
+#if defined(__linux__)
+            std::ifstream statFile{"/proc/" + std::to_string(processId) + "/stat"};
+            std::string stat;
+            if (!std::getline(statFile, stat))
+                return 0;
+
+            // The start time is the 22nd field. The 2nd one, the name of the process, is parenthesized and may contain spaces, so the fields are counted past it.
+            auto pos = stat.rfind(')');
+            for (int fieldIdx = 2; fieldIdx < 22 && pos != std::string::npos; ++fieldIdx)
+                pos = stat.find(' ', pos + 1);
+
+            return (pos != std::string::npos) ? std::strtoull(stat.c_str() + pos + 1, nullptr, 10) : 0;
+#else
+            (void)processId;
+            return 0;
+#endif
         }
-    };
 
-    // Collects the event logs and generates the usable data upon finish.
-    //
-    template<typename Traits>
-    class PerfLogger
-    {
-        #pragma pack(push)
-        #pragma pack(1)
-        struct Event
-        {
-            typename Traits::Clock::time_point startTime;
-            typename Traits::Clock::time_point stopTime = {};
-            typename Traits::EventData data = {};
-        };
-        #pragma pack(pop)
+        // Returns whether the process, which has claimed a region, is still running.
+        //
+        inline bool IsProcessAlive(uint32_t processId, uint64_t processStartTime)
+        {
+            if (::kill(static_cast<pid_t>(processId), 0) != 0 && errno == ESRCH)
+                return false;
+
+            return processStartTime == 0 || ProcessStartTime(processId) == processStartTime;
+        }
+
+        // Publishes the work items and the counter samples of the process in a region of the segment created by the collector.
+        // It stands in for bin::BinaryWriter in the stream writer thread of a PerfLogger (see PerfLogger::EnableSharedMemory()).
+        // Strings are published once, before the first record referring to them.
+        //
+        class RegionWriter
+        {
+            detail::MappedFile m_segment;
+            RegionHeader* m_region = nullptr;
+            char* m_data = nullptr;
+            uint64_t m_capacity = 0;
+            bin::StringDictionary m_dictionary;
+            StringIdx m_publishedStringCount = 1;
+            std::vector<std::pair<StringIdx, StringIdx>> m_routineNameIdxs;
+            std::vector<char> m_record;
+            std::vector<char> m_payload;
+            bool m_stalled = false;                             // Whether the region has been found full for longer than FullRegionTimeout.
+
+        public:
+            // How long a record waits for the collector to make room in the region, before it is dropped.
+            // Once a record is dropped, the following ones are dropped at once, till the collector makes room.
+            std::chrono::milliseconds FullRegionTimeout { 1000 };
+
+            RegionWriter(const std::string& segmentName, const std::string& processName)
+            {
+                m_segment.MapSharedMemory(segmentName, 0);
+
+                const SegmentHeader expectedHeader;
+                const auto* header = reinterpret_cast<const SegmentHeader*>(m_segment.Data());
+                if (m_segment.Size() < sizeof(SegmentHeader) || std::memcmp(header->headerText, expectedHeader.headerText, sizeof(header->headerText)) != 0)
+                    throw std::runtime_error{"Not a profane shared memory segment: " + segmentName};
+                if (header->formatVersion != bin::FormatVersion)
+                    throw std::runtime_error{"Incompatible shared memory segment version: " + std::to_string(header->formatVersion)};
+
+                for (uint32_t regionIdx = 0; regionIdx < header->regionCount && m_region == nullptr; ++regionIdx)
+                {
+                    RegionHeader* const region = RegionAt(m_segment.Data(), regionIdx);
+                    auto state = RegionState::Free;
+                    if (region->state.compare_exchange_strong(state, RegionState::Claimed))
+                        m_region = region;
+                }
+
+                if (m_region == nullptr)
+                    throw std::runtime_error{"No free region in shared memory segment: " + segmentName};
+
+                m_data = reinterpret_cast<char*>(m_region + 1);
+                m_capacity = RegionCapacity(*header);
+                m_region->processId = static_cast<uint32_t>(::getpid());
+                m_region->processStartTime = ProcessStartTime(m_region->processId);
+                std::strncpy(m_region->processName, processName.c_str(), sizeof(m_region->processName) - 1);
+
+                // The collector takes back a region claimed for too long, as if the process had died while setting it up.
+                auto state = RegionState::Claimed;
+                if (!m_region->state.compare_exchange_strong(state, RegionState::Active, std::memory_order_release, std::memory_order_relaxed))
+                {
+                    m_region = nullptr;
+                    throw std::runtime_error{"Region taken back by the collector while set up in shared memory segment: " + segmentName};
+                }
+            }
+
+            RegionWriter(const RegionWriter&) = delete;
+            RegionWriter& operator=(const RegionWriter&) = delete;
+
+            ~RegionWriter()
+            {
+                Finish();
+            }
+
+            // Tells the collector that all the records have been published.
+            //
+            void Finish()
+            {
+                if (m_region != nullptr)
+                    detail::exchange(m_region, nullptr)->state.store(RegionState::Finished, std::memory_order_release);
+            }
+
+            template<bool AllowFlushWrite = true, typename Clock>
+            void WriteWorkItem(WorkItemProto<Clock>&& workItemProto)
+            {
+                using namespace std::chrono;
+
+                const auto workerRoutineNameIdxs = (workItemProto.routineId != 0)
+                    ? IndexRoutine(workItemProto.routineId)
+                    : std::make_pair(m_dictionary.Index(workItemProto.workerName), m_dictionary.Index(workItemProto.routineName));
+
+                bin::WorkItem workItem {};
+                workItem.startTimeNs = static_cast<uint64_t>(duration_cast<nanoseconds>(workItemProto.startTime.time_since_epoch()).count());
+                workItem.stopTimeNs = static_cast<uint64_t>(duration_cast<nanoseconds>(workItemProto.stopTime.time_since_epoch()).count());
+                workItem.categoryNameIdx = m_dictionary.Index(workItemProto.categoryName);
+                workItem.workerNameIdx = workerRoutineNameIdxs.first;
+                workItem.routineNameIdx = workerRoutineNameIdxs.second;
+                workItem.commentNameIdx = m_dictionary.Index(workItemProto.comment);
+                workItem.taskId = workItemProto.taskId;
+                workItem.flags = workItemProto.flags;
+                workItem.argCount = workItemProto.args.count;
+
+                bin::WorkItemMetrics metrics;
+                const bool hasMetrics = bin::MetricsOf(workItemProto, metrics);
+                workItem.metricsIdx = hasMetrics ? 0 : bin::NoMetrics;
+
+                const size_t argsSize = workItem.argCount * sizeof(bin::SpanArg);
+                m_payload.resize(sizeof(workItem) + argsSize + (hasMetrics ? sizeof(metrics) : 0));
+                std::memcpy(m_payload.data(), &workItem, sizeof(workItem));
+                for (uint8_t argIdx = 0; argIdx < workItem.argCount; ++argIdx)
+                {
+                    const bin::SpanArg arg { IndexRoutine(workItemProto.args.ids[argIdx]).second, workItemProto.args.values[argIdx] };
+                    std::memcpy(m_payload.data() + sizeof(workItem) + argIdx * sizeof(arg), &arg, sizeof(arg));
+                }
+
+                if (hasMetrics)
+                    std::memcpy(m_payload.data() + sizeof(workItem) + argsSize, &metrics, sizeof(metrics));
+
+                if (PublishStrings())
+                    WriteRecord(RecordType::WorkItem, m_payload.data(), m_payload.size());
+            }
+
+            template<typename TimePoint>
+            void WriteCounterSample(RoutineId counterId, TimePoint time, int64_t value)
+            {
+                using namespace std::chrono;
+                const auto nameIdxs = IndexRoutine(counterId);
+                const bin::CounterSample sample {
+                    static_cast<uint64_t>(duration_cast<nanoseconds>(time.time_since_epoch()).count()),
+                    nameIdxs.first,
+                    nameIdxs.second,
+                    value };
+
+                if (PublishStrings())
+                    WriteRecord(RecordType::CounterSample, &sample, sizeof(sample));
+            }
+
+            // The statistics of the sampled routines are not merged by the collector.
+            //
+            void AddRoutineStats(RoutineId, SamplingMode, double, uint64_t, uint64_t, uint64_t, uint64_t)
+            {
+            }
+
+            void SetMinSpanDuration(std::chrono::nanoseconds minSpanDuration)
+            {
+                if (m_region != nullptr)
+                    m_region->minSpanDurationNs.store(static_cast<uint64_t>(minSpanDuration.count()), std::memory_order_relaxed);
+            }
+
+            void SetSpanOverhead(std::chrono::nanoseconds spanOverhead)
+            {
+                if (m_region != nullptr)
+                    m_region->spanOverheadNs.store(static_cast<uint64_t>(spanOverhead.count()), std::memory_order_relaxed);
+            }
+
+            void SetDroppedEventCount(uint64_t droppedEventCount)
+            {
+                if (m_region != nullptr)
+                    m_region->droppedEventCount.store(droppedEventCount, std::memory_order_relaxed);
+            }
+
+        private:
+            std::pair<StringIdx, StringIdx> IndexRoutine(RoutineId routineId)
+            {
+                constexpr auto NotIndexed = std::numeric_limits<StringIdx>::max();
+
+                if (routineId >= m_routineNameIdxs.size())
+                    m_routineNameIdxs.resize(routineId + 1, std::make_pair(NotIndexed, NotIndexed));
+
+                auto& nameIdxs = m_routineNameIdxs[routineId];
+                if (nameIdxs.first == NotIndexed)
+                {
+                    const auto& routine = RoutineRegistry::Instance().Get(routineId);
+                    nameIdxs = std::make_pair(m_dictionary.Index(routine.workerName), m_dictionary.Index(routine.routineName));
+                }
+
+                return nameIdxs;
+            }
+
+            // Publishes the strings indexed since the last call. Returns false if any of them has been dropped, so the record referring to it has to be dropped too.
+            //
+            bool PublishStrings()
+            {
+                for (; m_publishedStringCount < m_dictionary.size(); ++m_publishedStringCount)
+                {
+                    const auto text = m_dictionary.Get(m_publishedStringCount);
+                    const auto size = std::min<size_t>(text.size, 255);
+
+                    m_record.resize(sizeof(StringIdx) + size);
+                    std::memcpy(m_record.data(), &m_publishedStringCount, sizeof(StringIdx));
+                    std::memcpy(m_record.data() + sizeof(StringIdx), text.data, size);
+
+                    if (!WriteRecord(RecordType::String, m_record.data(), m_record.size()))
+                        return false;
+                }
+
+                return true;
+            }
+
+            bool WriteRecord(RecordType type, const void* payload, size_t payloadSize)
+            {
+                if (m_region == nullptr)
+                    return false;
+
+                const uint64_t recordSize = RecordHeaderSize + payloadSize;
+                const uint64_t writePos = m_region->writePos.load(std::memory_order_relaxed);
+
+                auto hasRoom = [&]() {
+                    return m_capacity - (writePos - m_region->readPos.load(std::memory_order_acquire)) >= recordSize;
+                };
+
+                if (!hasRoom())
+                {
+                    const auto deadline = std::chrono::steady_clock::now() + FullRegionTimeout;
+                    while (!m_stalled && !hasRoom())
+                    {
+                        if (std::chrono::steady_clock::now() >= deadline)
+                            m_stalled = true;
+                        else
+                            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                    }
+
+                    if (!hasRoom())
+                    {
+                        m_region->droppedRecordCount.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                }
+
+                m_stalled = false;
+
+                const auto payloadSize32 = static_cast<uint32_t>(payloadSize);
+                Copy(writePos, &payloadSize32, sizeof(payloadSize32));
+                Copy(writePos + sizeof(payloadSize32), &type, sizeof(type));
+                Copy(writePos + RecordHeaderSize, payload, payloadSize);
+
+                m_region->writePos.store(writePos + recordSize, std::memory_order_release);
+                return true;
+            }
+
+            void Copy(uint64_t pos, const void* source, size_t size)
+            {
+                const auto offset = static_cast<size_t>(pos % m_capacity);
+                const auto firstSize = std::min<size_t>(size, static_cast<size_t>(m_capacity) - offset);
+                std::memcpy(m_data + offset, source, firstSize);
+                std::memcpy(m_data, static_cast<const char*>(source) + firstSize, size - firstSize);
+            }
+        };
+
+        // Creates the shared memory segment and drains the records published by the processes to a single bin::BinaryWriter.
+        // Worker and counter group names are prefixed with the name and the identifier of their process, so that the processes are told apart.
+        // A region is given back for reuse once its process has finished, or has died, and all its records have been drained.
+        // A region claimed for longer than ClaimedRegionTimeout is given back too, as its process must have died while setting it up.
+        //
+        class Collector
+        {
+            struct Source
+            {
+                std::string namePrefix;                         // "<processName>[<processId>] "
+                std::vector<std::string> strings;               // Strings of the process by their index in the process.
+                std::vector<StringIdx> stringIdxs;              // Indices of the strings in the writer.
+                std::vector<StringIdx> prefixedStringIdxs;      // Indices of the strings prefixed with namePrefix in the writer (worker and counter group names).
+                std::chrono::steady_clock::time_point claimedTime;  // When the region has been found claimed first, if it has not been activated since.
+                uint64_t droppedRecordCount = 0;                // Records dropped by the process, as counted upon the last drain.
+            };
+
+            static StringIdx NotIndexed() { return std::numeric_limits<StringIdx>::max(); }
+
+            detail::MappedFile m_segment;
+            std::string m_segmentName;
+            std::vector<Source> m_sources;
+            std::vector<char> m_record;
+            std::vector<bin::SpanArg> m_spanArgs;
+            uint64_t m_minSpanDurationNs = 0;
+            uint64_t m_spanOverheadNs = 0;
+            uint64_t m_droppedEventCount = 0;                   // Events lost by the tracers of the finished processes.
+            uint64_t m_droppedRecordCount = 0;                  // Records dropped by all the processes, as their regions have been full.
+
+        public:
+            // How long a process may take to set up the region it has claimed, before the region is taken back.
+            std::chrono::milliseconds ClaimedRegionTimeout { 10000 };
+
+            // Creates the segment of the given name, e.g. "/profane", replacing an existing one.
+            //
+            Collector(const std::string& segmentName, uint32_t regionCount, uint64_t regionSize) :
+                m_segmentName{segmentName},
+                m_sources(regionCount)
+            {
+                const uint64_t pageSize = 4096;
+                regionSize = std::max<uint64_t>((regionSize + pageSize - 1) / pageSize * pageSize, pageSize);
+
+                ::shm_unlink(segmentName.c_str());
+                m_segment.MapSharedMemory(segmentName, static_cast<size_t>(SegmentHeaderSize + regionCount * regionSize));
+
+                auto* const header = new (m_segment.Data()) SegmentHeader{};
+                header->regionCount = regionCount;
+                header->regionSize = regionSize;
+
+                for (uint32_t regionIdx = 0; regionIdx < regionCount; ++regionIdx)
+                    new (RegionAt(m_segment.Data(), regionIdx)) RegionHeader{};
+            }
+
+            Collector(const Collector&) = delete;
+            Collector& operator=(const Collector&) = delete;
+
+            ~Collector()
+            {
+                ::shm_unlink(m_segmentName.c_str());
+            }
+
+            // Writes all the records published so far. Returns the number of records written.
+            //
+            size_t Drain(bin::BinaryWriter& writer)
+            {
+                const auto& header = *reinterpret_cast<const SegmentHeader*>(m_segment.Data());
+                size_t recordCount = 0;
+
+                for (uint32_t regionIdx = 0; regionIdx < header.regionCount; ++regionIdx)
+                {
+                    RegionHeader* const region = RegionAt(m_segment.Data(), regionIdx);
+                    const auto state = region->state.load(std::memory_order_acquire);
+                    Source& source = m_sources[regionIdx];
+
+                    if (state == RegionState::Claimed)
+                    {
+                        TakeBackClaimedRegion(*region, source);
+                        continue;
+                    }
+
+                    if (state != RegionState::Active && state != RegionState::Finished)
+                        continue;
+
+                    // The state is read before the records, so that no record published before finishing is missed.
+                    const bool finished = state == RegionState::Finished || !IsProcessAlive(region->processId, region->processStartTime);
+
+                    if (source.namePrefix.empty())
+                    {
+                        const std::string processName(region->processName, std::find(region->processName, region->processName + sizeof(region->processName) - 1, '\0'));
+                        source.namePrefix = processName + "[" + std::to_string(region->processId) + "] ";
+                    }
+
+                    recordCount += DrainRegion(writer, *region, source, RegionCapacity(header));
+
+                    m_minSpanDurationNs = std::max(m_minSpanDurationNs, region->minSpanDurationNs.load(std::memory_order_relaxed));
+                    m_spanOverheadNs = std::max(m_spanOverheadNs, region->spanOverheadNs.load(std::memory_order_relaxed));
+
+                    const auto droppedRecordCount = region->droppedRecordCount.load(std::memory_order_relaxed);
+                    m_droppedRecordCount += droppedRecordCount - source.droppedRecordCount;
+                    source.droppedRecordCount = droppedRecordCount;
+
+                    if (finished)
+                    {
+                        m_droppedEventCount += region->droppedEventCount.load(std::memory_order_relaxed);
+                        FreeRegion(*region, source);
+                    }
+                }
+
+                writer.SetMinSpanDuration(std::chrono::nanoseconds{m_minSpanDurationNs});
+                writer.SetSpanOverhead(std::chrono::nanoseconds{m_spanOverheadNs});
+                writer.SetDroppedEventCount(m_droppedEventCount);
+                return recordCount;
+            }
+
+            // Returns the number of the records dropped by the processes till the last drain, as their regions have been full.
+            //
+            uint64_t DroppedRecordCount() const noexcept
+            {
+                return m_droppedRecordCount;
+            }
+
+        private:
+            // Gives the region back for reuse, once it has been taken from its process.
+            //
+            void FreeRegion(RegionHeader& region, Source& source)
+            {
+                source = Source{};
+                region.processId = 0;
+                region.processStartTime = 0;
+                std::memset(region.processName, 0, sizeof(region.processName));
+                region.writePos.store(0, std::memory_order_relaxed);
+                region.readPos.store(0, std::memory_order_relaxed);
+                region.droppedRecordCount.store(0, std::memory_order_relaxed);
+                region.droppedEventCount.store(0, std::memory_order_relaxed);
+                region.state.store(RegionState::Free, std::memory_order_release);
+            }
+
+            // Takes the region back, once it has been claimed for longer than ClaimedRegionTimeout.
+            // It is marked as finished first, so that its process cannot activate it anymore, should the process be alive after all.
+            //
+            void TakeBackClaimedRegion(RegionHeader& region, Source& source)
+            {
+                const auto now = std::chrono::steady_clock::now();
+                if (source.claimedTime == std::chrono::steady_clock::time_point{})
+                    source.claimedTime = now;
+
+                auto state = RegionState::Claimed;
+                if (now - source.claimedTime >= ClaimedRegionTimeout && region.state.compare_exchange_strong(state, RegionState::Finished, std::memory_order_acquire))
+                    FreeRegion(region, source);
+            }
+
+            size_t DrainRegion(bin::BinaryWriter& writer, RegionHeader& region, Source& source, uint64_t capacity)
+            {
+                const char* const data = reinterpret_cast<const char*>(&region + 1);
+                const uint64_t writePos = region.writePos.load(std::memory_order_acquire);
+                uint64_t readPos = region.readPos.load(std::memory_order_relaxed);
+                size_t recordCount = 0;
+
+                auto copy = [&](uint64_t pos, void* target, size_t size) {
+                    const auto offset = static_cast<size_t>(pos % capacity);
+                    const auto firstSize = std::min<size_t>(size, static_cast<size_t>(capacity) - offset);
+                    std::memcpy(target, data + offset, firstSize);
+                    std::memcpy(static_cast<char*>(target) + firstSize, data, size - firstSize);
+                };
+
+                while (writePos - readPos >= RecordHeaderSize)
+                {
+                    uint32_t payloadSize;
+                    RecordType type;
+                    copy(readPos, &payloadSize, sizeof(payloadSize));
+                    copy(readPos + sizeof(payloadSize), &type, sizeof(type));
+
+                    m_record.resize(payloadSize);
+                    copy(readPos + RecordHeaderSize, m_record.data(), payloadSize);
+                    readPos += RecordHeaderSize + payloadSize;
+                    ++recordCount;
+
+                    switch (type)
+                    {
+                    case RecordType::String:
+                        if (payloadSize >= sizeof(StringIdx))
+                        {
+                            StringIdx idx;
+                            std::memcpy(&idx, m_record.data(), sizeof(idx));
+                            if (idx >= source.strings.size())
+                            {
+                                source.strings.resize(idx + 1);
+                                source.stringIdxs.resize(idx + 1, NotIndexed());
+                                source.prefixedStringIdxs.resize(idx + 1, NotIndexed());
+                            }
+                            source.strings[idx].assign(m_record.data() + sizeof(idx), payloadSize - sizeof(idx));
+                        }
+                        break;
+
+                    case RecordType::WorkItem:
+                        if (payloadSize >= sizeof(bin::WorkItem))
+                        {
+                            bin::WorkItem workItem;
+                            std::memcpy(&workItem, m_record.data(), sizeof(workItem));
+                            const size_t argsSize = workItem.argCount * sizeof(bin::SpanArg);
+                            const bool hasMetrics = (workItem.metricsIdx != bin::NoMetrics);
+                            if (payloadSize != sizeof(workItem) + argsSize + (hasMetrics ? sizeof(bin::WorkItemMetrics) : 0))
+                                break;
+
+                            workItem.categoryNameIdx = IndexString(writer, source, workItem.categoryNameIdx, false);
+                            workItem.workerNameIdx = IndexString(writer, source, workItem.workerNameIdx, true);
+                            workItem.routineNameIdx = IndexString(writer, source, workItem.routineNameIdx, false);
+                            workItem.commentNameIdx = IndexString(writer, source, workItem.commentNameIdx, false);
+
+                            m_spanArgs.resize(workItem.argCount);
+                            for (uint8_t argIdx = 0; argIdx < workItem.argCount; ++argIdx)
+                            {
+                                std::memcpy(&m_spanArgs[argIdx], m_record.data() + sizeof(workItem) + argIdx * sizeof(bin::SpanArg), sizeof(bin::SpanArg));
+                                m_spanArgs[argIdx].nameIdx = IndexString(writer, source, m_spanArgs[argIdx].nameIdx, false);
+                            }
+
+                            bin::WorkItemMetrics metrics;
+                            if (hasMetrics)
+                                std::memcpy(&metrics, m_record.data() + sizeof(workItem) + argsSize, sizeof(metrics));
+
+                            writer.WriteWorkItem(workItem, m_spanArgs.data(), hasMetrics ? &metrics : nullptr);
+                        }
+                        break;
+
+                    case RecordType::CounterSample:
+                        if (payloadSize == sizeof(bin::CounterSample))
+                        {
+                            bin::CounterSample sample;
+                            std::memcpy(&sample, m_record.data(), sizeof(sample));
+                            sample.counterGroupNameIdx = IndexString(writer, source, sample.counterGroupNameIdx, true);
+                            sample.counterNameIdx = IndexString(writer, source, sample.counterNameIdx, false);
+                            writer.WriteCounterSample(sample);
+                        }
+                        break;
+                    }
+                }
+
+                region.readPos.store(readPos, std::memory_order_release);
+                return recordCount;
+            }
+
+            // Translates the index of a string of the process to the index in the writer.
+            //
+            StringIdx IndexString(bin::BinaryWriter& writer, Source& source, StringIdx idx, bool prefixed)
+            {
+                if (idx == 0 && !prefixed)
+                    return 0;
+
+                if (idx >= source.strings.size())
+                {
+                    source.strings.resize(idx + 1);
+                    source.stringIdxs.resize(idx + 1, NotIndexed());
+                    source.prefixedStringIdxs.resize(idx + 1, NotIndexed());
+                }
+
+                auto& writerIdx = prefixed ? source.prefixedStringIdxs[idx] : source.stringIdxs[idx];
+                if (writerIdx == NotIndexed())
+                {
+                    const auto text = prefixed ? (source.namePrefix + source.strings[idx]).substr(0, 255) : source.strings[idx];
+                    writerIdx = writer.IndexString(text);
+                }
+
+                return writerIdx;
+            }
+        };
+    } // namespace shm
+#endif
+
+    // A clock reading the time stamp counter of the processor, which is much cheaper than reading the system clocks.
+    // Its time points are expressed in ticks of the counter, which are converted to nanoseconds upon serialization (see ClockCalibration).
+    // If the processor has no invariant TSC, the clock falls back to std::chrono::steady_clock and its ticks are nanoseconds.
+    //
+    struct TscClock
+    {
+        using rep = int64_t;
+        using period = std::nano;       // Nominal only, as the actual tick period is known after the calibration.
+        using duration = std::chrono::duration<rep, period>;
+        using time_point = std::chrono::time_point<TscClock>;
+        static constexpr bool is_steady = true;
+
+        // Returns whether the time stamp counter ticks at a constant rate, regardless of the processor power states.
+        static bool IsInvariant() noexcept
+        {
+            static const bool invariant = []() {
+#if PROFANE_HAS_TSC && defined(_MSC_VER)
+                int registers[4];
+                __cpuid(registers, 0x80000000);
+                if (static_cast<unsigned>(registers[0]) < 0x80000007u)
+                    return false;
+                __cpuid(registers, 0x80000007);
+                return (registers[3] & (1 << 8)) != 0;
+#elif PROFANE_HAS_TSC
+                unsigned eax, ebx, ecx, edx;
+                if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007u)
+                    return false;
+                __cpuid(0x80000007, eax, ebx, ecx, edx);
+                return (edx & (1u << 8)) != 0;
+#else
+                return false;
+#endif
+            }();
+
+            return invariant;
+        }
+
+        static time_point now() noexcept
+        {
+#if PROFANE_HAS_TSC
+            if (IsInvariant())
+                return time_point{duration{static_cast<rep>(__rdtsc())}};
+#endif
+            return time_point{std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch())};
+        }
+    };
+
+    // Converts the time points of the clock used by the PerfLogger to the time points passed to WorkItemProto.
+    // Start() is called when the logger is enabled, Update() right before the events are serialized.
+    // By default the time points are passed as they are. Specialize it for clocks which need calibration.
+    //
+    template<typename Clock>
+    class ClockCalibration
+    {
+    public:
+        using ProtoClock = Clock;
+
+        void Start() noexcept {}
+        void Update() noexcept {}
+
+        typename ProtoClock::time_point ToProto(typename Clock::time_point timePoint) const noexcept
+        {
+            return timePoint;
+        }
+
+        std::chrono::nanoseconds ToNanoseconds(typename Clock::duration duration) const noexcept
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
+        }
+
+        typename Clock::duration FromNanoseconds(std::chrono::nanoseconds duration) const noexcept
+        {
+            return std::chrono::duration_cast<typename Clock::duration>(duration);
+        }
+    };
+
+    // Measures the tick period of TscClock against std::chrono::steady_clock, from Start() till the latest Update().
+    // Until the first Update(), the tick period is a rough estimate measured once per process.
+    //
+    template<>
+    class ClockCalibration<TscClock>
+    {
+    public:
+        using ProtoClock = std::chrono::steady_clock;
+
+    private:
+        TscClock::rep m_baseTicks = 0;
+        ProtoClock::time_point m_baseTime;
+        double m_nsPerTick = 1.0;
+
+    public:
+        void Start() noexcept
+        {
+            m_nsPerTick = EstimateNsPerTick();
+            Sample(m_baseTicks, m_baseTime);
+        }
+
+        void Update() noexcept
+        {
+            TscClock::rep ticks;
+            ProtoClock::time_point time;
+            Sample(ticks, time);
+
+            if (TscClock::IsInvariant() && ticks > m_baseTicks)
+                m_nsPerTick = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_baseTime).count()) / static_cast<double>(ticks - m_baseTicks);
+        }
+
+        ProtoClock::time_point ToProto(TscClock::time_point timePoint) const noexcept
+        {
+            const auto ns = static_cast<double>(timePoint.time_since_epoch().count() - m_baseTicks) * m_nsPerTick;
+            return m_baseTime + std::chrono::duration_cast<ProtoClock::duration>(std::chrono::nanoseconds{static_cast<int64_t>(ns)});
+        }
+
+        std::chrono::nanoseconds ToNanoseconds(TscClock::duration duration) const noexcept
+        {
+            return std::chrono::nanoseconds{static_cast<int64_t>(static_cast<double>(duration.count()) * m_nsPerTick)};
+        }
+
+        TscClock::duration FromNanoseconds(std::chrono::nanoseconds duration) const noexcept
+        {
+            return TscClock::duration{static_cast<TscClock::rep>(static_cast<double>(duration.count()) / m_nsPerTick)};
+        }
+
+    private:
+        // Measures the tick period over a millisecond, upon the first call in the process.
+        //
+        static double EstimateNsPerTick() noexcept
+        {
+            static const double nsPerTick = []() {
+                if (!TscClock::IsInvariant())
+                    return 1.0;
+
+                TscClock::rep ticks1, ticks2;
+                ProtoClock::time_point time1, time2;
+                Sample(ticks1, time1);
+                do {
+                    Sample(ticks2, time2);
+                } while (time2 - time1 < std::chrono::milliseconds{1});
+
+                return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(time2 - time1).count()) / static_cast<double>(ticks2 - ticks1);
+            }();
+
+            return nsPerTick;
+        }
+
+        // Takes a pair of time points of both clocks, as close to each other as possible.
+        // Without an invariant TSC both clocks are the same one, so the pair is exact.
+        //
+        static void Sample(TscClock::rep& ticks, ProtoClock::time_point& time) noexcept
+        {
+            if (!TscClock::IsInvariant())
+            {
+                time = ProtoClock::now();
+                ticks = std::chrono::duration_cast<TscClock::duration>(time.time_since_epoch()).count();
+                return;
+            }
+
+            const auto ticks1 = TscClock::now().time_since_epoch().count();
+            time = ProtoClock::now();
+            const auto ticks2 = TscClock::now().time_since_epoch().count();
+            ticks = ticks1 + (ticks2 - ticks1) / 2;
+        }
+    };
+
+    struct ActorBasedTraits
+    {
+        using Clock = std::chrono::high_resolution_clock;
+
+        // The routine is given either by its identifier (preferably registered once per call site), or by its name in form of "<workerName>.<routineName>".
+        // A name is registered in the RoutineRegistry upon every event, which is slower, but fine for names not known in advance.
+        //
+        #pragma pack(push)
+        #pragma pack(1)
+        struct EventData
+        {
+            RoutineId routineId;
+            int16_t workerId;
+            uint32_t taskId;
+
+            EventData() = default;
+
+            EventData(RoutineId routineId_, int16_t workerId_ = 0, uint32_t taskId_ = 0) noexcept :
+                routineId{routineId_},
+                workerId{workerId_},
+                taskId{taskId_}
+            {}
+
+            EventData(const char* workerRoutineName, int16_t workerId_ = 0, uint32_t taskId_ = 0) :
+                EventData{RegisterRoutine(workerRoutineName), workerId_, taskId_}
+            {}
+        };
+        #pragma pack(pop)
+
+        template<typename ProtoClock>
+        static void OnWorkItem(const EventData& eventData, WorkItemProto<ProtoClock>& workItemProto)
+        {
+            workItemProto.routineId = eventData.routineId;
+            workItemProto.taskId = eventData.taskId;
+        }
+    };
+
+    // ActorBasedTraits timestamping the events with TscClock.
+    // It is meant for tracing very short routines, for which the cost of reading a system clock would distort the measurement.
+    //
+    struct TscActorBasedTraits : public ActorBasedTraits
+    {
+        using Clock = TscClock;
+    };
+
+#if PROFANE_HAS_PERF_EVENTS
+    namespace detail
+    {
+        // Performance counters of the calling thread, opened with perf_event_open() upon the first use and closed along with the thread.
+        // The hardware counters are opened as a single group and read with rdpmc, when the kernel lets the user space do it, otherwise with a single read() of the group.
+        // If no hardware counter can be opened (e.g. in a virtual machine or for perf_event_paranoid over 2), the software counters are opened instead.
+        //
+        class PerfCounterReader
+        {
+            struct Group
+            {
+                int leaderFd = -1;
+                uint8_t count = 0;
+                PerfCounter counters[PerfCounterCount];
+                int fds[PerfCounterCount];
+                perf_event_mmap_page* pages[PerfCounterCount];      // Mapped only if all the counters of the group may be read with rdpmc.
+            };
+
+            Group m_hardware;
+            Group m_software;
+            uint8_t m_mask = 0;
+            size_t m_pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+        public:
+            explicit PerfCounterReader(uint8_t requestedMask) noexcept
+            {
+                Open(m_hardware, requestedMask & HardwarePerfCounters);
+                if (m_hardware.count == 0 && (requestedMask & HardwarePerfCounters) != 0)
+                    requestedMask |= SoftwarePerfCounters;
+                Open(m_software, requestedMask & SoftwarePerfCounters);
+                MapPages(m_hardware);
+            }
+
+            ~PerfCounterReader()
+            {
+                Close(m_hardware);
+                Close(m_software);
+            }
+
+            PerfCounterReader(const PerfCounterReader&) = delete;
+            PerfCounterReader& operator=(const PerfCounterReader&) = delete;
+
+            // Returns the reader of the calling thread, opening the requested counters upon the first call on the thread.
+            //
+            template<uint8_t RequestedMask>
+            static PerfCounterReader& ForThisThread() noexcept
+            {
+                static thread_local PerfCounterReader reader{RequestedMask};
+                return reader;
+            }
+
+            // Reads the current values of the counters, by PerfCounter.
+            // Returns the mask of the counters read successfully.
+            //
+            uint8_t Read(uint64_t (&values)[PerfCounterCount]) noexcept
+            {
+                return ReadGroup(m_hardware, values) | ReadGroup(m_software, values);
+            }
+
+        private:
+            static uint8_t Bit(PerfCounter counter) noexcept
+            {
+                return static_cast<uint8_t>(1u << static_cast<uint8_t>(counter));
+            }
+
+            void Open(Group& group, uint8_t mask) noexcept
+            {
+                static const struct { uint32_t type; uint64_t config; } events[PerfCounterCount] = {
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+                    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+                    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+                    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS } };
+
+                for (uint8_t counterIdx = 0; counterIdx < PerfCounterCount; ++counterIdx)
+                {
+                    const PerfCounter counter = static_cast<PerfCounter>(counterIdx);
+                    if ((mask & Bit(counter)) == 0)
+                        continue;
+
+                    perf_event_attr attr;
+                    std::memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.type = events[counterIdx].type;
+                    attr.config = events[counterIdx].config;
+                    attr.read_format = PERF_FORMAT_GROUP;
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+
+                    // The counters, which cannot be opened, are left out. The first one opened leads the group.
+                    const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group.leaderFd, PERF_FLAG_FD_CLOEXEC));
+                    if (fd < 0)
+                        continue;
+
+                    if (group.leaderFd < 0)
+                        group.leaderFd = fd;
+
+                    group.counters[group.count] = counter;
+                    group.fds[group.count] = fd;
+                    group.pages[group.count] = nullptr;
+                    ++group.count;
+                    m_mask |= Bit(counter);
+                }
+            }
+
+            void MapPages(Group& group) noexcept
+            {
+#if PROFANE_HAS_TSC && !defined(_MSC_VER)
+                for (uint8_t memberIdx = 0; memberIdx < group.count; ++memberIdx)
+                {
+                    void* const page = mmap(nullptr, m_pageSize, PROT_READ, MAP_SHARED, group.fds[memberIdx], 0);
+                    if (page == MAP_FAILED)
+                        break;
+
+                    group.pages[memberIdx] = static_cast<perf_event_mmap_page*>(page);
+                    if (!group.pages[memberIdx]->cap_user_rdpmc)
+                        break;
+
+                    if (memberIdx + 1 == group.count)
+                        return;
+                }
+
+                UnmapPages(group);
+#else
+                (void)group;
+#endif
+            }
+
+            void UnmapPages(Group& group) noexcept
+            {
+                for (uint8_t memberIdx = 0; memberIdx < group.count; ++memberIdx)
+                {
+                    if (group.pages[memberIdx] != nullptr)
+                        munmap(group.pages[memberIdx], m_pageSize);
+                    group.pages[memberIdx] = nullptr;
+                }
+            }
+
+            void Close(Group& group) noexcept
+            {
+                UnmapPages(group);
+                for (uint8_t memberIdx = 0; memberIdx < group.count; ++memberIdx)
+                    close(group.fds[memberIdx]);
+                group.count = 0;
+                group.leaderFd = -1;
+            }
+
+            static uint8_t ReadGroup(const Group& group, uint64_t (&values)[PerfCounterCount]) noexcept
+            {
+                if (group.count == 0)
+                    return 0;
+
+                if (group.pages[0] != nullptr && ReadGroupWithRdpmc(group, values))
+                    return GroupMask(group);
+
+                // With PERF_FORMAT_GROUP the leader reads the number of the counters followed by their values.
+                uint64_t buffer[1 + PerfCounterCount];
+                const auto readSize = read(group.leaderFd, buffer, sizeof(buffer));
+                if (readSize < static_cast<ssize_t>(sizeof(uint64_t) * (1 + group.count)) || buffer[0] != group.count)
+                    return 0;
+
+                for (uint8_t memberIdx = 0; memberIdx < group.count; ++memberIdx)
+                    values[static_cast<uint8_t>(group.counters[memberIdx])] = buffer[1 + memberIdx];
+
+                return GroupMask(group);
+            }
+
+            // Reads the counters straight from the processor, following the protocol of perf_event_mmap_page.
+            // Fails if a counter is not scheduled on the processor at the moment, in which case the kernel has to be asked with read().
+            //
+            static bool ReadGroupWithRdpmc(const Group& group, uint64_t (&values)[PerfCounterCount]) noexcept
+            {
+#if PROFANE_HAS_TSC && !defined(_MSC_VER)
+                for (uint8_t memberIdx = 0; memberIdx < group.count; ++memberIdx)
+                {
+                    const volatile perf_event_mmap_page* const page = group.pages[memberIdx];
+                    uint32_t sequence;
+                    uint64_t count;
+
+                    do {
+                        sequence = page->lock;
+                        std::atomic_signal_fence(std::memory_order_seq_cst);
+
+                        const uint32_t index = page->index;
+                        if (index == 0)
+                            return false;
+
+                        const unsigned width = page->pmc_width;
+                        int64_t pmc = static_cast<int64_t>(__rdpmc(static_cast<int>(index - 1)));
+                        pmc = static_cast<int64_t>(static_cast<uint64_t>(pmc) << (64 - width)) >> (64 - width);
+                        count = static_cast<uint64_t>(page->offset) + static_cast<uint64_t>(pmc);
+
+                        std::atomic_signal_fence(std::memory_order_seq_cst);
+                    } while (page->lock != sequence);
+
+                    values[static_cast<uint8_t>(group.counters[memberIdx])] = count;
+                }
+
+                return true;
+#else
+                (void)group;
+                (void)values;
+                return false;
+#endif
+            }
+
+            static uint8_t GroupMask(const Group& group) noexcept
+            {
+                uint8_t mask = 0;
+                for (uint8_t memberIdx = 0; memberIdx < group.count; ++memberIdx)
+                    mask |= Bit(group.counters[memberIdx]);
+                return mask;
+            }
+        };
+    }
+
+    // ActorBasedTraits counting the performance counters of the tracing thread during every span, given by a mask of bits (1 << PerfCounter).
+    // Reading the counters takes from tens of nanoseconds (hardware counters read with rdpmc) to a microsecond (read() syscall) at both ends of a span,
+    // so it is meant for coarse spans. Choose HardwarePerfCounters to avoid the syscall, where the hardware counters are available.
+    // A span must end on the thread it has begun on, and asynchronous spans are not counted.
+    //
+    template<uint8_t Counters>
+    struct BasicPerfCounterActorBasedTraits : public ActorBasedTraits
+    {
+        #pragma pack(push)
+        #pragma pack(1)
+        struct EventData : public ActorBasedTraits::EventData
+        {
+            using ActorBasedTraits::EventData::EventData;
+
+            uint8_t perfCounterMask = 0;                // Counters read at the beginning of the span and, once stopped, also at its end.
+            bool perfCountersStopped = false;
+            uint64_t perfCounters[PerfCounterCount];    // Readings at the beginning of the span, replaced with the increments at its end.
+        };
+        #pragma pack(pop)
+
+        static void OnSpanStart(EventData& eventData) noexcept
+        {
+            eventData.perfCounterMask = detail::PerfCounterReader::ForThisThread<Counters>().Read(eventData.perfCounters);
+            eventData.perfCountersStopped = false;
+        }
+
+        static void OnSpanStop(EventData& eventData) noexcept
+        {
+            uint64_t stopValues[PerfCounterCount];
+            eventData.perfCounterMask &= detail::PerfCounterReader::ForThisThread<Counters>().Read(stopValues);
+
+            for (uint8_t counterIdx = 0; counterIdx < PerfCounterCount; ++counterIdx)
+            {
+                eventData.perfCounters[counterIdx] = ((eventData.perfCounterMask & (1u << counterIdx)) != 0)
+                    ? stopValues[counterIdx] - eventData.perfCounters[counterIdx]
+                    : 0;
+            }
+
+            eventData.perfCountersStopped = true;
+        }
+
+        template<typename ProtoClock>
+        static void OnWorkItem(const EventData& eventData, WorkItemProto<ProtoClock>& workItemProto)
+        {
+            ActorBasedTraits::OnWorkItem(eventData, workItemProto);
+
+            if (eventData.perfCountersStopped)
+            {
+                workItemProto.perfCounterMask = eventData.perfCounterMask;
+                std::memcpy(workItemProto.perfCounters, eventData.perfCounters, sizeof(workItemProto.perfCounters));
+            }
+        }
+    };
+
+    using PerfCounterActorBasedTraits = BasicPerfCounterActorBasedTraits<AllPerfCounters>;
+#endif
+
+    namespace detail
+    {
+        // Returns the identifier of the routine the event data refer to, or 0 if the event data of the traits carry no routine identifier.
+        template<typename EventData>
+        auto RoutineIdOf(const EventData& eventData, int) noexcept -> decltype(static_cast<RoutineId>(eventData.routineId))
+        {
+            return static_cast<RoutineId>(eventData.routineId);
+        }
+
+        template<typename EventData>
+        RoutineId RoutineIdOf(const EventData&, long) noexcept
+        {
+            return 0;
+        }
+
+        // Lets the traits take their own measurements at both ends of a synchronous span (see BasicPerfCounterActorBasedTraits), if they define the hooks.
+        template<typename Traits>
+        auto OnSpanStart(typename Traits::EventData& eventData, int) noexcept -> decltype(Traits::OnSpanStart(eventData))
+        {
+            return Traits::OnSpanStart(eventData);
+        }
+
+        template<typename Traits>
+        void OnSpanStart(typename Traits::EventData&, long) noexcept {}
+
+        template<typename Traits>
+        auto OnSpanStop(typename Traits::EventData& eventData, int) noexcept -> decltype(Traits::OnSpanStop(eventData))
+        {
+            return Traits::OnSpanStop(eventData);
+        }
+
+        template<typename Traits>
+        void OnSpanStop(typename Traits::EventData&, long) noexcept {}
+
+        // Lets the traits leave some events out of the written work items (see InstrumentedFunctionTraits), if they define the filter.
+        template<typename Traits>
+        auto IsEventWritten(const typename Traits::EventData& eventData, int) -> decltype(static_cast<bool>(Traits::IsWritten(eventData)))
+        {
+            return Traits::IsWritten(eventData);
+        }
+
+        template<typename Traits>
+        bool IsEventWritten(const typename Traits::EventData&, long) noexcept
+        {
+            return true;
+        }
+
+#if PROFANE_HAS_SIGNALS
+        // Write end of the pipe, through which the snapshot signal handler wakes up the snapshot writer thread (see PerfLogger::EnableSnapshotSignal()).
+        template<typename = void>
+        struct SnapshotSignalHolder
+        {
+            static std::atomic<int> pipeFd;
+        };
+
+        template<typename T>
+        std::atomic<int> SnapshotSignalHolder<T>::pipeFd = {-1};
+
+        // Writing to a pipe is one of the few things a signal handler may safely do.
+        inline void OnSnapshotSignal(int)
+        {
+            const int savedErrno = errno;
+            const int pipeFd = SnapshotSignalHolder<>::pipeFd.load(std::memory_order_relaxed);
+            if (pipeFd >= 0)
+            {
+                const char request = 's';
+                (void)!::write(pipeFd, &request, 1);
+            }
+            errno = savedErrno;
+        }
+#endif
+
+#if PROFANE_HAS_DLADDR
+        // Returns the demangled name of the function containing the code address, or the module and the offset of the address if it has no exported symbol.
+        // The functions of an executable are exported only if it is linked with -rdynamic.
+        //
+        inline std::string NameCodeAddress(const void* address)
+        {
+            Dl_info info;
+            if (::dladdr(address, &info) == 0)
+            {
+                char text[32];
+                std::snprintf(text, sizeof(text), "%p", address);
+                return text;
+            }
+
+            if (info.dli_sname != nullptr)
+            {
+                int status = 0;
+                char* const demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+                std::string name = (status == 0 && demangled != nullptr) ? demangled : info.dli_sname;
+                std::free(demangled);
+                return name;
+            }
+
+            const char* moduleName = (info.dli_fname != nullptr) ? info.dli_fname : "?";
+            if (const char* const slash = std::strrchr(moduleName, '/'))
+                moduleName = slash + 1;
+
+            char offsetText[32];
+            std::snprintf(offsetText, sizeof(offsetText), "+0x%llx",
+                static_cast<unsigned long long>(static_cast<const char*>(address) - static_cast<const char*>(info.dli_fbase)));
+            return moduleName + std::string{offsetText};
+        }
+#endif
+
+#if PROFANE_HAS_STACK_SAMPLING
+        // Stack samples of a thread, taken by the handler of the profiling signal sent by the CPU time timer of the thread (see PerfLogger::StackSamplingInterval).
+        // The handler, interrupting the thread, is the only writer of the preallocated samples. They are published by the count of the taken samples.
+        // Once the array is full, either the oldest samples are overwritten (in the flight recorder mode) or the new ones are dropped.
+        // Every sample has a sequence number, which the handler clears while it takes the sample, so that the samples are read while the thread is still sampled.
+        //
+        template<typename Clock>
+        struct StackSampleBuffer
+        {
+            struct Sample
+            {
+                typename Clock::time_point time;
+                uint32_t frameCount;
+                uintptr_t frames[bin::StackSampleMaxDepth];     // The interrupted instruction, followed by the return addresses of the calls.
+            };
+
+            std::unique_ptr<Sample[]> samples;
+            std::unique_ptr<std::atomic<uint64_t>[]> sequences; // Per sample, the count of the samples taken once it has been taken, or 0 while it is being taken.
+            uint32_t capacity = 0;
+            bool ring = false;
+            std::atomic<uint64_t> takenCount = {0};             // Samples taken so far, including the overwritten ones.
+            std::atomic<uint64_t> droppedCount = {0};
+            uintptr_t stackBegin = 0;                           // Bounds of the stack of the thread, beyond which the frame pointers are not followed.
+            uintptr_t stackEnd = 0;
+            timer_t timer = {};
+            bool timerStarted = false;
+
+            // Starts the timer of the calling thread. The thread is not sampled if the timer cannot be created (e.g. beyond RLIMIT_SIGPENDING).
+            //
+            void Start(uint32_t sampleCount, bool overwrite, std::chrono::nanoseconds interval)
+            {
+                samples.reset(new Sample[std::max(sampleCount, uint32_t{1})]);
+                sequences.reset(new std::atomic<uint64_t>[std::max(sampleCount, uint32_t{1})]());
+                capacity = std::max(sampleCount, uint32_t{1});
+                ring = overwrite;
+
+                pthread_attr_t attributes;
+                if (::pthread_getattr_np(::pthread_self(), &attributes) == 0)
+                {
+                    void* stackAddress = nullptr;
+                    size_t stackSize = 0;
+                    if (::pthread_attr_getstack(&attributes, &stackAddress, &stackSize) == 0)
+                    {
+                        stackBegin = reinterpret_cast<uintptr_t>(stackAddress);
+                        stackEnd = stackBegin + stackSize;
+                    }
+                    ::pthread_attr_destroy(&attributes);
+                }
+
+                // The signal carries the buffer, so the handler finds it without touching the thread-local storage.
+                sigevent event = {};
+                event.sigev_notify = SIGEV_THREAD_ID;
+                event.sigev_signo = SIGPROF;
+                event.sigev_value.sival_ptr = this;
+                event.sigev_notify_thread_id = static_cast<pid_t>(::syscall(SYS_gettid));
+
+                if (::timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer) != 0)
+                    return;
+
+                itimerspec period = {};
+                period.it_interval.tv_sec = static_cast<time_t>(interval.count() / 1000000000);
+                period.it_interval.tv_nsec = static_cast<long>(interval.count() % 1000000000);
+                period.it_value = period.it_interval;
+                ::timer_settime(timer, 0, &period, nullptr);
+                timerStarted = true;
+            }
+
+            void Stop() noexcept
+            {
+                if (timerStarted)
+                {
+                    ::timer_delete(timer);
+                    timerStarted = false;
+                }
+            }
+
+            // Records the stack of the interrupted thread. Frame pointers are the only means of unwinding, which is safe in a signal handler,
+            // so the frames of the code compiled without them are skipped, or end the stack prematurely. The interrupted instruction is always recorded.
+            //
+            void Take(const ucontext_t& context) noexcept
+            {
+                const uint64_t sampleIdx = takenCount.load(std::memory_order_relaxed);
+                if (sampleIdx >= capacity && !ring)
+                {
+                    droppedCount.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                Sample& sample = samples[sampleIdx % capacity];
+                std::atomic<uint64_t>& sequence = sequences[sampleIdx % capacity];
+                sequence.store(0, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+
+                sample.time = Clock::now();
+
+#if defined(__x86_64__)
+                const auto instructionPointer = static_cast<uintptr_t>(context.uc_mcontext.gregs[REG_RIP]);
+                auto framePointer = static_cast<uintptr_t>(context.uc_mcontext.gregs[REG_RBP]);
+#else
+                const auto instructionPointer = static_cast<uintptr_t>(context.uc_mcontext.pc);
+                auto framePointer = static_cast<uintptr_t>(context.uc_mcontext.regs[29]);
+#endif
+
+                sample.frames[0] = instructionPointer;
+                uint32_t frameCount = 1;
+
+                // A frame begins with the frame pointer of the caller, followed by the return address. The frames of the callers lie higher on the stack.
+                while (frameCount < bin::StackSampleMaxDepth && framePointer >= stackBegin && framePointer + 2 * sizeof(uintptr_t) <= stackEnd && framePointer % sizeof(uintptr_t) == 0)
+                {
+                    const auto* const frame = reinterpret_cast<const uintptr_t*>(framePointer);
+                    if (frame[1] == 0)
+                        break;
+
+                    sample.frames[frameCount++] = frame[1];
+
+                    if (frame[0] <= framePointer)
+                        break;
+
+                    framePointer = frame[0];
+                }
+
+                sample.frameCount = frameCount;
+                sequence.store(sampleIdx + 1, std::memory_order_release);
+                takenCount.store(sampleIdx + 1, std::memory_order_release);
+            }
+
+            // Returns the samples held by the buffer, in order they have been taken.
+            // It may be called while the thread is sampled. The samples overwritten by the handler meanwhile are left out, as their sequence numbers have changed.
+            //
+            std::vector<Sample> Samples() const
+            {
+                const uint64_t count = takenCount.load(std::memory_order_acquire);
+                const uint64_t firstIdx = (ring && count > capacity) ? count - capacity : 0;
+                const uint64_t endIdx = ring ? count : std::min<uint64_t>(count, capacity);
+
+                std::vector<Sample> heldSamples;
+                heldSamples.reserve(static_cast<size_t>(endIdx - firstIdx));
+                for (uint64_t sampleIdx = firstIdx; sampleIdx < endIdx; ++sampleIdx)
+                {
+                    const std::atomic<uint64_t>& sequence = sequences[sampleIdx % capacity];
+                    if (sequence.load(std::memory_order_acquire) != sampleIdx + 1)
+                        continue;
+
+                    heldSamples.push_back(samples[sampleIdx % capacity]);
+
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (sequence.load(std::memory_order_relaxed) != sampleIdx + 1)
+                        heldSamples.pop_back();
+                }
+
+                return heldSamples;
+            }
+        };
+
+        // The PerfLogger sampling the stacks, if any. The handler of the profiling signal is installed for good, so that the signals of the deleted timers,
+        // which may still be pending, do not terminate the process. Such late signals are ignored.
+        template<typename = void>
+        struct StackSamplerHolder
+        {
+            static std::atomic<const void*> owner;
+            static std::atomic<uint32_t> runningHandlerCount;     // Handlers, which may be taking a sample, so their buffer has to stay allocated.
+        };
+
+        template<typename T>
+        std::atomic<const void*> StackSamplerHolder<T>::owner = {nullptr};
+
+        template<typename T>
+        std::atomic<uint32_t> StackSamplerHolder<T>::runningHandlerCount = {0};
+
+        // Signals other than those of the timers (e.g. of setitimer()) are ignored as well.
+        template<typename Clock>
+        void OnStackSampleSignal(int, siginfo_t* info, void* context)
+        {
+            const int savedErrno = errno;
+            StackSamplerHolder<>::runningHandlerCount.fetch_add(1);
+
+            if (info->si_code == SI_TIMER && StackSamplerHolder<>::owner.load() != nullptr)
+                static_cast<StackSampleBuffer<Clock>*>(info->si_value.sival_ptr)->Take(*static_cast<const ucontext_t*>(context));
+
+            StackSamplerHolder<>::runningHandlerCount.fetch_sub(1);
+            errno = savedErrno;
+        }
+#endif
+
+        // Clock of the work items recovered from an event buffer file, whose time points are nanoseconds of the clock of the crashed process.
+        struct RecoveredClock
+        {
+            using rep = int64_t;
+            using period = std::nano;
+            using duration = std::chrono::nanoseconds;
+            using time_point = std::chrono::time_point<RecoveredClock>;
+            static constexpr bool is_steady = true;
+        };
+
+        template<typename = void>
+        struct AllocationCountersHolder
+        {
+            static thread_local AllocationCounters counters;
+            static std::atomic<bool> hooksDefined;
+        };
+
+        template<typename T>
+        thread_local AllocationCounters AllocationCountersHolder<T>::counters = {};
+
+        template<typename T>
+        std::atomic<bool> AllocationCountersHolder<T>::hooksDefined = {false};
+    }
+
+    // Returns the heap allocations made by the calling thread so far.
+    //
+    inline const AllocationCounters& ThreadAllocationCounters() noexcept
+    {
+        return detail::AllocationCountersHolder<>::counters;
+    }
+
+    // Counts a heap allocation of the calling thread. It is called by the allocation hooks (see PROFANE_DEFINE_ALLOCATION_HOOKS),
+    // but a custom allocator, which bypasses them (e.g. a pool of its own), may call it as well.
+    //
+    inline void CountAllocation(size_t size) noexcept
+    {
+        auto& counters = detail::AllocationCountersHolder<>::counters;
+        ++counters.allocationCount;
+        counters.allocatedBytes += size;
+    }
+
+    // Returns whether the allocations are counted at all, i.e. whether the allocation hooks are defined in the program.
+    //
+    inline bool AreAllocationsCounted() noexcept
+    {
+        return detail::AllocationCountersHolder<>::hooksDefined.load(std::memory_order_relaxed);
+    }
+
+    // Traits counting the heap allocations of the tracing thread during every synchronous span, on top of any other traits.
+    // The allocations are counted by the hooks of the global operator new (or of malloc), which one source file of the program has to define
+    // by defining PROFANE_DEFINE_ALLOCATION_HOOKS before including this header. Without the hooks, no work item is flagged with allocations.
+    // Allocations of the nested spans are included in the enclosing ones.
+    //
+    template<typename BaseTraits>
+    struct AllocationTrackingTraits : public BaseTraits
+    {
+        using BaseEventData = typename BaseTraits::EventData;
+
+        #pragma pack(push)
+        #pragma pack(1)
+        struct EventData : public BaseEventData
+        {
+            using BaseEventData::BaseEventData;
+
+            bool allocationsStopped = false;
+            AllocationCounters allocations;     // Counters of the thread at the beginning of the span, replaced with the increments at its end.
+        };
+        #pragma pack(pop)
+
+        static void OnSpanStart(EventData& eventData) noexcept
+        {
+            detail::OnSpanStart<BaseTraits>(eventData, 0);
+            eventData.allocationsStopped = false;
+            eventData.allocations = ThreadAllocationCounters();
+        }
+
+        static void OnSpanStop(EventData& eventData) noexcept
+        {
+            const AllocationCounters stopCounters = ThreadAllocationCounters();
+            eventData.allocations.allocationCount = stopCounters.allocationCount - eventData.allocations.allocationCount;
+            eventData.allocations.allocatedBytes = stopCounters.allocatedBytes - eventData.allocations.allocatedBytes;
+            eventData.allocationsStopped = true;
+            detail::OnSpanStop<BaseTraits>(eventData, 0);
+        }
+
+        template<typename ProtoClock>
+        static void OnWorkItem(const EventData& eventData, WorkItemProto<ProtoClock>& workItemProto)
+        {
+            BaseTraits::OnWorkItem(eventData, workItemProto);
+
+            if (eventData.allocationsStopped && AreAllocationsCounted())
+            {
+                workItemProto.flags |= WorkItemFlags::Allocations;
+                workItemProto.allocationCount = eventData.allocations.allocationCount;
+                workItemProto.allocatedBytes = eventData.allocations.allocatedBytes;
+            }
+        }
+    };
+
+    using AllocationTrackingActorBasedTraits = AllocationTrackingTraits<ActorBasedTraits>;
+
+    namespace detail
+    {
+        // Reads the CPU time consumed by the calling thread so far. Returns false if the platform has no clock of the thread's CPU time.
+        inline bool ReadThreadCpuTimeNs(uint64_t& cpuTimeNs) noexcept
+        {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+            timespec time;
+            if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+                return false;
+
+            cpuTimeNs = static_cast<uint64_t>(time.tv_sec) * 1000000000u + static_cast<uint64_t>(time.tv_nsec);
+            return true;
+#else
+            (void)cpuTimeNs;
+            return false;
+#endif
+        }
+    }
+
+    // Traits measuring the CPU time of the tracing thread (CLOCK_THREAD_CPUTIME_ID) during every synchronous span, on top of any other traits.
+    // The rest of the duration of a span has been spent off the CPU, i.e. blocked or preempted.
+    // Reading the clock is a system call on Linux (the vDSO does not serve it), so it suits spans of microseconds rather than of nanoseconds.
+    // Without such a clock (e.g. on Windows), no work item is flagged with the CPU time.
+    //
+    template<typename BaseTraits>
+    struct ThreadCpuTimeTraits : public BaseTraits
+    {
+        using BaseEventData = typename BaseTraits::EventData;
+
+        #pragma pack(push)
+        #pragma pack(1)
+        struct EventData : public BaseEventData
+        {
+            using BaseEventData::BaseEventData;
+
+            bool cpuTimeStarted = false;
+            bool cpuTimeStopped = false;
+            uint64_t cpuTimeNs = 0;             // CPU time of the thread at the beginning of the span, replaced with the increment at its end.
+        };
+        #pragma pack(pop)
+
+        // The clock is read after the hooks of the base traits upon the start, and before them upon the stop, so that it does not measure them.
+        static void OnSpanStart(EventData& eventData) noexcept
+        {
+            detail::OnSpanStart<BaseTraits>(eventData, 0);
+            eventData.cpuTimeStopped = false;
+            eventData.cpuTimeStarted = detail::ReadThreadCpuTimeNs(eventData.cpuTimeNs);
+        }
+
+        static void OnSpanStop(EventData& eventData) noexcept
+        {
+            uint64_t stopCpuTimeNs;
+            if (eventData.cpuTimeStarted && detail::ReadThreadCpuTimeNs(stopCpuTimeNs))
+            {
+                eventData.cpuTimeNs = stopCpuTimeNs - eventData.cpuTimeNs;
+                eventData.cpuTimeStopped = true;
+            }
+
+            detail::OnSpanStop<BaseTraits>(eventData, 0);
+        }
+
+        template<typename ProtoClock>
+        static void OnWorkItem(const EventData& eventData, WorkItemProto<ProtoClock>& workItemProto)
+        {
+            BaseTraits::OnWorkItem(eventData, workItemProto);
+
+            if (eventData.cpuTimeStopped)
+            {
+                workItemProto.flags |= WorkItemFlags::CpuTime;
+                workItemProto.cpuTimeNs = eventData.cpuTimeNs;
+            }
+        }
+    };
+
+    using ThreadCpuTimeActorBasedTraits = ThreadCpuTimeTraits<ActorBasedTraits>;
+
+#if PROFANE_HAS_SCHED_STATS
+    // Traits recording the CPU the tracing thread runs on at both ends of every synchronous span, along with the context switches of the thread
+    // during it (getrusage(RUSAGE_THREAD)), on top of any other traits. A span stopping on another CPU than it has started on has migrated.
+    // Voluntary switches are made by the thread blocking, involuntary ones by it being preempted, e.g. on an oversubscribed CPU.
+    // Each end of a span costs a system call. Spans, for which either call fails, are not flagged with the scheduling.
+    //
+    template<typename BaseTraits>
+    struct SchedulingTraits : public BaseTraits
+    {
+        using BaseEventData = typename BaseTraits::EventData;
+
+        #pragma pack(push)
+        #pragma pack(1)
+        struct EventData : public BaseEventData
+        {
+            using BaseEventData::BaseEventData;
+
+            bool schedulingStarted = false;
+            bool schedulingStopped = false;
+            uint16_t startCpu = 0;
+            uint16_t stopCpu = 0;
+            uint32_t voluntarySwitches = 0;     // Context switches of the thread at the beginning of the span, replaced with the increments at its end.
+            uint32_t involuntarySwitches = 0;
+        };
+        #pragma pack(pop)
+
+        // The CPU is read last upon the start and first upon the stop, so that it is the closest to the time stamps of the span.
+        static void OnSpanStart(EventData& eventData) noexcept
+        {
+            detail::OnSpanStart<BaseTraits>(eventData, 0);
+
+            eventData.schedulingStarted = false;
+            eventData.schedulingStopped = false;
+
+            struct rusage usage;
+            if (::getrusage(RUSAGE_THREAD, &usage) != 0)
+                return;
+
+            const int cpu = ::sched_getcpu();
+            if (cpu < 0)
+                return;
+
+            eventData.startCpu = static_cast<uint16_t>(cpu);
+            eventData.voluntarySwitches = static_cast<uint32_t>(usage.ru_nvcsw);
+            eventData.involuntarySwitches = static_cast<uint32_t>(usage.ru_nivcsw);
+            eventData.schedulingStarted = true;
+        }
+
+        static void OnSpanStop(EventData& eventData) noexcept
+        {
+            const int cpu = ::sched_getcpu();
+
+            struct rusage usage;
+            if (eventData.schedulingStarted && cpu >= 0 && ::getrusage(RUSAGE_THREAD, &usage) == 0)
+            {
+                eventData.stopCpu = static_cast<uint16_t>(cpu);
+                eventData.voluntarySwitches = static_cast<uint32_t>(usage.ru_nvcsw) - eventData.voluntarySwitches;
+                eventData.involuntarySwitches = static_cast<uint32_t>(usage.ru_nivcsw) - eventData.involuntarySwitches;
+                eventData.schedulingStopped = true;
+            }
+
+            detail::OnSpanStop<BaseTraits>(eventData, 0);
+        }
+
+        template<typename ProtoClock>
+        static void OnWorkItem(const EventData& eventData, WorkItemProto<ProtoClock>& workItemProto)
+        {
+            BaseTraits::OnWorkItem(eventData, workItemProto);
+
+            if (eventData.schedulingStopped)
+            {
+                workItemProto.flags |= WorkItemFlags::Scheduling;
+                workItemProto.startCpu = eventData.startCpu;
+                workItemProto.stopCpu = eventData.stopCpu;
+                workItemProto.voluntarySwitches = eventData.voluntarySwitches;
+                workItemProto.involuntarySwitches = eventData.involuntarySwitches;
+            }
+        }
+    };
+
+    using SchedulingActorBasedTraits = SchedulingTraits<ActorBasedTraits>;
+#endif
+
+    // Determines which events are kept when the event pool of a PerfLogger gets exhausted.
+    //
+    enum class RecordingMode
+    {
+        KeepFirst,          // New events are dropped, so the first events traced since Enable() are kept.
+        FlightRecorder,     // New events overwrite the oldest events of the thread, so the latest events are kept.
+        Streaming,          // Filled chunks are written out by a background thread and reused, so all the events are kept.
+        Aggregate,          // Spans are counted in the duration histograms of their routines instead of the event pool, so only the statistics are kept.
+    };
+
+    // Collects the event logs and generates the usable data upon finish.
+    // Every tracing thread records its events to its own buffer, which consists of chunks of events claimed from the event pool preallocated by Enable().
+    // Claiming a chunk is the only moment the tracing threads touch shared data, so Trace() does not contend even when called from many threads at once.
+    //
+    template<typename Traits>
+    class PerfLogger
+    {
+        #pragma pack(push)
+        #pragma pack(1)
+        struct Event
+        {
+            typename Traits::Clock::time_point startTime;
+            typename Traits::Clock::time_point stopTime = {};
+            typename Traits::EventData data = {};
+            uint8_t flags = 0;                              // Combination of WorkItemFlags.
+            SpanArgs args = {};
+        };
+
+        struct CounterSample
+        {
+            typename Traits::Clock::time_point time;
+            RoutineId counterId;
+            int64_t value;
+        };
+        #pragma pack(pop)
+
+        // Number of counter samples claimed at once by a thread from the counter sample pool.
+        static constexpr uint32_t CounterSamplesPerChunk = 256;
+
+        // Durations of the spans of a routine traced by a single thread in RecordingMode::Aggregate.
+        //
+        struct DurationHistogram
+        {
+            uint64_t callCount = 0;
+            typename Traits::Clock::duration totalDuration = {};
+            typename Traits::Clock::duration minDuration = Traits::Clock::duration::max();
+            typename Traits::Clock::duration maxDuration = {};
+            uint64_t bucketCounts[bin::DurationBucketCount] = {};       // Calls by the bucket of their duration in clock ticks (see bin::DurationBucketOf()).
+        };
+
+        // State of a routine traced by a single thread: its sampling (see SamplingRule), its dropped short events (see MinSpanDuration)
+        // and its aggregated durations (see RecordingMode::Aggregate).
+        //
+        struct RoutineState
+        {
+            ~RoutineState()
+            {
+                delete histogram.load(std::memory_order_relaxed);
+            }
+
+            bool resolved = false;                          // Whether the sampling rule of the routine has been looked up.
+            bool sampled = false;                           // Whether any sampling rule applies to the routine.
+            SamplingMode mode = SamplingMode::None;
+            uint32_t ruleIdx = 0;
+            uint32_t period = 1;                            // Every period-th call is traced (EveryNth and MaxPerSecond).
+            uint32_t countdown = 1;                         // Number of calls till the next traced one.
+            uint32_t threshold = 0;                         // A call is traced if the random number of the thread is below it (Probabilistic).
+            uint32_t maxPerSecond = 0;
+            uint32_t windowTracedCount = 0;                 // Calls traced since the start of the current one second window (MaxPerSecond).
+            uint64_t windowCallCount = 0;                   // Value of callCount at the start of the current window (MaxPerSecond).
+            std::chrono::steady_clock::time_point windowStart;
+            uint64_t callCount = 0;
+            uint64_t tracedCount = 0;
+            uint64_t droppedCount = 0;
+            typename Traits::Clock::duration droppedDuration = {};
+            std::atomic<DurationHistogram*> histogram = {nullptr};     // Allocated upon the first aggregated span.
+        };
+
+        // Routine states of a thread are allocated in blocks indexed by the routine identifier.
+        // Routines of identifiers beyond the capacity of the blocks are neither sampled, nor dropped.
+        static constexpr uint32_t RoutineStateBlockSize = 256;
+        static constexpr uint32_t RoutineStateBlockCount = 256;
+
+        // Events traced by a single thread. Only the owning thread writes to the buffer.
+        // The chunk count and the cursor are atomic, so that the buffer may be safely read upon Finish().
+        // In the flight recorder mode the chunks form a ring, which is reused once the event pool is exhausted.
+        //
+        struct ThreadBuffer
+        {
+            ~ThreadBuffer()
+            {
+                if (routineStateBlocks != nullptr)
+                {
+                    for (uint32_t blockIdx = 0; blockIdx < RoutineStateBlockCount; ++blockIdx)
+                        delete[] routineStateBlocks[blockIdx].load(std::memory_order_relaxed);
+                }
+            }
+
+            std::thread::id threadId;
+            std::unique_ptr<Event*[]> chunks;               // Chunks claimed from the event pool, in order of claim.
+            std::atomic<uint32_t> chunkCount = {0};         // Number of claimed chunks.
+            std::atomic<uint32_t> writeChunkIdx = {0};      // Index of the chunk currently written to.
+            std::atomic<bool> wrapped = {false};            // Whether the chunks have been reused at least once.
+            std::atomic<Event*> cursor = {nullptr};         // Place for the next event within the written chunk.
+            Event* chunkEnd = nullptr;                      // End of the written chunk.
+            std::atomic<uint64_t> droppedEventCount = {0};  // Events lost for want of a chunk. Only the owning thread counts them.
+            PerfLogger* streamingLogger = nullptr;          // Set in RecordingMode::Streaming, so that the stopped events are counted by chunk (see CountStoppedEvent()).
+            bool starved = false;                           // Whether the stream writer has been woken up for want of a free chunk.
+            std::unique_ptr<std::atomic<RoutineState*>[]> routineStateBlocks;    // Allocated if any sampling rule or MinSpanDuration is set, or the spans are aggregated.
+            bool aggregating = false;                       // Whether the spans are aggregated (see RecordingMode::Aggregate).
+            std::atomic<uint64_t> unaggregatedCount = {0};  // Spans, which could not be aggregated.
+            uint32_t random = 1;                            // State of the random number generator of the Probabilistic sampling.
+            typename Traits::Clock::duration minSpanDuration = {};
+            std::unique_ptr<CounterSample*[]> counterChunks;                 // Chunks claimed from the counter sample pool, in order of claim.
+            std::atomic<uint32_t> counterChunkCount = {0};
+            std::atomic<CounterSample*> counterCursor = {nullptr};          // Place for the next counter sample within the last claimed chunk.
+            CounterSample* counterChunkEnd = nullptr;
+#if PROFANE_HAS_STACK_SAMPLING
+            std::unique_ptr<detail::StackSampleBuffer<typename Traits::Clock>> stackSamples;    // Allocated if the stacks are sampled.
+#endif
+            char padding[64];                               // Keeps the cursors of the buffers in separate cache lines.
+        };
+
+        // Thread's cached reference to its buffer.
+        // It is valid as long as the session identifier matches the one of the logger.
+        //
+        struct LocalHandle
+        {
+            uint64_t sessionId;
+            ThreadBuffer* buffer;
+        };
+
+        // Consecutive events of a chunk.
+        //
+        struct EventRange
+        {
+            Event* begin;
+            Event* end;
+        };
+
+        static thread_local LocalHandle t_localHandle;
+
+        std::ostream* m_out = nullptr;
+        const char* m_outFileName = nullptr;
+        typename Traits::Clock::time_point m_startTime;
+        ClockCalibration<typename Traits::Clock> m_clockCalibration;
+        std::mutex m_clockCalibrationMutex;                 // Serializes the updates of m_clockCalibration with its copies by Snapshot().
+        std::atomic<uint64_t> m_sessionId = {0};            // Identifier of the current tracing session. 0 if the logger does not accept new events.
+        RecordingMode m_recordingMode = RecordingMode::KeepFirst;
+        Event* m_events = nullptr;                          // The event pool, divided into chunks. It is either m_eventStorage or the mapped event buffer file.
+        uint32_t m_eventCount = 0;
+        std::vector<Event> m_eventStorage;
+        uint32_t m_chunkSize = 0;
+        uint32_t m_chunkCount = 0;
+        std::atomic<uint32_t> m_claimedChunkCount = {0};
+        std::mutex m_threadBuffersMutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> m_threadBuffers;
+        std::vector<SamplingRule> m_samplingRules;          // Copy of SamplingRules taken upon Enable().
+        bool m_samplingEnabled = false;
+        typename Traits::Clock::duration m_minSpanDuration = {};
+        std::chrono::nanoseconds m_spanOverhead { 0 };
+        std::vector<CounterSample> m_counterSamples;        // The counter sample pool, divided into chunks.
+        uint32_t m_counterChunkCount = 0;
+        std::atomic<uint32_t> m_claimedCounterChunkCount = {0};
+        bool m_stackSampling = false;                       // Whether the new thread buffers get their stacks sampled. Guarded by m_threadBuffersMutex.
+        std::chrono::nanoseconds m_stackSamplingInterval { 0 };
+        uint32_t m_stackSamplesPerThread = 0;
+
+        // State of the stream writer (used in RecordingMode::Streaming only).
+        std::ofstream m_outFile;
+        std::unique_ptr<bin::BinaryWriter> m_streamWriter;
+#if PROFANE_HAS_MMAP
+        std::unique_ptr<shm::RegionWriter> m_regionWriter;  // Stands in for m_streamWriter if enabled by EnableSharedMemory().
+#endif
+        std::thread m_streamThread;
+        std::mutex m_streamMutex;                           // Guards the chunk lists shared by the tracing threads and the stream writer.
+        std::condition_variable m_streamCondition;
+        bool m_streamStopping = false;
+        std::vector<Event*> m_freeChunks;
+        std::atomic<uint32_t> m_freeChunkCount = {0};
+        std::vector<Event*> m_filledChunks;
+        std::vector<Event*> m_pendingChunks;                // Owned by the stream writer thread.
+        std::unique_ptr<std::atomic<uint32_t>[]> m_chunkStoppedCounts;  // Stopped events by chunk of the event pool. A chunk is complete once all its events are stopped.
+
+        // Copies the names of the newly registered routines to the journal of the event buffer file, so that the recovered events may be named.
+        //
+        class RoutineJournal : public RoutineRegistry::Observer
+        {
+            bin::EventBufferHeader* m_header = nullptr;
+            char* m_names = nullptr;
+
+        public:
+            void Attach(bin::EventBufferHeader* header, char* names)
+            {
+                Detach();
+                m_header = header;
+                m_names = names;
+                RoutineRegistry::Instance().AddObserver(this);
+            }
+
+            void Detach()
+            {
+                if (m_header == nullptr)
+                    return;
+
+                RoutineRegistry::Instance().RemoveObserver(this);
+                m_header = nullptr;
+                m_names = nullptr;
+            }
+
+            void OnRoutineRegistered(RoutineId routineId, const RoutineRegistry::Routine& routine) override
+            {
+                const size_t size = m_header->routineNamesSize.load(std::memory_order_relaxed);
+                const auto workerNameSize = static_cast<uint8_t>(std::min<size_t>(routine.workerName.size(), 255));
+                const auto routineNameSize = static_cast<uint8_t>(std::min<size_t>(routine.routineName.size(), 255));
+                const size_t recordSize = sizeof(routineId) + 2 + workerNameSize + routineNameSize;
+
+                // Routines beyond the capacity of the journal are recovered without their names.
+                if (size + recordSize > m_header->routineNamesCapacity)
+                    return;
+
+                char* record = m_names + size;
+                std::memcpy(record, &routineId, sizeof(routineId));
+                record += sizeof(routineId);
+                *record++ = static_cast<char>(workerNameSize);
+                std::memcpy(record, routine.workerName.data(), workerNameSize);
+                record += workerNameSize;
+                *record++ = static_cast<char>(routineNameSize);
+                std::memcpy(record, routine.routineName.data(), routineNameSize);
+
+                m_header->routineNamesSize.store(static_cast<uint32_t>(size + recordSize), std::memory_order_release);
+            }
+        };
+
+        // State of the event buffer file (used if EventBufferFilePath is set).
+        detail::MappedFile m_eventBufferFile;
+        bin::EventBufferHeader* m_eventBufferHeader = nullptr;
+        std::string m_eventBufferFilePath;                  // Path of the mapped file, removed once the events are written out or discarded.
+        RoutineJournal m_routineJournal;
+
+        // Serializes snapshots with each other and with Enable(). It is never locked by the tracing threads.
+        std::mutex m_snapshotMutex;
+
+#if PROFANE_HAS_SIGNALS
+        // State of the snapshot writer (used if EnableSnapshotSignal() has been called).
+        std::thread m_snapshotThread;
+        int m_snapshotPipe[2] = {-1, -1};
+        int m_snapshotSignal = 0;
+        struct sigaction m_previousSignalAction;
+        std::string m_snapshotFileNamePrefix;
+#endif
+
+        // Capacity of the routine name journal of the event buffer file. The file is sparse, so the unused capacity takes no disk space.
+        static constexpr uint32_t EventBufferRoutineNamesCapacity = 1024 * 1024;
+
+    public:
+        // The purpose of a Tracer object is put a timestamp on Event::stopTime of the specified event object upon its destruction.
+        // The start time of the event is remembered, so that the Tracer does not stop a newer event, which has overwritten its one in the flight recorder mode.
+        // An event shorter than MinSpanDuration is dropped instead, if its slot may be given back to the thread buffer.
+        // In RecordingMode::Aggregate the Tracer holds no event, but the start time and the routine of the span, which it counts in the duration histogram of the routine.
+        //
+        class Tracer
+        {
+            ThreadBuffer* m_buffer = nullptr;               // nullptr if the span is not traced, or it has been stopped.
+            Event* m_event = nullptr;                       // nullptr if the span is aggregated.
+            typename Traits::Clock::time_point m_startTime;
+            RoutineId m_routineId = 0;                      // Routine of the aggregated span.
+
+            Tracer(Event* event, ThreadBuffer* buffer) noexcept : m_buffer{buffer}, m_event{event}, m_startTime{event->startTime} {}
+            Tracer(ThreadBuffer* buffer, RoutineId routineId) noexcept : m_buffer{buffer}, m_startTime{Traits::Clock::now()}, m_routineId{routineId} {}
+
+        public:
+            Tracer() = default;
+            Tracer(const Tracer&) = delete;
+
+            Tracer(Tracer&& other) noexcept : m_buffer{detail::exchange(other.m_buffer, nullptr)}, m_event{other.m_event}, m_startTime{other.m_startTime}, m_routineId{other.m_routineId} {}
+
+            ~Tracer() noexcept
+            {
+                TraceStop();
+            }
+
+            void Stop() noexcept
+            {
+                TraceStop();
+                m_buffer = nullptr;
+            }
+
+            // Attaches the numeric argument (e.g. the number of bytes processed) to the span, unless it already has PROFANE_MAX_SPAN_ARGS of them.
+            // The argument has to be attached before the span is stopped.
+            //
+            void Arg(RoutineId argId, int64_t value) noexcept
+            {
+                if (m_buffer != nullptr && m_event != nullptr && m_event->startTime == m_startTime)
+                    m_event->args.Add(argId, value);
+            }
+
+            // Same as above, but the argument is given by its name in form of "<groupName>.<argName>" (preferably a string literal).
+            //
+            void Arg(const char* argName, int64_t value)
+            {
+                if (m_buffer != nullptr && m_event != nullptr)
+                    Arg(RegisterRoutine(argName), value);
+            }
+
+        private:
+            // Only the check of an untraced span (e.g. of a disabled category) is inlined, so that it costs next to nothing.
+            void TraceStop() noexcept
+            {
+                if (m_buffer != nullptr)
+                    StopSpan();
+            }
+
+            PROFANE_NOINLINE void StopSpan() noexcept
+            {
+                if (m_event == nullptr)
+                {
+                    AggregateSpan(*m_buffer, m_routineId, Traits::Clock::now() - m_startTime);
+                    return;
+                }
+
+                if (m_event->startTime != m_startTime)
+                    return;
+
+                const auto stopTime = Traits::Clock::now();
+
+                if (stopTime - m_startTime < m_buffer->minSpanDuration && DropEvent(*m_buffer, m_event, stopTime - m_startTime))
+                    return;
+
+                detail::OnSpanStop<Traits>(m_event->data, 0);
+                m_event->stopTime = stopTime;
+
+                if (m_buffer->streamingLogger != nullptr)
+                    m_buffer->streamingLogger->CountStoppedEvent(m_event);
+            }
+
+            friend class PerfLogger<Traits>;
+        };
+
+        // An asynchronous span, which may begin on one thread and end on another (e.g. a request handed over between thread pools).
+        // Nothing is recorded until the span ends. Then the whole span is recorded as an event of the ending thread, so no thread writes to the buffer of another.
+        // Spans and events of the same task are linked by the taskId of their event data.
+        //
+        class AsyncSpan
+        {
+            PerfLogger* m_logger = nullptr;
+            typename Traits::Clock::time_point m_startTime;
+            typename Traits::EventData m_data;
+            SpanArgs m_args = {};
+
+            AsyncSpan(PerfLogger* logger, typename Traits::EventData&& data) noexcept : m_logger{logger}, m_startTime{Traits::Clock::now()}, m_data(std::move(data)) {}
+
+        public:
+            AsyncSpan() = default;
+            AsyncSpan(const AsyncSpan&) = delete;
+
+            AsyncSpan(AsyncSpan&& other) noexcept : m_logger{detail::exchange(other.m_logger, nullptr)}, m_startTime{other.m_startTime}, m_data(std::move(other.m_data)), m_args(other.m_args) {}
+
+            AsyncSpan& operator=(AsyncSpan&& other) noexcept
+            {
+                End();
+                m_logger = detail::exchange(other.m_logger, nullptr);
+                m_startTime = other.m_startTime;
+                m_data = std::move(other.m_data);
+                m_args = other.m_args;
+                return *this;
+            }
+
+            // Attaches the numeric argument to the span (see Tracer::Arg()).
+            //
+            void Arg(RoutineId argId, int64_t value) noexcept
+            {
+                if (m_logger != nullptr)
+                    m_args.Add(argId, value);
+            }
+
+            void Arg(const char* argName, int64_t value)
+            {
+                if (m_logger != nullptr)
+                    m_args.Add(RegisterRoutine(argName), value);
+            }
+
+            ~AsyncSpan() noexcept
+            {
+                End();
+            }
+
+            // Records the span as an event of the calling thread. Later calls have no effect.
+            //
+            void End() noexcept
+            {
+                if (m_logger != nullptr)
+                    detail::exchange(m_logger, nullptr)->TraceAsyncEnd(m_startTime, m_data, m_args);
+            }
+
+            friend class PerfLogger<Traits>;
+        };
+
+        std::string ProgramName;
+        std::string Description;
+
+        // Number of events claimed at once by a thread from the event pool.
+        // The smaller the chunks, the more evenly the pool is shared among threads, at the cost of more frequent claims.
+        uint32_t EventsPerChunk = 1024;
+
+        // Period of the stream writer passes in RecordingMode::Streaming.
+        // The event pool has to hold at least two periods worth of events, otherwise events get dropped.
+        std::chrono::milliseconds StreamFlushInterval { 10 };
+
+        // Capacity of the counter sample pool allocated upon Enable().
+        // Counter samples are kept apart from the events. Once the pool is exhausted, new samples are dropped regardless of the RecordingMode.
+        uint32_t CounterSampleCount = 64 * 1024;
+
+        // Events shorter than that are dropped upon their stop, so that their slots in the event pool are reused by the next events.
+        // It works for events of a routine identifier (see SamplingRules), stopped by the tracing thread before it starts another event.
+        // The number and the total duration of the dropped events are written to the file for every routine.
+        std::chrono::nanoseconds MinSpanDuration { 0 };
+
+        // Rules limiting the tracing of frequently called routines, applied upon Enable().
+        // The routine of an event is determined by the routineId member of Traits::EventData. Events without it are always traced.
+        // The number of calls and traced calls of the sampled routines are written to the file, so that the statistics may be scaled up.
+        std::vector<SamplingRule> SamplingRules;
+
+        // Whether Enable() measures the tracer overhead per span (see SpanOverhead()).
+        // The measurement takes about a hundred microseconds. Its result is written to the file, so that the analyser may compensate for it.
+        bool CalibrateOverhead = true;
+
+        // If set, Enable() maps the event pool to a file of this path (POSIX only), instead of allocating it on the heap.
+        // The events traced before a crash of the process stay in the file, from which they may be recovered (see RecoverEventBuffer()).
+        // Upon Finish() or Disable() the file is removed. Neither RecordingMode::Streaming nor counter samples are backed by the file.
+        std::string EventBufferFilePath;
+
+        // If not 0, the stack of every tracing thread is sampled every that much of its CPU time, from its first traced event till Finish() or Disable().
+        // Samples are written by Finish() and snapshots, attributed to the workers of the innermost events of their threads open at the time.
+        // The CPU time timers expire upon the scheduler ticks, so intervals shorter than a tick (1 to 10 milliseconds, depending on the kernel) do not sample more often.
+        // Stacks are walked by their frame pointers, so the program should be compiled with -fno-omit-frame-pointer, otherwise only the sampled functions are reliable.
+        // Supported on Linux (x86-64 and AArch64) if PROFANE_SAMPLE_STACKS is defined, and ignored elsewhere. Not supported in RecordingMode::Streaming.
+        // The samples are signaled by SIGPROF, which the program must not use otherwise. Only one logger in the process may sample the stacks at a time.
+        std::chrono::microseconds StackSamplingInterval { 0 };
+
+        // Capacity of the stack sample array of every thread, allocated upon its first traced event.
+        // Once it is full, the oldest samples are overwritten in RecordingMode::FlightRecorder and the new ones are dropped otherwise.
+        uint32_t StackSamplesPerThread = 8 * 1024;
+
+        ~PerfLogger()
+        {
+#if PROFANE_HAS_SIGNALS
+            DisableSnapshotSignal();
+#endif
+            StopStackSampling();
+            Finish();
+            RemoveEventBufferFile();
+        }
+
+        // Sets up the event pool of the given capacity and starts accepting new events.
+        // In RecordingMode::Streaming the header of the output is written immediately, so ProgramName and Description have to be set beforehand.
+        //
+        void Enable(std::ostream& out, uint32_t eventCount, RecordingMode recordingMode = RecordingMode::KeepFirst)
+        {
+            if (CalibrateOverhead)
+                m_spanOverhead = MeasureSpanOverhead();
+
+            m_startTime = Traits::Clock::now();
+            AllocateEvents(eventCount, recordingMode);
+            m_out = &out;
+            assert(m_outFileName == nullptr && "PerfLogger has been already enabled to write to a file.");
+
+            if (recordingMode == RecordingMode::Streaming)
+                StartStreaming();
+        }
+
+        void Enable(const char* outFileName, uint32_t eventCount, RecordingMode recordingMode = RecordingMode::KeepFirst)
+        {
+            if (CalibrateOverhead)
+                m_spanOverhead = MeasureSpanOverhead();
+
+            m_startTime = Traits::Clock::now();
+            AllocateEvents(eventCount, recordingMode);
+            m_outFileName = outFileName;
+            assert(m_out == nullptr && "PerfLogger has been already enabled to write to a stream.");
+
+            if (recordingMode == RecordingMode::Streaming)
+            {
+                m_outFile.open(m_outFileName, std::ofstream::binary);
+                m_out = &m_outFile;
+                StartStreaming();
+            }
+        }
+
+#if PROFANE_HAS_MMAP
+        // Streams the events, as in RecordingMode::Streaming, to a free region of the shared memory segment created by the collector (see shm::Collector).
+        // The collector merges the events of all the processes writing to the segment into a single file, in which ProgramName tells the processes apart.
+        // Throws std::runtime_error if the segment does not exist or has no free region.
+        //
+        void EnableSharedMemory(const char* segmentName, uint32_t eventCount)
+        {
+            std::unique_ptr<shm::RegionWriter> regionWriter{new shm::RegionWriter{segmentName, ProgramName}};
+
+            if (CalibrateOverhead)
+                m_spanOverhead = MeasureSpanOverhead();
+
+            m_startTime = Traits::Clock::now();
+            AllocateEvents(eventCount, RecordingMode::Streaming);
+            m_regionWriter = std::move(regionWriter);
+            StartStreaming();
+        }
+#endif
+
+        void Disable()
+        {
+            StopNewEvents();
+
+            if (IsStreaming())
+            {
+                StopStreaming();
+                m_pendingChunks.clear();
+                m_streamWriter.reset();
+#if PROFANE_HAS_MMAP
+                m_regionWriter.reset();
+#endif
+                m_outFile.close();
+            }
+
+            m_out = nullptr;
+            m_outFileName = {};
+            RemoveEventBufferFile();
+        }
+
+        template<typename... EventDataParams>
+        Tracer Trace(EventDataParams&&... eventParams)
+        {
+            return TraceEvent(typename Traits::EventData{std::forward<EventDataParams>(eventParams)...});
+        }
+
+        // Traces the event only if its category is enabled (see IsCategoryEnabled()).
+        // Note that the event parameters are evaluated anyway, so the routine should be given by an identifier registered in advance.
+        //
+        template<CategoryId Category, typename... EventDataParams>
+        Tracer TraceCategory(EventDataParams&&... eventParams)
+        {
+            if (!IsCategoryEnabled<Category>())
+                return {};
+
+            return Trace(std::forward<EventDataParams>(eventParams)...);
+        }
+
+        // Begins an asynchronous span, which may be moved to and ended on another thread (see AsyncSpan).
+        // The sampling rule of the routine is applied upon the beginning, and MinSpanDuration upon the end.
+        //
+        template<typename... EventDataParams>
+        AsyncSpan TraceAsync(EventDataParams&&... eventParams)
+        {
+            typename Traits::EventData eventData{std::forward<EventDataParams>(eventParams)...};
+
+            ThreadBuffer* const buffer = LocalThreadBuffer();
+            if (buffer == nullptr || !AdmitEvent(*buffer, eventData))
+                return {};
+
+            return {this, std::move(eventData)};
+        }
+
+        // Records a span of the calling thread, which the caller has timed itself (e.g. the shadow stack of the instrumented functions).
+        // Unlike Trace(), it costs nothing for the spans the caller decides not to record. Neither sampling rules nor MinSpanDuration apply to it.
+        // The span is recorded upon its end, like an asynchronous one, so it follows the events started meanwhile in the buffer (see ForEachEventInOrder()).
+        //
+        void TraceSpan(typename Traits::Clock::time_point startTime, typename Traits::Clock::time_point stopTime, typename Traits::EventData&& eventData, uint8_t flags = 0) noexcept
+        {
+            ThreadBuffer* const buffer = LocalThreadBuffer();
+            if (buffer == nullptr)
+                return;
+
+            if (buffer->aggregating)
+            {
+                AggregateSpan(*buffer, detail::RoutineIdOf(eventData, 0), stopTime - startTime);
+                return;
+            }
+
+            Event* const event = NextEvent(*buffer);
+            if (event == nullptr)
+                return;
+
+            PublishStartTime(*event, startTime);
+            event->stopTime = stopTime;
+            event->data = std::move(eventData);
+            event->flags = flags;
+            event->args.count = 0;
+            buffer->cursor.store(event + 1, std::memory_order_release);
+        }
+
+        // Returns the duration a traced span adds to its parent span, as measured upon Enable(), or 0 if it has not been measured.
+        //
+        std::chrono::nanoseconds SpanOverhead() const noexcept
+        {
+            return m_spanOverhead;
+        }
+
+        // Records the value of the counter (e.g. a queue depth or a number of bytes in flight) at the current time.
+        // Counters are registered as routines, so their names are in form of "<counterGroupName>.<counterName>".
+        //
+        void TraceCounter(RoutineId counterId, int64_t value) noexcept
+        {
+            ThreadBuffer* const buffer = LocalThreadBuffer();
+            if (buffer == nullptr)
+                return;
+
+            CounterSample* sample = buffer->counterCursor.load(std::memory_order_relaxed);
+            if (sample == buffer->counterChunkEnd)
+            {
+                sample = ClaimCounterChunk(*buffer);
+                if (sample == nullptr)
+                    return;
+            }
+
+            sample->time = Traits::Clock::now();
+            sample->counterId = counterId;
+            sample->value = value;
+            buffer->counterCursor.store(sample + 1, std::memory_order_release);
+        }
+
+        void TraceCounter(const char* counterName, int64_t value)
+        {
+            TraceCounter(RegisterRoutine(counterName), value);
+        }
+
+        void Finish()
+        {
+            auto stopTime = Traits::Clock::now();
+
+            if (IsStreaming())
+            {
+                StopStreaming();
+                UpdateClockCalibration();
+#if PROFANE_HAS_MMAP
+                if (m_regionWriter != nullptr)
+                    FinishStreaming(*m_regionWriter, stopTime);
+                else
+#endif
+                    FinishStreaming(*m_streamWriter, stopTime);
+                m_streamWriter.reset();
+#if PROFANE_HAS_MMAP
+                m_regionWriter.reset();
+#endif
+                m_outFile.close();
+
+                m_out = nullptr;
+                m_outFileName = {};
+                return;
+            }
+
+            std::ofstream outFile;
+
+            if (m_out == nullptr)
+            {
+                if (m_outFileName == nullptr)
+                    return;
+
+                outFile = std::ofstream{m_outFileName, std::ofstream::binary};
+                m_out = &outFile;
+            }
+
+            StopNewEvents();
+            UpdateClockCalibration();
+
+            auto writer = bin::BinaryWriter{*m_out, ProgramName, Description};
+
+            WriteEvents(writer, stopTime);
+            WriteCounterSamples(writer, m_clockCalibration);
+            WriteStackSamples(writer, m_clockCalibration);
+            WriteRoutineStats(writer);
+            WriteRoutineAggregates(writer, m_clockCalibration);
+            writer.SetSpanOverhead(m_spanOverhead);
+            writer.SetDroppedEventCount(DroppedEventCount());
+
+            writer.Finish();
+
+            m_out = nullptr;
+            m_outFileName = {};
+            RemoveEventBufferFile();
+        }
+
+        // Writes the events stopped so far and the counter samples to the stream, without stopping the logger.
+        // The tracing threads keep recording meanwhile: the events are copied as they are, and the ones overwritten while being copied (in the flight recorder mode) are left out.
+        // Events still running are left out as well. In RecordingMode::Streaming the snapshot holds the events not written to the output yet.
+        //
+        void Snapshot(std::ostream& out)
+        {
+            std::lock_guard<std::mutex> snapshotLock{m_snapshotMutex};
+
+            // The calibration of the logger is only updated by the thread writing the output, so the snapshot updates its own copy.
+            auto clockCalibration = CopyClockCalibration();
+            clockCalibration.Update();
+
+            std::vector<ThreadBuffer*> buffers;
+            {
+                std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+                for (const auto& buffer : m_threadBuffers)
+                    buffers.push_back(buffer.get());
+            }
+
+            std::vector<Event> events;
+
+            for (ThreadBuffer* buffer : buffers)
+            {
+                for (const auto& range : StoredEventRanges(*buffer))
+                {
+                    for (const Event* event = range.begin; event != range.end; ++event)
+                    {
+                        // A thread overwriting the event writes its start time first, followed by a release fence (see PublishStartTime()).
+                        // So the copy is consistent if the start time is the same before and after it, like with a sequence lock.
+                        // The copy may still combine the new start time with the stop time of the overwritten event, which is earlier.
+                        const auto startTime = event->startTime;
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        const Event copy = *event;
+                        std::atomic_thread_fence(std::memory_order_acquire);
+                        if (startTime.time_since_epoch().count() != 0 && copy.stopTime.time_since_epoch().count() != 0 && startTime <= copy.stopTime
+                            && copy.startTime == startTime && event->startTime == startTime)
+                            events.push_back(copy);
+                    }
+                }
+            }
+
+            std::stable_sort(std::begin(events), std::end(events), [](const Event& a, const Event& b) {
+                return a.startTime < b.startTime;
+            });
+
+            auto writer = bin::BinaryWriter{out, ProgramName, Description};
+
+            for (const auto& event : events)
+                WriteStoppedEvent(writer, event, clockCalibration);
+
+            WriteCounterSamples(writer, clockCalibration);
+            WriteStackSamples(writer, clockCalibration);
+            WriteRoutineAggregates(writer, clockCalibration);
+            writer.SetSpanOverhead(m_spanOverhead);
+            writer.SetDroppedEventCount(DroppedEventCount());
+            writer.Finish();
+        }
+
+#if PROFANE_HAS_SIGNALS
+        // Writes a snapshot (see Snapshot()) to a new file named "<outFileNamePrefix><N>.bin" whenever the process receives the signal.
+        // The snapshots are written by a thread of the logger, as hardly anything may be done in a signal handler.
+        // Only one logger in the process may handle the snapshot signal at a time.
+        //
+        void EnableSnapshotSignal(const std::string& outFileNamePrefix, int signalNumber = SIGUSR1)
+        {
+            DisableSnapshotSignal();
+
+            if (::pipe(m_snapshotPipe) != 0)
+                throw std::runtime_error{"Cannot create the snapshot signal pipe."};
+
+            // The signal handler must not block, even if the writer is late with reading the requests.
+            ::fcntl(m_snapshotPipe[1], F_SETFL, ::fcntl(m_snapshotPipe[1], F_GETFL) | O_NONBLOCK);
+
+            int noPipeFd = -1;
+            if (!detail::SnapshotSignalHolder<>::pipeFd.compare_exchange_strong(noPipeFd, m_snapshotPipe[1]))
+            {
+                ::close(m_snapshotPipe[0]);
+                ::close(m_snapshotPipe[1]);
+                throw std::runtime_error{"Another PerfLogger already handles the snapshot signal."};
+            }
+
+            struct sigaction action = {};
+            action.sa_handler = detail::OnSnapshotSignal;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            ::sigaction(signalNumber, &action, &m_previousSignalAction);
+
+            m_snapshotSignal = signalNumber;
+            m_snapshotFileNamePrefix = outFileNamePrefix;
+            m_snapshotThread = std::thread{[this]() { WriteSignaledSnapshots(); }};
+        }
+
+        // Restores the previous handler of the snapshot signal and stops the snapshot writer.
+        //
+        void DisableSnapshotSignal()
+        {
+            if (!m_snapshotThread.joinable())
+                return;
+
+            ::sigaction(m_snapshotSignal, &m_previousSignalAction, nullptr);
+            detail::SnapshotSignalHolder<>::pipeFd.store(-1);
+
+            // The writer stops upon the end of the pipe.
+            ::close(m_snapshotPipe[1]);
+            m_snapshotThread.join();
+            ::close(m_snapshotPipe[0]);
+            m_snapshotPipe[0] = m_snapshotPipe[1] = -1;
+        }
+#endif
+
+        // Writes the performance log of the events found in an event buffer file left behind by a crashed process (see EventBufferFilePath).
+        // The file must have been written by a PerfLogger of the same Traits. Events which have not been stopped are stopped at the latest time stamp in the file.
+        // Routine names are taken from the journal of the file, as the routines are not registered in the recovering process.
+        //
+        static void RecoverEventBuffer(const char* eventBufferFilePath, std::ostream& out)
+        {
+            std::ifstream in{eventBufferFilePath, std::ifstream::binary};
+            if (!in)
+                throw std::runtime_error{std::string{"Cannot open event buffer file: "} + eventBufferFilePath};
+
+            bin::EventBufferHeader header;
+            in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+            const bin::EventBufferHeader expectedHeader;
+            if (!in || std::memcmp(header.headerText, expectedHeader.headerText, sizeof(header.headerText)) != 0)
+                throw std::runtime_error{std::string{"Not an event buffer file: "} + eventBufferFilePath};
+            if (header.formatVersion != bin::FormatVersion)
+                throw std::runtime_error{"Incompatible event buffer version: " + std::to_string(header.formatVersion)};
+            if (header.eventSize != sizeof(Event))
+                throw std::runtime_error{"The event buffer file has been written by a PerfLogger of other traits."};
+
+            std::vector<char> names(std::min<uint64_t>(header.routineNamesSize.load(), header.routineNamesCapacity));
+            in.seekg(static_cast<std::streamoff>(header.routineNamesPos));
+            in.read(names.data(), static_cast<std::streamsize>(names.size()));
+
+            std::unordered_map<RoutineId, RoutineRegistry::Routine> routines;
+            size_t pos = 0;
+            while (pos + sizeof(RoutineId) + 1 <= names.size())
+            {
+                RoutineId routineId;
+                std::memcpy(&routineId, &names[pos], sizeof(routineId));
+                pos += sizeof(routineId);
+
+                RoutineRegistry::Routine routine;
+                const size_t workerNameSize = static_cast<uint8_t>(names[pos++]);
+                if (pos + workerNameSize + 1 > names.size())
+                    break;
+                routine.workerName.assign(&names[pos], workerNameSize);
+                pos += workerNameSize;
+                const size_t routineNameSize = static_cast<uint8_t>(names[pos++]);
+                if (pos + routineNameSize > names.size())
+                    break;
+                routine.routineName.assign(&names[pos], routineNameSize);
+                pos += routineNameSize;
+
+                routines[routineId] = std::move(routine);
+            }
+
+            const auto eventCount = std::min<uint64_t>(uint64_t{header.claimedChunkCount.load()} * header.chunkSize, header.eventCount);
+            std::vector<Event> events(static_cast<size_t>(eventCount));
+            in.seekg(static_cast<std::streamoff>(header.eventsPos));
+            in.read(reinterpret_cast<char*>(events.data()), static_cast<std::streamsize>(events.size() * sizeof(Event)));
+            if (!in)
+                throw std::runtime_error{std::string{"Truncated event buffer file: "} + eventBufferFilePath};
+
+            // Slots of the claimed chunks, which have not been written to yet, are zeroed.
+            events.erase(std::remove_if(std::begin(events), std::end(events), [](const Event& event) {
+                return event.startTime.time_since_epoch().count() == 0;
+            }), std::end(events));
+
+            std::sort(std::begin(events), std::end(events), [](const Event& a, const Event& b) {
+                return a.startTime < b.startTime;
+            });
+
+            auto latestTime = typename Traits::Clock::time_point{};
+            for (const auto& event : events)
+                latestTime = std::max(latestTime, std::max(event.startTime, event.stopTime));
+
+            const auto toRecovered = [&header](typename Traits::Clock::time_point timePoint) {
+                const auto ticks = static_cast<double>(timePoint.time_since_epoch().count() - header.clockBaseTicks);
+                return detail::RecoveredClock::time_point{std::chrono::nanoseconds{header.clockBaseNs + static_cast<int64_t>(ticks * header.clockNsPerTick)}};
+            };
+
+            const std::string programName(header.programName, std::find(header.programName, header.programName + sizeof(header.programName) - 1, '\0'));
+            const std::string description = ("Recovered from " + std::string{eventBufferFilePath}).substr(0, 255);
+
+            auto writer = bin::BinaryWriter{out, programName, description};
+
+            // Routines (and span arguments) are named upon their first occurrence, as they are not registered in the RoutineRegistry of this process.
+            std::unordered_set<RoutineId> namedRoutineIds;
+            const auto nameRoutine = [&](RoutineId routineId) {
+                if (!namedRoutineIds.insert(routineId).second)
+                    return;
+
+                const auto found = routines.find(routineId);
+                if (found != std::end(routines))
+                    writer.NameRoutine(routineId, found->second.workerName, found->second.routineName);
+                else
+                    writer.NameRoutine(routineId, "Unknown", "Routine #" + std::to_string(routineId));
+            };
+
+            for (auto& event : events)
+            {
+                if (event.stopTime.time_since_epoch().count() == 0)
+                    event.stopTime = latestTime;
+
+                WorkItemProto<detail::RecoveredClock> workItemProto {};
+                workItemProto.startTime = toRecovered(event.startTime);
+                workItemProto.stopTime = toRecovered(event.stopTime);
+                workItemProto.flags = event.flags;
+                workItemProto.args = event.args;
+
+                Traits::OnWorkItem(event.data, workItemProto);
+
+                if (workItemProto.routineId != 0)
+                    nameRoutine(workItemProto.routineId);
+                for (uint8_t argIdx = 0; argIdx < workItemProto.args.count; ++argIdx)
+                    nameRoutine(workItemProto.args.ids[argIdx]);
+
+                writer.WriteWorkItem(std::move(workItemProto));
+            }
+
+            writer.Finish();
+        }
+
+    private:
+        // Writes out the events and the counter samples not written by the stream writer.
+        //
+        template<typename Writer>
+        void FinishStreaming(Writer& writer, typename Traits::Clock::time_point stopTime)
+        {
+            WriteEvents(writer, stopTime);
+            WriteCounterSamples(writer, m_clockCalibration);
+            WriteRoutineStats(writer);
+            writer.SetSpanOverhead(m_spanOverhead);
+            writer.SetDroppedEventCount(DroppedEventCount());
+            writer.Finish();
+        }
+
+        // Writes out all the stored events. Events, which have not been stopped yet, are stopped at the given time.
+        //
+        template<typename Writer>
+        void WriteEvents(Writer& writer, typename Traits::Clock::time_point stopTime)
+        {
+            for (Event* chunk : m_pendingChunks)
+            {
+                std::for_each(chunk, ChunkEnd(chunk), [&](Event& event) {
+                    WriteEvent(writer, event, stopTime);
+                });
+            }
+
+            m_pendingChunks.clear();
+
+            ForEachEventInOrder([&](Event& event) {
+                WriteEvent(writer, event, stopTime);
+            });
+        }
+
+        template<typename Writer>
+        void WriteEvent(Writer& writer, Event& event, typename Traits::Clock::time_point stopTime)
+        {
+            // The slot of an event dropped in place is empty (see DropEvent()).
+            if (event.startTime.time_since_epoch().count() == 0)
+                return;
+
+            if (event.stopTime.time_since_epoch().count() == 0)
+                event.stopTime = stopTime;
+
+            WriteStoppedEvent(writer, event, m_clockCalibration);
+        }
+
+        template<typename Writer>
+        static void WriteStoppedEvent(Writer& writer, const Event& event, const ClockCalibration<typename Traits::Clock>& clockCalibration)
+        {
+            if (!detail::IsEventWritten<Traits>(event.data, 0))
+                return;
+
+            WorkItemProto<typename ClockCalibration<typename Traits::Clock>::ProtoClock> workItemProto {};
+            workItemProto.startTime = clockCalibration.ToProto(event.startTime);
+            workItemProto.stopTime = clockCalibration.ToProto(event.stopTime);
+            workItemProto.flags = event.flags;
+            workItemProto.args = event.args;
+
+            Traits::OnWorkItem(event.data, workItemProto);
+
+            writer.WriteWorkItem(std::move(workItemProto));
+        }
+
+        // Writes out the counter samples of all the thread buffers, ordered by time.
+        //
+        template<typename Writer>
+        void WriteCounterSamples(Writer& writer, const ClockCalibration<typename Traits::Clock>& clockCalibration)
+        {
+            std::vector<CounterSample> samples;
+
+            {
+                std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+
+                for (const auto& buffer : m_threadBuffers)
+                {
+                    const auto chunkCount = buffer->counterChunkCount.load(std::memory_order_acquire);
+                    if (chunkCount == 0)
+                        continue;
+
+                    for (uint32_t chunkIdx = 0; chunkIdx + 1 < chunkCount; ++chunkIdx)
+                        samples.insert(std::end(samples), buffer->counterChunks[chunkIdx], CounterChunkEnd(buffer->counterChunks[chunkIdx]));
+
+                    // The last chunk is filled up to the cursor, unless the thread is just claiming a next chunk.
+                    CounterSample* const lastChunk = buffer->counterChunks[chunkCount - 1];
+                    CounterSample* cursor = buffer->counterCursor.load(std::memory_order_acquire);
+                    if (cursor < lastChunk || cursor > CounterChunkEnd(lastChunk))
+                        cursor = CounterChunkEnd(lastChunk);
+
+                    samples.insert(std::end(samples), lastChunk, cursor);
+                }
+            }
+
+            std::stable_sort(std::begin(samples), std::end(samples), [](const CounterSample& s1, const CounterSample& s2) {
+                return s1.time < s2.time;
+            });
+
+            for (const auto& sample : samples)
+                writer.WriteCounterSample(sample.counterId, clockCalibration.ToProto(sample.time), sample.value);
+        }
+
+        // Writes out the stack samples of all the thread buffers. A sample is attributed to the worker of the innermost event of its thread open at the time,
+        // or of the latest event before it, if the thread has been in between its events. Samples taken before the first stored event of their thread are left out.
+        // Asynchronous spans do not count, as they are not on the stack of the thread.
+        //
+        void WriteStackSamples(bin::BinaryWriter& writer, const ClockCalibration<typename Traits::Clock>& clockCalibration)
+        {
+#if PROFANE_HAS_STACK_SAMPLING
+            using Sample = typename detail::StackSampleBuffer<typename Traits::Clock>::Sample;
+
+            // Events of the snapshots may still be running.
+            auto stopTimeOf = [](const Event& event) {
+                return (event.stopTime.time_since_epoch().count() != 0) ? event.stopTime : Traits::Clock::time_point::max();
+            };
+
+            std::unordered_map<uintptr_t, std::string> frameNames;
+            std::vector<StringRef> sampleFrameNames;
+
+            std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+
+            for (const auto& buffer : m_threadBuffers)
+            {
+                if (buffer->stackSamples == nullptr)
+                    continue;
+
+                const std::vector<Sample> samples = buffer->stackSamples->Samples();
+                if (samples.empty())
+                    continue;
+
+                std::vector<Event> events;
+                for (const auto& range : StoredEventRanges(*buffer))
+                {
+                    for (const Event* event = range.begin; event != range.end; ++event)
+                    {
+                        const Event copy = *event;
+                        if (copy.startTime.time_since_epoch().count() != 0 && (copy.flags & WorkItemFlags::Async) == 0 && detail::IsEventWritten<Traits>(copy.data, 0))
+                            events.push_back(copy);
+                    }
+                }
+
+                // Outer events go first, so that the nested ones are pushed onto them.
+                std::sort(std::begin(events), std::end(events), [&](const Event& a, const Event& b) {
+                    return a.startTime < b.startTime || (a.startTime == b.startTime && stopTimeOf(a) > stopTimeOf(b));
+                });
+
+                std::vector<const Event*> openEvents;
+                const Event* latestEvent = nullptr;
+                size_t nextEventIdx = 0;
+
+                for (const Sample& sample : samples)
+                {
+                    while (nextEventIdx < events.size() && events[nextEventIdx].startTime <= sample.time)
+                    {
+                        const Event* const event = &events[nextEventIdx++];
+                        while (!openEvents.empty() && stopTimeOf(*openEvents.back()) < event->startTime)
+                            openEvents.pop_back();
+                        openEvents.push_back(event);
+                        latestEvent = event;
+                    }
+
+                    while (!openEvents.empty() && stopTimeOf(*openEvents.back()) < sample.time)
+                        openEvents.pop_back();
+
+                    const Event* const event = !openEvents.empty() ? openEvents.back() : latestEvent;
+                    if (event == nullptr)
+                        continue;
+
+                    WorkItemProto<typename ClockCalibration<typename Traits::Clock>::ProtoClock> workItemProto {};
+                    workItemProto.startTime = clockCalibration.ToProto(event->startTime);
+                    workItemProto.stopTime = clockCalibration.ToProto(event->stopTime);
+                    Traits::OnWorkItem(event->data, workItemProto);
+
+                    sampleFrameNames.clear();
+                    for (uint32_t frameIdx = 0; frameIdx < sample.frameCount; ++frameIdx)
+                    {
+                        // A return address may already belong to the next function, if the call has been the last instruction of its caller.
+                        const uintptr_t address = (frameIdx == 0) ? sample.frames[frameIdx] : sample.frames[frameIdx] - 1;
+
+                        auto found = frameNames.find(address);
+                        if (found == std::end(frameNames))
+                        {
+                            std::string name = detail::NameCodeAddress(reinterpret_cast<const void*>(address));
+                            if (name.size() > 255)
+                                name.resize(255);
+                            found = frameNames.insert(std::make_pair(address, std::move(name))).first;
+                        }
+
+                        sampleFrameNames.push_back(found->second);
+                    }
+
+                    writer.WriteStackSample(clockCalibration.ToProto(sample.time), workItemProto.routineId, workItemProto.workerName, sampleFrameNames.data(), sample.frameCount);
+                }
+            }
+#else
+            (void)writer;
+            (void)clockCalibration;
+#endif
+        }
+
+        // Sums up the calls of the sampled routines and the dropped events over all the thread buffers and passes them to the writer.
+        //
+        template<typename Writer>
+        void WriteRoutineStats(Writer& writer)
+        {
+            if (!m_samplingEnabled && m_minSpanDuration.count() <= 0)
+                return;
+
+            struct RoutineTotals
+            {
+                const SamplingRule* samplingRule;
+                uint64_t callCount;
+                uint64_t tracedCount;
+                uint64_t droppedCount;
+                typename Traits::Clock::duration droppedDuration;
+            };
+
+            std::map<RoutineId, RoutineTotals> routineTotals;
+
+            {
+                std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+
+                for (const auto& buffer : m_threadBuffers)
+                {
+                    for (uint32_t blockIdx = 0; blockIdx < RoutineStateBlockCount; ++blockIdx)
+                    {
+                        const RoutineState* const block = buffer->routineStateBlocks[blockIdx].load(std::memory_order_acquire);
+                        if (block == nullptr)
+                            continue;
+
+                        for (uint32_t stateIdx = 0; stateIdx < RoutineStateBlockSize; ++stateIdx)
+                        {
+                            const RoutineState& state = block[stateIdx];
+                            if (!state.sampled && state.droppedCount == 0)
+                                continue;
+
+                            const auto routineId = static_cast<RoutineId>(blockIdx * RoutineStateBlockSize + stateIdx);
+                            auto& totals = routineTotals[routineId];
+                            if (state.sampled)
+                                totals.samplingRule = &m_samplingRules[state.ruleIdx];
+                            totals.callCount += state.callCount;
+                            totals.tracedCount += state.tracedCount;
+                            totals.droppedCount += state.droppedCount;
+                            totals.droppedDuration += state.droppedDuration;
+                        }
+                    }
+                }
+            }
+
+            writer.SetMinSpanDuration(m_clockCalibration.ToNanoseconds(m_minSpanDuration));
+
+            for (const auto& routineTotalsKV : routineTotals)
+            {
+                const auto& totals = routineTotalsKV.second;
+                writer.AddRoutineStats(
+                    routineTotalsKV.first,
+                    (totals.samplingRule != nullptr) ? totals.samplingRule->mode : SamplingMode::None,
+                    (totals.samplingRule != nullptr) ? totals.samplingRule->rate : 0.0,
+                    totals.callCount,
+                    totals.tracedCount,
+                    totals.droppedCount,
+                    static_cast<uint64_t>(m_clockCalibration.ToNanoseconds(totals.droppedDuration).count()));
+            }
+        }
+
+        // Merges the duration histograms of the routines over all the thread buffers and passes them to the writer (see RecordingMode::Aggregate).
+        // Histograms are read while the threads may still be updating them (e.g. for a snapshot), so their sums may lag behind their buckets a little.
+        //
+        template<typename Writer>
+        void WriteRoutineAggregates(Writer& writer, const ClockCalibration<typename Traits::Clock>& clockCalibration)
+        {
+            if (m_recordingMode != RecordingMode::Aggregate)
+                return;
+
+            std::map<RoutineId, DurationHistogram> routineHistograms;
+            uint64_t unaggregatedCount = 0;
+
+            {
+                std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+
+                for (const auto& buffer : m_threadBuffers)
+                {
+                    unaggregatedCount += buffer->unaggregatedCount.load(std::memory_order_relaxed);
+
+                    for (uint32_t blockIdx = 0; blockIdx < RoutineStateBlockCount; ++blockIdx)
+                    {
+                        const RoutineState* const block = buffer->routineStateBlocks[blockIdx].load(std::memory_order_acquire);
+                        if (block == nullptr)
+                            continue;
+
+                        for (uint32_t stateIdx = 0; stateIdx < RoutineStateBlockSize; ++stateIdx)
+                        {
+                            const DurationHistogram* const histogram = block[stateIdx].histogram.load(std::memory_order_acquire);
+                            if (histogram == nullptr)
+                                continue;
+
+                            const auto routineId = static_cast<RoutineId>(blockIdx * RoutineStateBlockSize + stateIdx);
+                            auto& merged = routineHistograms[routineId];
+                            merged.callCount += histogram->callCount;
+                            merged.totalDuration += histogram->totalDuration;
+                            merged.minDuration = std::min(merged.minDuration, histogram->minDuration);
+                            merged.maxDuration = std::max(merged.maxDuration, histogram->maxDuration);
+                            for (uint32_t bucketIdx = 0; bucketIdx < bin::DurationBucketCount; ++bucketIdx)
+                                merged.bucketCounts[bucketIdx] += histogram->bucketCounts[bucketIdx];
+                        }
+                    }
+                }
+            }
+
+            const auto nsPerMillionTicks = clockCalibration.ToNanoseconds(typename Traits::Clock::duration{1000000});
+            const double nsPerTick = static_cast<double>(nsPerMillionTicks.count()) / 1000000.0;
+
+            writer.SetUnaggregatedSpanCount(unaggregatedCount);
+
+            for (const auto& routineHistogramKV : routineHistograms)
+            {
+                const auto& histogram = routineHistogramKV.second;
+                writer.AddRoutineAggregate(
+                    routineHistogramKV.first,
+                    histogram.callCount,
+                    static_cast<uint64_t>(clockCalibration.ToNanoseconds(histogram.totalDuration).count()),
+                    static_cast<uint64_t>(clockCalibration.ToNanoseconds(histogram.minDuration).count()),
+                    static_cast<uint64_t>(clockCalibration.ToNanoseconds(histogram.maxDuration).count()),
+                    nsPerTick,
+                    histogram.bucketCounts);
+            }
+        }
+
+        // Timestamps the beginning of a new event.
+        // Returns a Tracer, which will timestamp the end upon its destructor.
+        //
+        Tracer TraceEvent(typename Traits::EventData&& eventData)
+        {
+            ThreadBuffer* const buffer = LocalThreadBuffer();
+            if (buffer == nullptr || !AdmitEvent(*buffer, eventData))
+                return {};
+
+            if (buffer->aggregating)
+                return {buffer, detail::RoutineIdOf(eventData, 0)};
+
+            Event* const event = NextEvent(*buffer);
+            if (event == nullptr)
+                return {};
+
+            detail::OnSpanStart<Traits>(eventData, 0);
+            PublishStartTime(*event, Traits::Clock::now());
+            event->stopTime = {};
+            event->data = std::move(eventData);
+            event->flags = 0;
+            event->args.count = 0;
+            buffer->cursor.store(event + 1, std::memory_order_release);
+            return {event, buffer};
+        }
+
+        // Sets the start time of a claimed event before its other fields, which Snapshot() relies on to detect the events overwritten while being copied.
+        // The release fence costs nothing on x86, where it only keeps the compiler from reordering the stores.
+        //
+        static void PublishStartTime(Event& event, typename Traits::Clock::time_point startTime) noexcept
+        {
+            event.startTime = startTime;
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        // Records the asynchronous span, which has just ended, in the buffer of the calling thread.
+        // The events of a buffer are therefore not strictly ordered by their start time (see ForEachEventInOrder()).
+        //
+        void TraceAsyncEnd(typename Traits::Clock::time_point startTime, typename Traits::EventData& eventData, const SpanArgs& args) noexcept
+        {
+            ThreadBuffer* const buffer = LocalThreadBuffer();
+            if (buffer == nullptr)
+                return;
+
+            const auto stopTime = Traits::Clock::now();
+
+            if (buffer->aggregating)
+            {
+                AggregateSpan(*buffer, detail::RoutineIdOf(eventData, 0), stopTime - startTime);
+                return;
+            }
+
+            if (stopTime - startTime < buffer->minSpanDuration)
+            {
+                RoutineState* const state = FindRoutineState(*buffer, detail::RoutineIdOf(eventData, 0));
+                if (state != nullptr)
+                {
+                    ++state->droppedCount;
+                    state->droppedDuration += stopTime - startTime;
+                    return;
+                }
+            }
+
+            Event* const event = NextEvent(*buffer);
+            if (event == nullptr)
+                return;
+
+            PublishStartTime(*event, startTime);
+            event->stopTime = stopTime;
+            event->data = std::move(eventData);
+            event->flags = WorkItemFlags::Async;
+            event->args = args;
+            buffer->cursor.store(event + 1, std::memory_order_release);
+
+            if (buffer->streamingLogger != nullptr)
+                CountStoppedEvent(event);
+        }
+
+        // Measures how much a traced span adds to the duration of its parent, i.e. the cost of TraceEvent() and of the Tracer destruction.
+        // Empty spans are traced back to back by a scratch logger, so that no events are left in this one.
+        // The cheapest of a few rounds is taken, as the others are likely disturbed by cache misses or preemption.
+        //
+        static std::chrono::nanoseconds MeasureSpanOverhead()
+        {
+            using namespace std::chrono;
+
+            constexpr uint32_t SpansPerRound = 128;
+            constexpr uint32_t RoundCount = 8;
+
+            std::ostream nullOut{nullptr};
+            PerfLogger calibrationLogger;
+            calibrationLogger.CalibrateOverhead = false;
+            calibrationLogger.CounterSampleCount = 0;
+            calibrationLogger.Enable(nullOut, SpansPerRound * RoundCount);
+
+            auto minRoundDuration = steady_clock::duration::max();
+
+            for (uint32_t roundIdx = 0; roundIdx < RoundCount; ++roundIdx)
+            {
+                const auto startTime = steady_clock::now();
+
+                for (uint32_t spanIdx = 0; spanIdx < SpansPerRound; ++spanIdx)
+                    calibrationLogger.TraceEvent(typename Traits::EventData{});
+
+                minRoundDuration = std::min(minRoundDuration, steady_clock::now() - startTime);
+            }
+
+            calibrationLogger.Disable();
+
+            return nanoseconds{static_cast<int64_t>(duration_cast<duration<double, std::nano>>(minRoundDuration).count() / SpansPerRound + 0.5)};
+        }
+
+        // Applies the sampling rule of the event routine. Returns false if the call is not to be traced.
+        //
+        bool AdmitEvent(ThreadBuffer& buffer, const typename Traits::EventData& eventData)
+        {
+            if (!m_samplingEnabled)
+                return true;
+
+            RoutineState* const state = FindRoutineState(buffer, detail::RoutineIdOf(eventData, 0));
+            if (state != nullptr && !state->resolved)
+                ResolveRoutineSampling(*state, detail::RoutineIdOf(eventData, 0));
+
+            return state == nullptr || !state->sampled || SampleCall(buffer, *state);
+        }
+
+        // Returns the slot for a new event of the thread buffer, or nullptr if there is none left.
+        // The event is published by advancing the cursor of the buffer.
+        //
+        Event* NextEvent(ThreadBuffer& buffer)
+        {
+            Event* const event = buffer.cursor.load(std::memory_order_relaxed);
+            if (event != buffer.chunkEnd)
+                return event;
+
+            Event* const chunk = NextChunk(buffer);
+            if (chunk == nullptr)
+                buffer.droppedEventCount.store(buffer.droppedEventCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+            return chunk;
+        }
+
+        // Returns the state of the routine in the thread buffer, or nullptr if the routine has no identifier within the capacity of the blocks.
+        //
+        static RoutineState* FindRoutineState(ThreadBuffer& buffer, RoutineId routineId)
+        {
+            const auto blockIdx = routineId / RoutineStateBlockSize;
+            if (routineId == 0 || blockIdx >= RoutineStateBlockCount)
+                return nullptr;
+
+            RoutineState* block = buffer.routineStateBlocks[blockIdx].load(std::memory_order_relaxed);
+            if (block == nullptr)
+            {
+                block = new (std::nothrow) RoutineState[RoutineStateBlockSize];
+                if (block == nullptr)
+                    return nullptr;
+                buffer.routineStateBlocks[blockIdx].store(block, std::memory_order_release);
+            }
+
+            return &block[routineId % RoutineStateBlockSize];
+        }
+
+        // Finds the sampling rule of the routine and sets up its state accordingly.
+        // It is called upon the first call of the routine in the thread.
+        //
+        void ResolveRoutineSampling(RoutineState& state, RoutineId routineId)
+        {
+            state.resolved = true;
+
+            const auto& routine = RoutineRegistry::Instance().Get(routineId);
+            const auto& workerName = routine.workerName;
+            const auto& routineName = routine.routineName;
+
+            const SamplingRule* rule = nullptr;
+
+            for (const auto& candidateRule : m_samplingRules)
+            {
+                const auto& name = candidateRule.name;
+
+                if (name.size() == workerName.size() + 1 + routineName.size() &&
+                    name.compare(0, workerName.size(), workerName) == 0 &&
+                    name[workerName.size()] == '.' &&
+                    name.compare(workerName.size() + 1, std::string::npos, routineName) == 0)
+                {
+                    rule = &candidateRule;
+                    break;
+                }
+
+                if (rule == nullptr && name == workerName)
+                    rule = &candidateRule;
+            }
+
+            if (rule == nullptr)
+                return;
+
+            switch (rule->mode)
+            {
+                case SamplingMode::None:
+                    return;
+
+                case SamplingMode::EveryNth:
+                    if (rule->rate < 2.0)
+                        return;
+                    state.period = static_cast<uint32_t>(std::min(rule->rate, 1e9));
+                    break;
+
+                case SamplingMode::Probabilistic:
+                    if (rule->rate >= 1.0)
+                        return;
+                    state.threshold = static_cast<uint32_t>(std::max(rule->rate, 0.0) * 4294967296.0);
+                    break;
+
+                case SamplingMode::MaxPerSecond:
+                    state.maxPerSecond = static_cast<uint32_t>(std::min(std::max(rule->rate, 1.0), 1e9));
+                    state.windowStart = std::chrono::steady_clock::now();
+                    break;
+            }
+
+            state.mode = rule->mode;
+            state.ruleIdx = static_cast<uint32_t>(rule - m_samplingRules.data());
+            state.sampled = true;
+        }
+
+        // Counts the call of the sampled routine and decides whether it is traced.
+        // Apart from the MaxPerSecond sampling checking the clock once per period, it costs a few arithmetic operations.
+        //
+        static bool SampleCall(ThreadBuffer& buffer, RoutineState& state) noexcept
+        {
+            ++state.callCount;
+
+            switch (state.mode)
+            {
+                case SamplingMode::None:
+                    break;
+
+                case SamplingMode::EveryNth:
+                    if (--state.countdown != 0)
+                        return false;
+                    state.countdown = state.period;
+                    break;
+
+                case SamplingMode::Probabilistic:
+                {
+                    // Xorshift32 generator.
+                    auto random = buffer.random;
+                    random ^= random << 13;
+                    random ^= random >> 17;
+                    random ^= random << 5;
+                    buffer.random = random;
+
+                    if (random >= state.threshold)
+                        return false;
+                    break;
+                }
+
+                case SamplingMode::MaxPerSecond:
+                    if (--state.countdown != 0)
+                        return false;
+                    state.countdown = state.period;
+                    if (!AdmitInWindow(state))
+                        return false;
+                    break;
+            }
+
+            ++state.tracedCount;
+            return true;
+        }
+
+        // Keeps the number of traced calls of the routine within the limit of the current one second window.
+        // At the start of every window, the period is adjusted to the call rate of the previous one, so that the traced calls are spread over the window.
+        // Once the limit is reached before the window is over, the period is doubled, which makes the clock checks less frequent.
+        //
+        static bool AdmitInWindow(RoutineState& state) noexcept
+        {
+            using namespace std::chrono;
+
+            const auto now = steady_clock::now();
+            const auto windowDuration = now - state.windowStart;
+
+            if (windowDuration >= seconds{1})
+            {
+                const auto windowCallCount = static_cast<double>(state.callCount - state.windowCallCount);
+                const auto callsPerSecond = windowCallCount / duration_cast<duration<double>>(windowDuration).count();
+                state.period = static_cast<uint32_t>(std::min(std::max(std::ceil(callsPerSecond / state.maxPerSecond), 1.0), 1e9));
+                state.countdown = state.period;
+                state.windowStart = now;
+                state.windowCallCount = state.callCount;
+                state.windowTracedCount = 0;
+            }
+
+            if (state.windowTracedCount >= state.maxPerSecond)
+            {
+                state.period = std::min(state.period * 2, uint32_t{1} << 30);
+                state.countdown = state.period;
+                return false;
+            }
+
+            ++state.windowTracedCount;
+            return true;
+        }
+
+        // Counts the short event as dropped and empties its slot, which is given back to its thread buffer if the event is the newest one.
+        // Otherwise (e.g. when a span recorded upon its end has followed it) the empty slot is skipped by the writers.
+        // It is possible only if the event is stopped by the owning thread. Returns false if the event has to be kept.
+        //
+        static bool DropEvent(ThreadBuffer& buffer, Event* event, typename Traits::Clock::duration duration) noexcept
+        {
+            if (t_localHandle.buffer != &buffer)
+                return false;
+
+            RoutineState* const state = FindRoutineState(buffer, detail::RoutineIdOf(event->data, 0));
+            if (state == nullptr)
+                return false;
+
+            // An empty slot has no start time, but it is stopped, so that the stream writer does not wait for it.
+            event->stopTime = event->startTime + duration;
+            event->startTime = {};
+            if (buffer.cursor.load(std::memory_order_relaxed) == event + 1)
+                buffer.cursor.store(event, std::memory_order_release);
+            else if (buffer.streamingLogger != nullptr)
+                buffer.streamingLogger->CountStoppedEvent(event);
+            ++state->droppedCount;
+            state->droppedDuration += duration;
+            return true;
+        }
+
+        // Counts the span in the duration histogram of the routine of the thread buffer (see RecordingMode::Aggregate).
+        // A span is counted as unaggregated instead, if it is stopped by another thread than the owning one (e.g. its Tracer has been moved),
+        // the routine has no identifier within the capacity of the blocks, or its histogram cannot be allocated.
+        //
+        static void AggregateSpan(ThreadBuffer& buffer, RoutineId routineId, typename Traits::Clock::duration duration) noexcept
+        {
+            RoutineState* const state = (t_localHandle.buffer == &buffer) ? FindRoutineState(buffer, routineId) : nullptr;
+            if (state == nullptr)
+            {
+                buffer.unaggregatedCount.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            DurationHistogram* histogram = state->histogram.load(std::memory_order_relaxed);
+            if (histogram == nullptr)
+            {
+                histogram = new (std::nothrow) DurationHistogram{};
+                if (histogram == nullptr)
+                {
+                    buffer.unaggregatedCount.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                state->histogram.store(histogram, std::memory_order_release);
+            }
+
+            duration = std::max(duration, typename Traits::Clock::duration{});
+            ++histogram->callCount;
+            histogram->totalDuration += duration;
+            histogram->minDuration = std::min(histogram->minDuration, duration);
+            histogram->maxDuration = std::max(histogram->maxDuration, duration);
+            ++histogram->bucketCounts[bin::DurationBucketOf(static_cast<uint64_t>(duration.count()))];
+        }
+
+        // Returns the buffer of the calling thread, or nullptr if the logger does not accept new events.
+        // Apart from the first call in a session, it costs a thread-local read and a comparison.
+        //
+        ThreadBuffer* LocalThreadBuffer()
+        {
+            const LocalHandle& handle = t_localHandle;
+            if (handle.sessionId == m_sessionId.load(std::memory_order_relaxed))
+                return handle.buffer;
+
+            return RegisterThreadBuffer();
+        }
+
+        // Assigns a buffer to the calling thread and caches it in the thread's local handle.
+        // A thread, which switches between loggers, gets back its buffer registered earlier in the session.
+        //
+        ThreadBuffer* RegisterThreadBuffer()
+        {
+            if (m_sessionId.load(std::memory_order_relaxed) == 0)
+                return nullptr;
+
+            std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+
+            const auto sessionId = m_sessionId.load(std::memory_order_relaxed);
+            if (sessionId == 0)
+                return nullptr;
+
+            const auto threadId = std::this_thread::get_id();
+            auto found = std::find_if(std::begin(m_threadBuffers), std::end(m_threadBuffers), [&](const std::unique_ptr<ThreadBuffer>& buffer) {
+                return buffer->threadId == threadId;
+            });
+
+            ThreadBuffer* buffer;
+            if (found != std::end(m_threadBuffers))
+            {
+                buffer = found->get();
+            }
+            else
+            {
+                m_threadBuffers.emplace_back(new ThreadBuffer{});
+                buffer = m_threadBuffers.back().get();
+                buffer->threadId = threadId;
+                buffer->chunks.reset(new Event*[m_chunkCount]);
+                buffer->counterChunks.reset(new CounterSample*[m_counterChunkCount]);
+                buffer->streamingLogger = (m_recordingMode == RecordingMode::Streaming) ? this : nullptr;
+
+                if (m_samplingEnabled || m_minSpanDuration.count() > 0 || m_recordingMode == RecordingMode::Aggregate)
+                {
+                    buffer->routineStateBlocks.reset(new std::atomic<RoutineState*>[RoutineStateBlockCount]());
+                    buffer->random = static_cast<uint32_t>(std::hash<std::thread::id>{}(threadId)) | 1;
+                    buffer->minSpanDuration = m_minSpanDuration;
+                    buffer->aggregating = m_recordingMode == RecordingMode::Aggregate;
+                }
+
+#if PROFANE_HAS_STACK_SAMPLING
+                // The timer measures the CPU time of the calling thread, which the buffer is registered for.
+                if (m_stackSampling)
+                {
+                    buffer->stackSamples.reset(new detail::StackSampleBuffer<typename Traits::Clock>{});
+                    buffer->stackSamples->Start(m_stackSamplesPerThread, m_recordingMode == RecordingMode::FlightRecorder, m_stackSamplingInterval);
+                }
+#endif
+            }
+
+            t_localHandle = LocalHandle{sessionId, buffer};
+            return buffer;
+        }
+
+        // Provides the thread buffer with a new chunk, as its current one is full.
+        // Returns the first event of the chunk, or nullptr if there is no chunk available.
+        //
+        Event* NextChunk(ThreadBuffer& buffer)
+        {
+            switch (m_recordingMode)
+            {
+                case RecordingMode::FlightRecorder:
+                {
+                    Event* const chunk = ClaimChunk(buffer);
+                    return (chunk != nullptr) ? chunk : RecycleChunk(buffer);
+                }
+
+                case RecordingMode::Streaming:
+                    return SwapChunk(buffer);
+
+                default:
+                    return ClaimChunk(buffer);
+            }
+        }
+
+        // Claims the next chunk of the event pool for the thread buffer.
+        // Returns the first event of the chunk, or nullptr if the pool is exhausted.
+        //
+        Event* ClaimChunk(ThreadBuffer& buffer)
+        {
+            // Once the pool is exhausted, keep the claim counter cache line shared instead of incrementing it.
+            if (m_claimedChunkCount.load(std::memory_order_relaxed) >= m_chunkCount)
+                return nullptr;
+
+            const auto chunkIdx = m_claimedChunkCount.fetch_add(1, std::memory_order_relaxed);
+            if (chunkIdx >= m_chunkCount)
+                return nullptr;
+
+            if (m_eventBufferHeader != nullptr)
+                m_eventBufferHeader->claimedChunkCount.fetch_add(1, std::memory_order_relaxed);
+
+            Event* const chunk = &m_events[static_cast<size_t>(chunkIdx) * m_chunkSize];
+            const auto chunkCount = buffer.chunkCount.load(std::memory_order_relaxed);
+
+            buffer.chunks[chunkCount] = chunk;
+            buffer.chunkEnd = ChunkEnd(chunk);
+            buffer.writeChunkIdx.store(chunkCount, std::memory_order_relaxed);
+            buffer.cursor.store(chunk, std::memory_order_relaxed);
+            buffer.chunkCount.store(chunkCount + 1, std::memory_order_release);
+
+            return chunk;
+        }
+
+        // Claims the next chunk of the counter sample pool for the thread buffer.
+        // Returns the first sample of the chunk, or nullptr if the pool is exhausted.
+        //
+        CounterSample* ClaimCounterChunk(ThreadBuffer& buffer) noexcept
+        {
+            if (m_claimedCounterChunkCount.load(std::memory_order_relaxed) >= m_counterChunkCount)
+                return nullptr;
+
+            const auto chunkIdx = m_claimedCounterChunkCount.fetch_add(1, std::memory_order_relaxed);
+            if (chunkIdx >= m_counterChunkCount)
+                return nullptr;
+
+            CounterSample* const chunk = &m_counterSamples[static_cast<size_t>(chunkIdx) * CounterSamplesPerChunk];
+            const auto chunkCount = buffer.counterChunkCount.load(std::memory_order_relaxed);
+
+            buffer.counterChunks[chunkCount] = chunk;
+            buffer.counterChunkEnd = CounterChunkEnd(chunk);
+            buffer.counterCursor.store(chunk, std::memory_order_relaxed);
+            buffer.counterChunkCount.store(chunkCount + 1, std::memory_order_release);
+
+            return chunk;
+        }
+
+        CounterSample* CounterChunkEnd(CounterSample* chunk) noexcept
+        {
+            return std::min(chunk + CounterSamplesPerChunk, m_counterSamples.data() + m_counterSamples.size());
+        }
+
+        // Moves the thread buffer on to its oldest chunk, which is going to be overwritten.
+        // Returns the first event of the chunk, or nullptr if the thread has not claimed any chunk.
+        //
+        Event* RecycleChunk(ThreadBuffer& buffer)
+        {
+            const auto chunkCount = buffer.chunkCount.load(std::memory_order_relaxed);
+            if (chunkCount == 0)
+                return nullptr;
+
+            const auto chunkIdx = (buffer.writeChunkIdx.load(std::memory_order_relaxed) + 1) % chunkCount;
+            Event* const chunk = buffer.chunks[chunkIdx];
+
+            buffer.chunkEnd = ChunkEnd(chunk);
+            buffer.writeChunkIdx.store(chunkIdx, std::memory_order_relaxed);
+            buffer.wrapped.store(true, std::memory_order_relaxed);
+            buffer.cursor.store(chunk, std::memory_order_release);
+
+            return chunk;
+        }
+
+        // Hands the current chunk of the thread buffer over to the stream writer and replaces it with a free one.
+        // The filled chunk is handed over even if there is no free one, so that the stream writer may free it as soon as it is complete.
+        // Returns the first event of the new chunk, or nullptr if the stream writer has not freed any chunk yet.
+        //
+        Event* SwapChunk(ThreadBuffer& buffer)
+        {
+            const bool filled = buffer.chunkCount.load(std::memory_order_relaxed) != 0;
+            Event* chunk = nullptr;
+            bool wakeWriter = false;
+
+            if (filled || m_freeChunkCount.load(std::memory_order_relaxed) != 0)
+            {
+                std::lock_guard<std::mutex> lock{m_streamMutex};
+
+                if (filled)
+                {
+                    m_filledChunks.push_back(buffer.chunks[0]);
+                    wakeWriter = IsChunkComplete(buffer.chunks[0]);
+                    buffer.chunkCount.store(0, std::memory_order_relaxed);
+                }
+
+                if (!m_freeChunks.empty())
+                {
+                    chunk = m_freeChunks.back();
+                    m_freeChunks.pop_back();
+                    m_freeChunkCount.store(static_cast<uint32_t>(m_freeChunks.size()), std::memory_order_relaxed);
+                }
+
+                // Do not wait for the next period, if the tracing threads are about to run out of chunks.
+                wakeWriter = wakeWriter || m_freeChunks.size() < m_chunkCount / 4;
+            }
+
+            if (chunk == nullptr)
+            {
+                buffer.chunkEnd = nullptr;
+                buffer.cursor.store(nullptr, std::memory_order_relaxed);
+
+                // The stream writer is woken up once per shortage of the thread, rather than upon every lost event.
+                wakeWriter = wakeWriter || !buffer.starved;
+                buffer.starved = true;
+            }
+            else
+            {
+                buffer.starved = false;
+            }
+
+            if (wakeWriter)
+                m_streamCondition.notify_one();
+
+            if (chunk == nullptr)
+                return nullptr;
+
+            buffer.chunks[0] = chunk;
+            buffer.chunkEnd = ChunkEnd(chunk);
+            buffer.cursor.store(chunk, std::memory_order_relaxed);
+            buffer.chunkCount.store(1, std::memory_order_release);
+
+            return chunk;
+        }
+
+        void StartStreaming()
+        {
+            m_streamStopping = false;
+
+#if PROFANE_HAS_MMAP
+            if (m_regionWriter != nullptr)
+            {
+                m_streamThread = std::thread{[this]() { StreamChunks(*m_regionWriter); }};
+                return;
+            }
+#endif
+
+            m_streamWriter.reset(new bin::BinaryWriter{*m_out, ProgramName, Description});
+            m_streamThread = std::thread{[this]() { StreamChunks(*m_streamWriter); }};
+        }
+
+        bool IsStreaming() const noexcept
+        {
+#if PROFANE_HAS_MMAP
+            if (m_regionWriter != nullptr)
+                return true;
+#endif
+            return m_streamWriter != nullptr;
+        }
+
+        // Updates the calibration used to write the output. Only the thread writing the output calls it, i.e. the stream writer or Finish().
+        //
+        void UpdateClockCalibration() noexcept
+        {
+            std::lock_guard<std::mutex> lock{m_clockCalibrationMutex};
+            m_clockCalibration.Update();
+        }
+
+        ClockCalibration<typename Traits::Clock> CopyClockCalibration()
+        {
+            std::lock_guard<std::mutex> lock{m_clockCalibrationMutex};
+            return m_clockCalibration;
+        }
+
+        // Stops new events and the stream writer thread.
+        // Chunks not written by the stream writer are left in m_pendingChunks.
+        //
+        void StopStreaming()
+        {
+            StopNewEvents();
+
+            {
+                std::lock_guard<std::mutex> lock{m_streamMutex};
+                m_streamStopping = true;
+            }
+
+            m_streamCondition.notify_one();
+            m_streamThread.join();
+
+            m_pendingChunks.insert(std::end(m_pendingChunks), std::begin(m_filledChunks), std::end(m_filledChunks));
+            m_filledChunks.clear();
+        }
+
+        // Body of the stream writer thread.
+        // Collects the filled chunks, writes out those which are complete and gives them back as free chunks.
+        // It is woken up once a filled chunk gets complete, when the tracing threads run short of free chunks, or else periodically.
+        // Chunks with long lasting events stay pending, so the output is not ordered by the event start time.
+        //
+        template<typename Writer>
+        void StreamChunks(Writer& writer)
+        {
+            std::vector<Event*> writtenChunks;
+            writtenChunks.reserve(m_chunkCount);
+
+            std::unique_lock<std::mutex> lock{m_streamMutex};
+
+            while (!m_streamStopping)
+            {
+                m_streamCondition.wait_for(lock, StreamFlushInterval);
+
+                m_pendingChunks.insert(std::end(m_pendingChunks), std::begin(m_filledChunks), std::end(m_filledChunks));
+                m_filledChunks.clear();
+
+                lock.unlock();
+
+                UpdateClockCalibration();
+
+                for (Event*& chunk : m_pendingChunks)
+                {
+                    if (!IsChunkComplete(chunk))
+                        continue;
+
+                    std::for_each(chunk, ChunkEnd(chunk), [&](Event& event) {
+                        WriteEvent(writer, event, event.stopTime);
+                    });
+
+                    m_chunkStoppedCounts[ChunkIdx(chunk)].store(0, std::memory_order_relaxed);
+                    writtenChunks.push_back(chunk);
+                    chunk = nullptr;
+                }
+
+                m_pendingChunks.erase(std::remove(std::begin(m_pendingChunks), std::end(m_pendingChunks), nullptr), std::end(m_pendingChunks));
+
+                lock.lock();
+
+                m_freeChunks.insert(std::end(m_freeChunks), std::begin(writtenChunks), std::end(writtenChunks));
+                m_freeChunkCount.store(static_cast<uint32_t>(m_freeChunks.size()), std::memory_order_relaxed);
+                writtenChunks.clear();
+            }
+        }
+
+        Event* ChunkEnd(Event* chunk) noexcept
+        {
+            return std::min(chunk + m_chunkSize, m_events + m_eventCount);
+        }
+
+        size_t ChunkIdx(const Event* event) const noexcept
+        {
+            return static_cast<size_t>(event - m_events) / m_chunkSize;
+        }
+
+        // Counts the stopped event in its chunk, waking the stream writer up once the chunk is complete.
+        // The count is released, so that the stream writer, which acquires it, reads the events whole.
+        //
+        void CountStoppedEvent(Event* event) noexcept
+        {
+            const auto chunkIdx = ChunkIdx(event);
+            Event* const chunk = &m_events[chunkIdx * m_chunkSize];
+            const auto stoppedCount = m_chunkStoppedCounts[chunkIdx].fetch_add(1, std::memory_order_release) + 1;
+
+            if (stoppedCount == static_cast<uint32_t>(ChunkEnd(chunk) - chunk))
+                m_streamCondition.notify_one();
+        }
+
+        bool IsChunkComplete(Event* chunk) noexcept
+        {
+            return m_chunkStoppedCounts[ChunkIdx(chunk)].load(std::memory_order_acquire) == static_cast<uint32_t>(ChunkEnd(chunk) - chunk);
+        }
+
+        // Returns the number of the events lost by all the threads for want of a chunk.
+        //
+        uint64_t DroppedEventCount()
+        {
+            std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+
+            uint64_t droppedEventCount = 0;
+            for (const auto& buffer : m_threadBuffers)
+                droppedEventCount += buffer->droppedEventCount.load(std::memory_order_relaxed);
+
+            return droppedEventCount;
+        }
+
+        // Returns the ranges of the events stored in the thread buffer, from the oldest to the latest one.
+        //
+        std::vector<EventRange> StoredEventRanges(ThreadBuffer& buffer)
+        {
+            std::vector<EventRange> ranges;
+            const auto chunkCount = buffer.chunkCount.load(std::memory_order_acquire);
+            Event* cursor = buffer.cursor.load(std::memory_order_acquire);
+
+            if (chunkCount == 0)
+                return ranges;
+
+            const auto writeChunkIdx = std::min(buffer.writeChunkIdx.load(std::memory_order_relaxed), chunkCount - 1);
+            const bool wrapped = buffer.wrapped.load(std::memory_order_relaxed);
+
+            auto addRange = [&](Event* begin, Event* end) {
+                if (begin != end)
+                    ranges.push_back(EventRange{begin, end});
+            };
+
+            // The written chunk is filled up to the cursor, unless the thread has just moved on to a next chunk.
+            Event* const writeChunk = buffer.chunks[writeChunkIdx];
+            if (cursor < writeChunk || cursor > ChunkEnd(writeChunk))
+                cursor = ChunkEnd(writeChunk);
+
+            // Once the ring has wrapped, the oldest events are those past the cursor, followed by the chunks next in the ring.
+            if (wrapped)
+            {
+                addRange(cursor, ChunkEnd(writeChunk));
+
+                for (uint32_t chunkIdx = writeChunkIdx + 1; chunkIdx < chunkCount; ++chunkIdx)
+                    addRange(buffer.chunks[chunkIdx], ChunkEnd(buffer.chunks[chunkIdx]));
+            }
+
+            for (uint32_t chunkIdx = 0; chunkIdx < writeChunkIdx; ++chunkIdx)
+                addRange(buffer.chunks[chunkIdx], ChunkEnd(buffer.chunks[chunkIdx]));
+
+            addRange(writeChunk, cursor);
+            return ranges;
+        }
+
+        // Calls the visitor for every stored event, ordered by the start time.
+        // Events of a thread buffer are ordered by their start time, except for the spans recorded upon their end (see TraceAsyncEnd() and TraceSpan()),
+        // which follow the events started meanwhile. Such a buffer is sorted by the pointers to its events, which stay in place, as running Tracers point to them.
+        // Then the buffers are k-way merged into a single ordered sequence.
+        //
+        template<typename Visitor>
+        void ForEachEventInOrder(Visitor&& visitor)
+        {
+            struct ThreadEvents
+            {
+                std::vector<EventRange> ranges;
+                size_t rangeIdx;
+                Event* position;
+                std::vector<Event*> sortedEvents;       // All the events of a buffer out of order, or none.
+                size_t sortedIdx;
+
+                bool Advance()
+                {
+                    if (!sortedEvents.empty())
+                    {
+                        if (++sortedIdx == sortedEvents.size())
+                            return false;
+                        position = sortedEvents[sortedIdx];
+                        return true;
+                    }
+
+                    if (++position != ranges[rangeIdx].end)
+                        return true;
+                    if (++rangeIdx == ranges.size())
+                        return false;
+                    position = ranges[rangeIdx].begin;
+                    return true;
+                }
+            };
+
+            std::vector<ThreadEvents> threadEvents;
+
+            {
+                std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+                threadEvents.reserve(m_threadBuffers.size());
+
+                for (const auto& buffer : m_threadBuffers)
+                {
+                    ThreadEvents events {};
+                    events.ranges = StoredEventRanges(*buffer);
+
+                    if (!events.ranges.empty())
+                    {
+                        events.position = events.ranges[0].begin;
+                        threadEvents.push_back(std::move(events));
+                    }
+                }
+            }
+
+            for (auto& events : threadEvents)
+            {
+                const Event* previous = nullptr;
+                bool ordered = true;
+
+                for (const auto& range : events.ranges)
+                {
+                    for (const Event* event = range.begin; ordered && event != range.end; ++event)
+                    {
+                        // Empty slots are skipped by the visitor anyway.
+                        if (event->startTime.time_since_epoch().count() == 0)
+                            continue;
+
+                        ordered = previous == nullptr || !(event->startTime < previous->startTime);
+                        previous = event;
+                    }
+                }
 
-        std::ostream* m_out = nullptr;
-        const char* m_outFileName = nullptr;
-        typename Traits::Clock::time_point m_startTime;
-        std::atomic<uint32_t> m_eventCount = {0};
-        std::vector<Event> m_events;
+                if (ordered)
+                    continue;
 
-    public:
-        // The purpose of a Tracer object is put a timestamp on Event::stopTime of the specified event object upon its destruction.
-        //
-        class Tracer
-        {
-            Event* m_event = nullptr;
+                for (const auto& range : events.ranges)
+                {
+                    for (Event* event = range.begin; event != range.end; ++event)
+                        events.sortedEvents.push_back(event);
+                }
 
-            Tracer(Event* event) noexcept : m_event{event} {}
+                std::stable_sort(std::begin(events.sortedEvents), std::end(events.sortedEvents), [](const Event* a, const Event* b) {
+                    return a->startTime < b->startTime;
+                });
 
-        public:
-            Tracer() = default;
-            Tracer(const Tracer&) = delete;
+                events.sortedIdx = 0;
+                events.position = events.sortedEvents[0];
+            }
 
-            Tracer(Tracer&& other) noexcept : m_event{detail::exchange(other.m_event, nullptr)} {}
+            auto startsLater = [](const ThreadEvents* a, const ThreadEvents* b) {
+                return b->position->startTime < a->position->startTime;
+            };
 
-            ~Tracer() noexcept
+            std::vector<ThreadEvents*> heap;
+            heap.reserve(threadEvents.size());
+            for (auto& events : threadEvents)
+                heap.push_back(&events);
+            std::make_heap(std::begin(heap), std::end(heap), startsLater);
+
+            while (!heap.empty())
             {
-                TraceStop();
+                std::pop_heap(std::begin(heap), std::end(heap), startsLater);
+                ThreadEvents* const events = heap.back();
+
+                visitor(*events->position);
+
+                if (events->Advance())
+                    std::push_heap(std::begin(heap), std::end(heap), startsLater);
+                else
+                    heap.pop_back();
             }
+        }
 
-            void Stop() noexcept
+        // Sets up an empty event pool and starts a new tracing session.
+        //
+        void AllocateEvents(uint32_t eventCount, RecordingMode recordingMode)
+        {
+            if (recordingMode == RecordingMode::Streaming && !EventBufferFilePath.empty())
+                throw std::runtime_error{"The event buffer file is not supported in the streaming mode."};
+#if PROFANE_HAS_STACK_SAMPLING
+            if (recordingMode == RecordingMode::Streaming && StackSamplingInterval.count() > 0)
+                throw std::runtime_error{"Stack sampling is not supported in the streaming mode."};
+#endif
+
+            StopNewEvents();
+            StartStackSampling();
+
+            assert(!IsStreaming() && "PerfLogger is still streaming, finish or disable it first.");
+
+            std::lock_guard<std::mutex> snapshotLock{m_snapshotMutex};
+            std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+
+            m_recordingMode = recordingMode;
+            m_threadBuffers.clear();
+            m_eventCount = eventCount;
+            m_chunkSize = std::max(std::min(EventsPerChunk, eventCount), uint32_t{1});
+            m_chunkCount = (eventCount + m_chunkSize - 1) / m_chunkSize;
+            m_claimedChunkCount.store(0, std::memory_order_relaxed);
+            m_counterSamples.clear();
+            m_counterSamples.resize(CounterSampleCount);
+            m_counterChunkCount = (CounterSampleCount + CounterSamplesPerChunk - 1) / CounterSamplesPerChunk;
+            m_claimedCounterChunkCount.store(0, std::memory_order_relaxed);
+            m_clockCalibration.Start();
+
+            RemoveEventBufferFile();
+            m_eventBufferFile.Unmap();
+            m_eventBufferHeader = nullptr;
+            m_eventStorage.clear();
+
+            if (EventBufferFilePath.empty())
             {
-                TraceStop();
-                m_event = nullptr;
+                m_eventStorage.resize(eventCount);
+                m_events = m_eventStorage.data();
+            }
+            else
+            {
+                m_eventStorage.shrink_to_fit();
+                MapEventBufferFile(eventCount);
             }
+            m_samplingRules = SamplingRules;
+            m_samplingEnabled = !m_samplingRules.empty();
+            m_minSpanDuration = m_clockCalibration.FromNanoseconds(MinSpanDuration);
 
-        private:
-            void TraceStop() noexcept
+            // In the streaming mode the chunks are handed out from the list of free chunks, rather than claimed.
+            m_freeChunks.clear();
+            m_filledChunks.clear();
+            m_pendingChunks.clear();
+
+            m_chunkStoppedCounts.reset(recordingMode == RecordingMode::Streaming ? new std::atomic<uint32_t>[m_chunkCount]() : nullptr);
+
+            if (recordingMode == RecordingMode::Streaming)
             {
-                if (m_event != nullptr)
-                    m_event->stopTime = Traits::Clock::now();
+                m_freeChunks.reserve(m_chunkCount);
+                m_filledChunks.reserve(m_chunkCount);
+
+                for (uint32_t chunkIdx = m_chunkCount; chunkIdx > 0; --chunkIdx)
+                    m_freeChunks.push_back(&m_events[static_cast<size_t>(chunkIdx - 1) * m_chunkSize]);
             }
 
-            friend class PerfLogger<Traits>;
-        };
+            m_freeChunkCount.store(static_cast<uint32_t>(m_freeChunks.size()), std::memory_order_relaxed);
+            m_sessionId.store(detail::NextSessionId(), std::memory_order_release);
+        }
 
-        std::string ProgramName;
-        std::string Description;
+        // Maps the event pool to a new event buffer file, laid out as: the header, the routine name journal, the events.
+        // The zeroed events of the file are empty, as any clock reading of an event is non-zero.
+        //
+        void MapEventBufferFile(uint32_t eventCount)
+        {
+            using namespace std::chrono;
+            const uint64_t pageSize = 4096;
+            const uint64_t routineNamesPos = sizeof(bin::EventBufferHeader);
+            const uint64_t eventsPos = (routineNamesPos + EventBufferRoutineNamesCapacity + pageSize - 1) / pageSize * pageSize;
+
+            m_eventBufferFile.Map(EventBufferFilePath, static_cast<size_t>(eventsPos + uint64_t{eventCount} * sizeof(Event)));
+            m_eventBufferFilePath = EventBufferFilePath;
+
+            const auto baseTime = Traits::Clock::now();
+            const auto nsPerMillionTicks = m_clockCalibration.ToNanoseconds(typename Traits::Clock::duration{1000000});
+
+            bin::EventBufferHeader* const header = new (m_eventBufferFile.Data()) bin::EventBufferHeader{};
+            header->eventSize = sizeof(Event);
+            header->eventCount = eventCount;
+            header->chunkSize = m_chunkSize;
+            header->routineNamesPos = routineNamesPos;
+            header->routineNamesCapacity = eventsPos - routineNamesPos;
+            header->eventsPos = eventsPos;
+            header->clockBaseTicks = static_cast<int64_t>(baseTime.time_since_epoch().count());
+            header->clockBaseNs = static_cast<int64_t>(duration_cast<nanoseconds>(m_clockCalibration.ToProto(baseTime).time_since_epoch()).count());
+            header->clockNsPerTick = static_cast<double>(nsPerMillionTicks.count()) / 1e6;
+            std::strncpy(header->programName, ProgramName.c_str(), sizeof(header->programName) - 1);
+
+            m_eventBufferHeader = header;
+            m_events = reinterpret_cast<Event*>(m_eventBufferFile.Data() + eventsPos);
+            m_routineJournal.Attach(header, m_eventBufferFile.Data() + routineNamesPos);
+        }
 
-        ~PerfLogger()
+        // Removes the event buffer file, as its events have been written out or discarded.
+        // The file stays mapped till the next Enable(), as the tracing threads may still be stopping their events.
+        //
+        void RemoveEventBufferFile()
         {
-            Finish();
+            m_routineJournal.Detach();
+
+            if (!m_eventBufferFilePath.empty())
+            {
+                std::remove(m_eventBufferFilePath.c_str());
+                m_eventBufferFilePath.clear();
+            }
+        }
+
+#if PROFANE_HAS_SIGNALS
+        // Body of the snapshot writer thread, which writes a snapshot upon every request sent by the signal handler through the pipe.
+        //
+        void WriteSignaledSnapshots()
+        {
+            uint32_t snapshotCount = 0;
+
+            for (;;)
+            {
+                char request;
+                const auto readSize = ::read(m_snapshotPipe[0], &request, 1);
+                if (readSize < 0 && errno == EINTR)
+                    continue;
+                if (readSize != 1)
+                    break;
+
+                std::ofstream outFile{m_snapshotFileNamePrefix + std::to_string(++snapshotCount) + ".bin", std::ofstream::binary};
+                if (!outFile.is_open())
+                    continue;
+
+                // There is no one to report an error to, so a failed snapshot is just left incomplete.
+                try
+                {
+                    Snapshot(outFile);
+                }
+                catch (const std::exception&)
+                {
+                }
+            }
         }
+#endif
 
-        void Enable(std::ostream& out, uint32_t eventCount)
+        // Prevents the logger from starting new events.
+        // Threads learn about it upon their next Trace() call, as their local handles no longer match the session.
+        //
+        void StopNewEvents()
         {
-            m_startTime = Traits::Clock::now();
-            m_events.resize(eventCount);
-            m_out = &out;
-            assert(m_outFileName == nullptr && "PerfLogger has been already enabled to write to a file.");
+            m_sessionId.store(0, std::memory_order_release);
+            StopStackSampling();
         }
 
-        void Enable(const char* outFileName, uint32_t eventCount)
+        // Takes over the profiling signal, if StackSamplingInterval is set, so that the threads registered from now on get their stacks sampled.
+        // Throws std::runtime_error if another logger samples the stacks.
+        //
+        void StartStackSampling()
         {
-            m_startTime = Traits::Clock::now();
-            m_events.resize(eventCount);
-            m_outFileName = outFileName;
-            assert(m_out == nullptr && "PerfLogger has been already enabled to write to a stream.");
+#if PROFANE_HAS_STACK_SAMPLING
+            if (StackSamplingInterval.count() <= 0)
+                return;
+
+            const void* noOwner = nullptr;
+            if (!detail::StackSamplerHolder<>::owner.compare_exchange_strong(noOwner, this))
+                throw std::runtime_error{"Another PerfLogger already samples the stacks."};
+
+            struct sigaction action = {};
+            action.sa_sigaction = detail::OnStackSampleSignal<typename Traits::Clock>;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_SIGINFO | SA_RESTART;
+            ::sigaction(SIGPROF, &action, nullptr);
+
+            std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+            m_stackSampling = true;
+            m_stackSamplingInterval = StackSamplingInterval;
+            m_stackSamplesPerThread = StackSamplesPerThread;
+#endif
         }
 
-        void Disable()
+        // Deletes the timers of the threads. Their samples are kept till the next Enable().
+        //
+        void StopStackSampling()
         {
-            /*const auto eventCount =*/ StopNewEvents();
+#if PROFANE_HAS_STACK_SAMPLING
+            {
+                std::lock_guard<std::mutex> lock{m_threadBuffersMutex};
+                if (!m_stackSampling)
+                    return;
 
-            /* It is better to leave m_events intact, so the following check is not necessary.
+                m_stackSampling = false;
+                detail::StackSamplerHolder<>::owner.store(nullptr);
 
-                // Check whether all the events are finished (have set stopTime).
-                for (uint32_t eventIdx = 0; eventIdx < eventCount; ++eventIdx)
+                for (const auto& buffer : m_threadBuffers)
                 {
-                    Event& event = m_events[eventIdx];
-                    if (event.stopTime == typename Traits::Clock::time_point{})
-                        throw std::runtime_error("Unable to disable a PerfLogger while there are pending tracers");
+                    if (buffer->stackSamples != nullptr)
+                        buffer->stackSamples->Stop();
                 }
-            */
+            }
 
-            m_out = nullptr;
-            m_outFileName = {};
+            // The handlers already past their check of the owner may still be writing their samples.
+            while (detail::StackSamplerHolder<>::runningHandlerCount.load() != 0)
+                std::this_thread::yield();
+#endif
         }
+    };
 
-        template<typename... EventDataParams>
-        Tracer Trace(EventDataParams&&... eventParams)
+    template<typename Traits>
+    thread_local typename PerfLogger<Traits>::LocalHandle PerfLogger<Traits>::t_localHandle = {};
+
+    namespace detail
+    {
+        // Returns the name of the calling thread: the one given to the system followed by the system identifier on Linux (e.g. "io-worker #4121"),
+        // "Thread <N>" in the order the threads first ask for it elsewhere.
+        inline std::string CurrentThreadName()
         {
-            return TraceEvent(typename Traits::EventData{std::forward<EventDataParams>(eventParams)...});
+#if defined(__linux__)
+            char systemName[16] = {};
+            ::pthread_getname_np(::pthread_self(), systemName, sizeof(systemName));
+            return std::string{systemName} + " #" + std::to_string(static_cast<long>(::syscall(SYS_gettid)));
+#else
+            static std::atomic<uint32_t> lastThreadIdx = {0};
+            thread_local const uint32_t threadIdx = ++lastThreadIdx;
+            return "Thread " + std::to_string(threadIdx);
+#endif
         }
 
-        void Finish()
+        // Returns the routine "<lockName> <suffix>" of the worker of a traced lock, i.e. "<lockName>.<lockName> <suffix>".
+        // The lock is repeated, as the analyser tells routines apart by their names alone.
+        // The routines are interned by their names, so the locks of the same name share them, however many of them are constructed.
+        // The registry tells the names apart by their pointers, so the interned names are kept until the end of the process.
+        inline RoutineId RegisterLockRoutine(const char* lockName, const std::string& suffix)
         {
-            auto stopTime = Traits::Clock::now();
+            static std::mutex routineIdsMutex;
+            static std::unordered_map<std::string, RoutineId>& routineIds = *new std::unordered_map<std::string, RoutineId>{};
+
+            std::lock_guard<std::mutex> lock{routineIdsMutex};
+            const auto inserted = routineIds.emplace(std::string{lockName} + "." + lockName + " " + suffix, RoutineId{0});
+            if (inserted.second)
+                inserted.first->second = RegisterRoutine(inserted.first->first.c_str());
+            return inserted.first->second;
+        }
 
-            std::ofstream outFile;
+        // Returns the routine of the waits of the calling thread for the locks of the given name, registering it upon the first wait.
+        inline RoutineId LockWaitRoutineOfThread(const char* lockName)
+        {
+            thread_local std::vector<std::pair<std::string, RoutineId>> waitRoutineIds;
 
-            if (m_out == nullptr)
+            for (auto it = waitRoutineIds.rbegin(); it != waitRoutineIds.rend(); ++it)
             {
-                if (m_outFileName == nullptr)
-                    return;
-
-                outFile = std::ofstream{m_outFileName, std::ofstream::binary};
-                m_out = &outFile;
+                if (it->first == lockName)
+                    return it->second;
             }
 
-            const auto eventCount = StopNewEvents();
+            const RoutineId waitRoutineId = RegisterLockRoutine(lockName, "wait " + CurrentThreadName());
+            waitRoutineIds.emplace_back(lockName, waitRoutineId);
+            return waitRoutineId;
+        }
+    }
 
-            auto writer = bin::BinaryWriter{*m_out, ProgramName, Description};
+    // A mutex, of which every wait is traced as a span of the routine "<lockName> wait <thread name>" (flagged with WorkItemFlags::LockWait)
+    // of the worker named after the lock. If asked upon construction, every hold is traced too, as a span of the routine "<lockName> hold" (flagged with WorkItemFlags::LockHold).
+    // An uncontended lock() takes just a successful try_lock() and records nothing, unless the holds are traced: then every hold reads the clock
+    // of the traits twice and records a span, which makes an uncontended lock and unlock about 4 times as costly as with std::mutex (see profane_bench).
+    // The name of the lock must not contain a dot. The traits of the logger must let EventData be constructed of a RoutineId (see ActorBasedTraits).
+    //
+    template<typename Traits = ActorBasedTraits, typename Mutex = std::mutex>
+    class TracedMutex
+    {
+    protected:
+        using TimePoint = typename Traits::Clock::time_point;
+
+        Mutex m_mutex;
+        PerfLogger<Traits>* m_logger;
+        const char* m_lockName;
+        bool m_tracingHolds;
+        RoutineId m_holdRoutineId;
+        TimePoint m_holdStartTime;
+
+    public:
+        TracedMutex(PerfLogger<Traits>& logger, const char* lockName, bool tracingHolds = false) :
+            m_logger{&logger},
+            m_lockName{lockName},
+            m_tracingHolds{tracingHolds},
+            m_holdRoutineId{tracingHolds ? detail::RegisterLockRoutine(lockName, "hold") : RoutineId{0}}
+        {
+            assert(std::strchr(lockName, '.') == nullptr && "The name of a traced lock must not contain a dot");
+        }
 
-            for (uint32_t eventIdx = 0; eventIdx < eventCount; ++eventIdx)
+        TracedMutex(const TracedMutex&) = delete;
+        TracedMutex& operator=(const TracedMutex&) = delete;
+
+        void lock()
+        {
+            if (m_mutex.try_lock())
             {
-                Event& event = m_events[eventIdx];
+                if (m_tracingHolds)
+                    m_holdStartTime = Traits::Clock::now();
+                return;
+            }
 
-                if (event.stopTime.time_since_epoch().count() == 0)
-                    event.stopTime = stopTime;
+            const auto waitStartTime = Traits::Clock::now();
+            m_mutex.lock();
+            const auto holdStartTime = Traits::Clock::now();
+            if (m_tracingHolds)
+                m_holdStartTime = holdStartTime;
+            TraceWait(waitStartTime, holdStartTime);
+        }
 
-                WorkItemProto<typename Traits::Clock> workItemProto { event.startTime, event.stopTime };
+        bool try_lock()
+        {
+            if (!m_mutex.try_lock())
+                return false;
 
-                Traits::OnWorkItem(event.data, workItemProto);
+            if (m_tracingHolds)
+                m_holdStartTime = Traits::Clock::now();
+            return true;
+        }
 
-                writer.WriteWorkItem(std::move(workItemProto));
+        // Reads the stop time of the hold while still holding the lock, but records the hold after releasing it.
+        //
+        void unlock()
+        {
+            if (!m_tracingHolds)
+            {
+                m_mutex.unlock();
+                return;
             }
 
-            writer.Finish();
+            const auto holdStartTime = m_holdStartTime;
+            const auto holdStopTime = Traits::Clock::now();
+            m_mutex.unlock();
+            m_logger->TraceSpan(holdStartTime, holdStopTime, typename Traits::EventData{m_holdRoutineId}, WorkItemFlags::LockHold);
+        }
 
-            m_out = nullptr;
-            m_outFileName = {};
+        const char* name() const noexcept
+        {
+            return m_lockName;
         }
 
-    private:
-        // Timestamps the beginning of a new event.
-        // Returns a Tracer, which will timestamp the end upon its destructor.
-        //
-        Tracer TraceEvent(typename Traits::EventData&& eventData)
+    protected:
+        void TraceWait(TimePoint waitStartTime, TimePoint waitStopTime) noexcept
+        {
+            m_logger->TraceSpan(waitStartTime, waitStopTime, typename Traits::EventData{detail::LockWaitRoutineOfThread(m_lockName)}, WorkItemFlags::LockWait);
+        }
+    };
+
+    namespace detail
+    {
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+        using DefaultSharedMutex = std::shared_mutex;
+#elif __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+        using DefaultSharedMutex = std::shared_timed_mutex;
+#else
+        // There is no shared mutex in C++11, so TracedSharedMutex has to be given one.
+        struct DefaultSharedMutex;
+#endif
+    }
+
+    // A shared mutex (std::shared_mutex in C++17, std::shared_timed_mutex in C++14), traced like TracedMutex.
+    // If the holds are traced, the shared ones are traced as spans of the routine "<lockName> hold shared", of which the start times are kept by every holding thread.
+    //
+    template<typename Traits = ActorBasedTraits, typename SharedMutex = detail::DefaultSharedMutex>
+    class TracedSharedMutex : public TracedMutex<Traits, SharedMutex>
+    {
+        using Base = TracedMutex<Traits, SharedMutex>;
+        using typename Base::TimePoint;
+
+        RoutineId m_sharedHoldRoutineId;
+
+        // Start times of the shared holds of the calling thread, by the lock. A thread seldom holds more than a few locks at once.
+        static std::vector<std::pair<const void*, TimePoint>>& ThreadSharedHolds()
+        {
+            thread_local std::vector<std::pair<const void*, TimePoint>> sharedHolds;
+            return sharedHolds;
+        }
+
+    public:
+        TracedSharedMutex(PerfLogger<Traits>& logger, const char* lockName, bool tracingHolds = false) :
+            Base{logger, lockName, tracingHolds},
+            m_sharedHoldRoutineId{tracingHolds ? detail::RegisterLockRoutine(lockName, "hold shared") : RoutineId{0}}
         {
-            const auto eventIdx = m_eventCount++;
-            if (eventIdx >= m_events.size())
+        }
+
+        void lock_shared()
+        {
+            if (this->m_mutex.try_lock_shared())
             {
-                // Consider: --m_eventCount;
-                return {};
+                if (this->m_tracingHolds)
+                    ThreadSharedHolds().emplace_back(this, Traits::Clock::now());
+                return;
             }
 
-            Event& event = m_events[eventIdx];
-            event.startTime = Traits::Clock::now();
-            // event.stopTime is already set to 0
-            event.data = std::move(eventData);
-            return {&event};
+            const auto waitStartTime = Traits::Clock::now();
+            this->m_mutex.lock_shared();
+            const auto holdStartTime = Traits::Clock::now();
+            if (this->m_tracingHolds)
+                ThreadSharedHolds().emplace_back(this, holdStartTime);
+            this->TraceWait(waitStartTime, holdStartTime);
         }
 
-        // Prevents the logger from starting new events.
-        // Returns the number of currently stored events.
-        //
-        uint32_t StopNewEvents()
+        bool try_lock_shared()
+        {
+            if (!this->m_mutex.try_lock_shared())
+                return false;
+
+            if (this->m_tracingHolds)
+                ThreadSharedHolds().emplace_back(this, Traits::Clock::now());
+            return true;
+        }
+
+        void unlock_shared()
         {
-            const auto eventsSize = static_cast<uint32_t>(m_events.size());
-            return std::min(m_eventCount.exchange(eventsSize), eventsSize);
+            if (!this->m_tracingHolds)
+            {
+                this->m_mutex.unlock_shared();
+                return;
+            }
+
+            const auto holdStopTime = Traits::Clock::now();
+            this->m_mutex.unlock_shared();
+
+            auto& sharedHolds = ThreadSharedHolds();
+            const auto found = std::find_if(sharedHolds.rbegin(), sharedHolds.rend(), [this](const std::pair<const void*, TimePoint>& hold) { return hold.first == this; });
+            assert(found != sharedHolds.rend() && "The shared lock is not held by the calling thread");
+            const auto holdStartTime = found->second;
+            sharedHolds.erase(std::next(found).base());
+
+            this->m_logger->TraceSpan(holdStartTime, holdStopTime, typename Traits::EventData{m_sharedHoldRoutineId}, WorkItemFlags::LockHold);
         }
     };
 
 } // namespace profane
+
+// Defining PROFANE_DEFINE_ALLOCATION_HOOKS in exactly one source file, before including this header, replaces the global operator new and delete
+// with ones counting the allocations of every thread (see AllocationTrackingTraits).
+// Defining PROFANE_TRACK_MALLOC along with it replaces malloc() and its siblings instead, so that the allocations of C code are counted as well
+// (glibc only, as the replacements call its __libc_* functions). The default operator new calls malloc(), so it is counted too.
+//
+#if defined(PROFANE_DEFINE_ALLOCATION_HOOKS)
+
+namespace profane
+{
+    namespace detail
+    {
+        struct AllocationHooksRegistration
+        {
+            AllocationHooksRegistration() noexcept
+            {
+                AllocationCountersHolder<>::hooksDefined.store(true, std::memory_order_relaxed);
+            }
+        };
+
+        static const AllocationHooksRegistration allocationHooksRegistration;
+    }
+}
+
+#if defined(PROFANE_TRACK_MALLOC)
+
+#if !defined(__GLIBC__)
+#error "PROFANE_TRACK_MALLOC requires glibc."
+#endif
+
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* ptr);
+
+    void* malloc(size_t size)
+    {
+        profane::CountAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        profane::CountAllocation(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        profane::CountAllocation(size);
+        return __libc_realloc(ptr, size);
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        profane::CountAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        profane::CountAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** ptr, size_t alignment, size_t size)
+    {
+        profane::CountAllocation(size);
+        *ptr = __libc_memalign(alignment, size);
+        return (*ptr != nullptr) ? 0 : ENOMEM;
+    }
+
+    void free(void* ptr)
+    {
+        __libc_free(ptr);
+    }
+}
+
+#else
+
+// The replacements pair operator new with free() on purpose, which GCC notices, once they are inlined.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+    profane::CountAllocation(size);
+    for (;;)
+    {
+        if (void* const ptr = std::malloc(size != 0 ? size : 1))
+            return ptr;
+
+        const std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc{};
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return operator new(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+#if defined(__cpp_aligned_new) && !defined(_MSC_VER)
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    profane::CountAllocation(size);
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, std::max(static_cast<std::size_t>(alignment), sizeof(void*)), size != 0 ? size : 1) != 0)
+        throw std::bad_alloc{};
+    return ptr;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+#endif // PROFANE_TRACK_MALLOC
+
+#endif // PROFANE_DEFINE_ALLOCATION_HOOKS
@@ -0,0 +1,103 @@
+// MIT License
+//
+// Copyright (c) 2018-2019 Mariusz apiski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Tracing of the functions instrumented by GCC or Clang with -finstrument-functions, implemented by src/profane_instrument.cpp.
+//
+// Compile the instrumented sources with -finstrument-functions, but profane_instrument.cpp and the tracer itself without it, e.g.:
+//     -finstrument-functions -finstrument-functions-exclude-file-list=profane/
+// Link the program with -rdynamic (and -ldl on older glibc), so that dladdr() finds the names of its own functions.
+// The functions not exported are named by their module and offset instead, which addr2line translates to a name.
+//
+// Every thread keeps a shadow stack of the instrumented calls, holding just their addresses and start times.
+// A call is recorded upon its exit, if it has lasted at least MinDuration and has not been nested deeper than MaxDepth.
+// The exit hook resolves the function upon its first recorded call and leaves out the calls of the functions matching the exclusion list,
+// caching the decision per thread and address, so that they take no events. Still, excluding the functions known in advance with
+// -finstrument-functions-exclude-function-list is cheaper, as it spares their calls the hooks as well.
+// The routines of the functions are registered upon writing the events, i.e. by Finish(), a snapshot or the stream writer.
+// The events cannot be recovered from an event buffer file, as the addresses are meaningless outside of the traced process.
+// For the same reason the calls cannot be aggregated in RecordingMode::Aggregate, where they are only counted as unaggregated spans.
+
+#include "profane.h"
+
+namespace profane
+{
+    // Traits of the calls of the instrumented functions. Each thread becomes a worker, named "Thread <N>" in the order the threads first call an instrumented function.
+    //
+    struct InstrumentedFunctionTraits
+    {
+        using Clock = TscClock;
+
+        #pragma pack(push)
+        #pragma pack(1)
+        struct EventData
+        {
+            const void* function;
+            uint16_t threadIdx;
+        };
+        #pragma pack(pop)
+
+        static bool IsWritten(const EventData& eventData);
+
+        template<typename ProtoClock>
+        static void OnWorkItem(const EventData& eventData, WorkItemProto<ProtoClock>& workItemProto);
+    };
+
+    namespace instrument
+    {
+        using InstrumentedFunctionLogger = PerfLogger<InstrumentedFunctionTraits>;
+
+        // Returns the logger of the instrumented functions. Enable it to start tracing them and finish it to write them out.
+        // The logger is never destroyed, as the instrumented functions may be called until the very end of the process.
+        //
+        InstrumentedFunctionLogger& Logger();
+
+        // Calls shorter than that are not recorded (1 microsecond by default), which keeps tracing of all the functions usable.
+        //
+        void SetMinDuration(std::chrono::nanoseconds minDuration);
+
+        // Calls nested deeper than that are not recorded (64 by default, 256 at most). Calls of the level 1 are those of the thread's entry function.
+        //
+        void SetMaxDepth(uint32_t maxDepth);
+
+        // Leaves out the functions, of which the demangled names begin with the prefix (e.g. "std::" or "MyLib::detail::").
+        // The functions of "std::", "__gnu_cxx::" and "profane::" are excluded by default.
+        //
+        void Exclude(const char* namePrefix);
+
+        // Resolves the function to the routine of the thread, registering it upon the first call. Returns 0 if the function is excluded.
+        //
+        RoutineId ResolveFunction(const void* function, uint16_t threadIdx);
+    }
+
+    inline bool InstrumentedFunctionTraits::IsWritten(const EventData& eventData)
+    {
+        return instrument::ResolveFunction(eventData.function, eventData.threadIdx) != 0;
+    }
+
+    template<typename ProtoClock>
+    void InstrumentedFunctionTraits::OnWorkItem(const EventData& eventData, WorkItemProto<ProtoClock>& workItemProto)
+    {
+        workItemProto.routineId = instrument::ResolveFunction(eventData.function, eventData.threadIdx);
+    }
+}
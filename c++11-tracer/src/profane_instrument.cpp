@@ -0,0 +1,302 @@
+// MIT License
+//
+// Copyright (c) 2018-2019 Mariusz apiski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Hooks of the functions instrumented with -finstrument-functions, feeding their calls to profane::instrument::Logger().
+// See profane/profane_instrument.h on how to build it. This file itself must not be instrumented.
+
+#include <profane/profane_instrument.h>
+
+#define PROFANE_NO_INSTRUMENT __attribute__((no_instrument_function))
+
+namespace profane
+{
+    namespace instrument
+    {
+        namespace
+        {
+            using Clock = InstrumentedFunctionTraits::Clock;
+
+            constexpr uint32_t MaxFrameCount = 256;
+            constexpr uint32_t ExclusionCacheSize = 256;
+
+            struct Frame
+            {
+                const void* function;
+                Clock::time_point startTime;
+            };
+
+            struct ExclusionCacheEntry
+            {
+                const void* function;           // nullptr if the entry is unused.
+                bool excluded;
+            };
+
+            // Calls of the instrumented functions open on the thread. Only the first MaxFrameCount of them are held, but all are counted by the depth.
+            // While a hook works, it sets inHook, so that the instrumented functions it calls (e.g. the tracer's own, should they be instrumented) are ignored.
+            // The exclusion cache holds whether the functions recently recorded by the thread are excluded, so that their calls are left out before taking an event.
+            //
+            struct ShadowStack
+            {
+                uint32_t depth;
+                bool inHook;
+                uint16_t threadIdx;             // 1-based, 0 until assigned.
+                uint32_t exclusionGeneration;   // Value of the global exclusionGeneration, upon which the exclusion cache has been filled.
+                Frame frames[MaxFrameCount];
+                ExclusionCacheEntry exclusionCache[ExclusionCacheSize];
+            };
+
+            thread_local ShadowStack t_shadowStack;
+
+            std::atomic<uint16_t> lastThreadIdx = {0};
+            std::atomic<uint32_t> maxDepth = {64};
+            std::atomic<int64_t> minDurationTicks = {-1};   // Set upon the first use, as its conversion to ticks needs the TSC calibrated.
+            std::atomic<uint32_t> exclusionGeneration = {0};    // Incremented by Exclude(), so that the threads clear their exclusion caches.
+
+            // Functions resolved so far, along with their routines per thread.
+            //
+            struct Resolver
+            {
+                std::mutex mutex;
+                std::vector<std::string> excludedPrefixes = { "std::", "__gnu_cxx::", "profane::" };
+                std::unordered_map<const void*, std::pair<std::string, bool>> functions;   // Name and whether it is excluded.
+                std::map<std::pair<const void*, uint16_t>, RoutineId> routineIds;
+                std::deque<std::string> workerRoutineNames;     // Registered routines are identified by the pointers to their names.
+            };
+
+            PROFANE_NO_INSTRUMENT Resolver& GetResolver()
+            {
+                static Resolver* const resolver = new Resolver;
+                return *resolver;
+            }
+
+            // Locks the resolver for the thread, which ignores the instrumented functions it calls meanwhile, as their hooks may lock it again.
+            // E.g. the linker may have picked the instrumented copies of the inline functions of the standard library.
+            //
+            class ResolverLock
+            {
+            public:
+                PROFANE_NO_INSTRUMENT ResolverLock()
+                    : m_inHook{t_shadowStack.inHook}
+                {
+                    t_shadowStack.inHook = true;
+                    GetResolver().mutex.lock();
+                }
+
+                PROFANE_NO_INSTRUMENT ~ResolverLock()
+                {
+                    GetResolver().mutex.unlock();
+                    t_shadowStack.inHook = m_inHook;
+                }
+
+                ResolverLock(const ResolverLock&) = delete;
+                ResolverLock& operator=(const ResolverLock&) = delete;
+
+            private:
+                bool m_inHook;
+            };
+
+            PROFANE_NO_INSTRUMENT int64_t ToTicks(std::chrono::nanoseconds duration)
+            {
+                ClockCalibration<Clock> clockCalibration;
+                clockCalibration.Start();
+                return clockCalibration.FromNanoseconds(duration).count();
+            }
+
+            PROFANE_NO_INSTRUMENT Clock::duration MinDuration()
+            {
+                auto ticks = minDurationTicks.load(std::memory_order_relaxed);
+                if (ticks < 0)
+                {
+                    ticks = ToTicks(std::chrono::microseconds{1});
+                    int64_t unset = -1;
+                    if (!minDurationTicks.compare_exchange_strong(unset, ticks, std::memory_order_relaxed))
+                        ticks = unset;
+                }
+
+                return Clock::duration{ticks};
+            }
+
+            // Returns the position of the qualified name of the function within its demangled name, i.e. past the return type of a template function.
+            //
+            PROFANE_NO_INSTRUMENT size_t QualifiedNamePos(const std::string& name)
+            {
+                const auto nameEnd = name.find_first_of("<(");
+                const auto space = name.rfind(' ', nameEnd);
+                return (nameEnd != std::string::npos && space != std::string::npos) ? space + 1 : 0;
+            }
+
+            PROFANE_NO_INSTRUMENT bool IsExcluded(const std::string& name, const std::string& prefix)
+            {
+                return name.compare(QualifiedNamePos(name), prefix.size(), prefix) == 0;
+            }
+
+            // Returns the name of the function and whether it is excluded, resolving them upon the first call. The resolver must be locked.
+            //
+            PROFANE_NO_INSTRUMENT const std::pair<std::string, bool>& ResolveName(Resolver& resolver, const void* function)
+            {
+                auto found = resolver.functions.find(function);
+                if (found == std::end(resolver.functions))
+                {
+                    std::string name = detail::NameCodeAddress(function);
+
+                    const bool excluded = std::any_of(std::begin(resolver.excludedPrefixes), std::end(resolver.excludedPrefixes), [&](const std::string& prefix) {
+                        return IsExcluded(name, prefix);
+                    });
+
+                    // Names of the template functions may get long beyond the limit of the file format.
+                    if (name.size() > 255)
+                        name.resize(255);
+
+                    found = resolver.functions.insert(std::make_pair(function, std::make_pair(std::move(name), excluded))).first;
+                }
+
+                return found->second;
+            }
+
+            // Returns whether the function is excluded, looking it up in the exclusion cache of the thread first.
+            // The function is resolved upon the first call recorded by any thread, so only the cache misses take the lock of the resolver.
+            //
+            PROFANE_NO_INSTRUMENT bool IsFunctionExcluded(ShadowStack& stack, const void* function)
+            {
+                const auto generation = exclusionGeneration.load(std::memory_order_acquire);
+                if (stack.exclusionGeneration != generation)
+                {
+                    std::fill(std::begin(stack.exclusionCache), std::end(stack.exclusionCache), ExclusionCacheEntry{nullptr, false});
+                    stack.exclusionGeneration = generation;
+                }
+
+                // Functions are aligned, so the lowest bits of their addresses are left out.
+                ExclusionCacheEntry& entry = stack.exclusionCache[(reinterpret_cast<uintptr_t>(function) >> 4) % ExclusionCacheSize];
+                if (entry.function != function)
+                {
+                    ResolverLock lock;
+
+                    entry.function = function;
+                    entry.excluded = ResolveName(GetResolver(), function).second;
+                }
+
+                return entry.excluded;
+            }
+        }
+
+        PROFANE_NO_INSTRUMENT InstrumentedFunctionLogger& Logger()
+        {
+            static InstrumentedFunctionLogger* const logger = new InstrumentedFunctionLogger;
+            return *logger;
+        }
+
+        PROFANE_NO_INSTRUMENT void SetMinDuration(std::chrono::nanoseconds minDuration)
+        {
+            minDurationTicks.store(ToTicks(minDuration), std::memory_order_relaxed);
+        }
+
+        PROFANE_NO_INSTRUMENT void SetMaxDepth(uint32_t depth)
+        {
+            maxDepth.store(std::min(depth, MaxFrameCount), std::memory_order_relaxed);
+        }
+
+        PROFANE_NO_INSTRUMENT void Exclude(const char* namePrefix)
+        {
+            ResolverLock lock;
+            Resolver& resolver = GetResolver();
+            resolver.excludedPrefixes.push_back(namePrefix);
+
+            for (auto& functionKV : resolver.functions)
+            {
+                if (IsExcluded(functionKV.second.first, resolver.excludedPrefixes.back()))
+                    functionKV.second.second = true;
+            }
+
+            exclusionGeneration.fetch_add(1, std::memory_order_release);
+        }
+
+        PROFANE_NO_INSTRUMENT RoutineId ResolveFunction(const void* function, uint16_t threadIdx)
+        {
+            ResolverLock lock;
+            Resolver& resolver = GetResolver();
+
+            // The hooks leave out the calls of the excluded functions already, but for those recorded before Exclude() has been called.
+            const auto& nameExcluded = ResolveName(resolver, function);
+            if (nameExcluded.second)
+                return 0;
+
+            auto& routineId = resolver.routineIds[std::make_pair(function, threadIdx)];
+            if (routineId == 0)
+            {
+                resolver.workerRoutineNames.push_back("Thread " + std::to_string(threadIdx) + "." + nameExcluded.first);
+                routineId = RegisterRoutine(resolver.workerRoutineNames.back().c_str());
+            }
+
+            return routineId;
+        }
+    }
+}
+
+extern "C"
+{
+    PROFANE_NO_INSTRUMENT void __cyg_profile_func_enter(void* function, void*)
+    {
+        using namespace profane::instrument;
+
+        ShadowStack& stack = t_shadowStack;
+        if (stack.inHook)
+            return;
+
+        const uint32_t depth = stack.depth++;
+        if (depth >= maxDepth.load(std::memory_order_relaxed))
+            return;
+
+        stack.inHook = true;
+        stack.frames[depth].function = function;
+        stack.frames[depth].startTime = Clock::now();
+        stack.inHook = false;
+    }
+
+    PROFANE_NO_INSTRUMENT void __cyg_profile_func_exit(void*, void*)
+    {
+        using namespace profane::instrument;
+
+        ShadowStack& stack = t_shadowStack;
+        if (stack.inHook || stack.depth == 0)
+            return;
+
+        const uint32_t depth = --stack.depth;
+        if (depth >= maxDepth.load(std::memory_order_relaxed))
+            return;
+
+        stack.inHook = true;
+
+        const Frame& frame = stack.frames[depth];
+        const auto stopTime = Clock::now();
+
+        if (stopTime - frame.startTime >= MinDuration())
+        {
+            if (stack.threadIdx == 0)
+                stack.threadIdx = ++lastThreadIdx;
+
+            if (!IsFunctionExcluded(stack, frame.function))
+                Logger().TraceSpan(frame.startTime, stopTime, profane::InstrumentedFunctionTraits::EventData{frame.function, stack.threadIdx});
+        }
+
+        stack.inHook = false;
+    }
+}
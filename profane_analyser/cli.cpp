@@ -43,6 +43,62 @@ ParsedCommandLine ParseCommandLine(int argc, char* args[])
                 throw std::runtime_error("Maximal number of collected performance samples expected after '-s'");
             cl.perfLogMaxSamples = std::stoi(args[idx]);
         }
+        else if (std::strcmp("-f", args[idx]) == 0)
+        {
+            cl.perfLogFlightRecorder = true;
+        }
+        else if (std::strcmp("-w", args[idx]) == 0)
+        {
+            cl.perfLogStreaming = true;
+        }
+        else if (std::strcmp("-g", args[idx]) == 0)
+        {
+            cl.perfLogAggregate = true;
+        }
+        else if (std::strcmp("-b", args[idx]) == 0)
+        {
+            ++idx;
+            if (idx >= argc)
+                throw std::runtime_error("Event buffer file path expected after '-b'");
+            cl.perfLogEventBufferFilePath = args[idx];
+        }
+        else if (std::strcmp("-u", args[idx]) == 0)
+        {
+            ++idx;
+            if (idx >= argc)
+                throw std::runtime_error("Snapshot file name prefix expected after '-u'");
+            cl.perfLogSnapshotFilePrefix = args[idx];
+        }
+        else if (std::strcmp("-r", args[idx]) == 0)
+        {
+            ++idx;
+            if (idx >= argc)
+                throw std::runtime_error("Event buffer file path expected after '-r'");
+            cl.recoverFilePath = args[idx];
+        }
+        else if (std::strcmp("-x", args[idx]) == 0)
+        {
+            cl.compensateTracerOverhead = true;
+        }
+        else if (std::strcmp("-a", args[idx]) == 0)
+        {
+            cl.printAllocationRanking = true;
+        }
+        else if (std::strcmp("-l", args[idx]) == 0)
+        {
+            cl.printLockContentions = true;
+        }
+        else if (std::strcmp("-t", args[idx]) == 0)
+        {
+            cl.printRoutineAggregates = true;
+        }
+        else if (std::strcmp("-c", args[idx]) == 0)
+        {
+            ++idx;
+            if (idx >= argc)
+                throw std::runtime_error("Mask of performance log categories expected after '-c'");
+            cl.perfLogCategories = std::stoull(args[idx], nullptr, 0);
+        }
         else
         {
             cl.inputFilePath = args[idx];
@@ -57,8 +113,19 @@ void PrintHelp()
     std::cout <<
         "Profane Analyzer\n"
         "   <file>      Input performance log file\n"
+        "   -r <file>   Recover the input file from the event buffer file left behind by a crashed program\n"
+        "   -x          Exclude the tracer overhead of the nested work items from the durations of the input file\n"
+        "   -a          Print the routines of the input file ranked by self bytes allocated per call, instead of showing it\n"
+        "   -l          Print the contention of the locks traced in the input file, the longest total wait first, instead of showing it\n"
+        "   -t          Print the aggregated durations of the routines of the input file, the longest total first, instead of showing it\n"
         "   -o <file>   Dump performance log to file\n"
         "   -s <int>    Max number of collected performance samples\n"
+        "   -f          Keep the latest performance samples instead of the first ones\n"
+        "   -w          Write performance samples to the file continuously, reusing the memory of '-s' samples\n"
+        "   -g          Aggregate the durations of the traced routines instead of keeping performance samples\n"
+        "   -c <mask>   Mask of performance sample categories: 1 - main, 2 - drawing, 4 - tests (default: all)\n"
+        "   -b <file>   Keep performance samples in the event buffer file, recoverable with '-r' should the program crash\n"
+        "   -u <prefix> Dump performance samples collected so far to file <prefix><N>.bin upon SIGUSR1 (POSIX only)\n"
         "   -h          Help\n"
         << std::endl;
 }
@@ -10,7 +10,18 @@ struct ParsedCommandLine
     bool printHelp = false;
     const char* perfLogOutputFilePath = nullptr;
     uint32_t perfLogMaxSamples = 0;
+    bool perfLogFlightRecorder = false;
+    bool perfLogStreaming = false;
+    bool perfLogAggregate = false;
+    profane::CategoryMask perfLogCategories = ~profane::CategoryMask{0};
+    const char* perfLogEventBufferFilePath = nullptr;
+    const char* perfLogSnapshotFilePrefix = nullptr;
     const char* inputFilePath = nullptr;
+    const char* recoverFilePath = nullptr;
+    bool compensateTracerOverhead = false;
+    bool printAllocationRanking = false;
+    bool printLockContentions = false;
+    bool printRoutineAggregates = false;
 };
 
 ParsedCommandLine ParseCommandLine(int argc, char* args[]);
@@ -79,8 +79,20 @@ public:
     SDL_Color WorkItemBackgroundColor_Fast {51, 103, 45, 255};
     SDL_Color WorkItemText1Color { 180, 240, 210, 255 };
     SDL_Color WorkItemText2Color { 130, 240, 175, 255 };
+    SDL_Color WorkItemOnCpuColor { 120, 200, 230, 255 };
+    SDL_Color WorkItemOffCpuColor { 24, 20, 30, 255 };
     SDL_Color WorkerBannerBackgroundColor { 128, 28, 28, 64 };
     SDL_Color WorkerBannerTextColor { 175, 125, 125, 255 };
+    SDL_Color CounterBannerBackgroundColor { 28, 28, 128, 64 };
+    SDL_Color CounterBannerTextColor { 125, 125, 175, 255 };
+    SDL_Color CounterLaneBackgroundColor { 22, 22, 36, 255 };
+    SDL_Color CounterLineColor { 120, 170, 240, 255 };
+    SDL_Color CounterTextColor { 150, 180, 240, 255 };
+    SDL_Color StackSampleLaneBackgroundColor { 36, 26, 22, 255 };
+    SDL_Color StackSampleColor { 210, 150, 90, 255 };
+    SDL_Color StackSampleHighlightColor { 255, 220, 160, 255 };
+    SDL_Color FlowArrowColor { 200, 200, 120, 96 };
+    SDL_Color FlowArrowHighlightColor { 255, 240, 120, 255 };
     SDL_Color MouseMarkerColor { 180, 240, 210, 135 };
     double MouseZoomSpeed = 0.75;
     std::string ProgramDirPath;
@@ -100,8 +112,20 @@ public:
         RegisterProperty(WorkItemBackgroundColor_Fast, "ui.workitem.background-color:fast", "Fastes work item background border color.");
         RegisterProperty(WorkItemText1Color, "ui.workitem.text1-color", "Work item routine name caption color.");
         RegisterProperty(WorkItemText2Color, "ui.workitem.text2-color", "Work item duration color.");
+        RegisterProperty(WorkItemOnCpuColor, "ui.workitem.cpu-color:on", "Color of the on-CPU part of the strip at the bottom of a work item with its CPU time measured.");
+        RegisterProperty(WorkItemOffCpuColor, "ui.workitem.cpu-color:off", "Color of the off-CPU part of the strip at the bottom of a work item with its CPU time measured.");
         RegisterProperty(WorkerBannerBackgroundColor, "ui.worker.background-color", "Worker banner background color.");
         RegisterProperty(WorkerBannerTextColor, "ui.worker.text-color", "Worker banner caption color.");
+        RegisterProperty(CounterBannerBackgroundColor, "ui.counter.banner-background-color", "Counter group banner background color.");
+        RegisterProperty(CounterBannerTextColor, "ui.counter.banner-text-color", "Counter group banner caption color.");
+        RegisterProperty(CounterLaneBackgroundColor, "ui.counter.background-color", "Counter lane background color.");
+        RegisterProperty(CounterLineColor, "ui.counter.line-color", "Counter step graph color.");
+        RegisterProperty(CounterTextColor, "ui.counter.text-color", "Counter name and value range caption color.");
+        RegisterProperty(StackSampleLaneBackgroundColor, "ui.stack-sample.background-color", "Background color of the lane of the stack samples of a worker.");
+        RegisterProperty(StackSampleColor, "ui.stack-sample.color", "Stack sample tick color.");
+        RegisterProperty(StackSampleHighlightColor, "ui.stack-sample.color:highlight", "Color of the pointed stack sample tick and of its frames.");
+        RegisterProperty(FlowArrowColor, "ui.flow.arrow-color", "Color of the arrows linking the work items of a task.");
+        RegisterProperty(FlowArrowHighlightColor, "ui.flow.arrow-color:highlight", "Color of the arrows linking the work items of the pointed task.");
         RegisterProperty(MouseMarkerColor, "ui.mouse.marker-color", "Mouse marker color (and its time point).");
         RegisterProperty(MouseZoomSpeed, "ui.mouse.zoom-speed", "Mouse zoom speed.");
         RegisterProperty(FontFilePath, "ui.font-file", "File path to the font asset (.ttf).");
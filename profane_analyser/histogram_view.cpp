@@ -88,13 +88,20 @@ void HistogramView::Draw()
         m_textRenderer.RenderText(textX, textY, selectedWorkItem.routineName, cfg->WorkItemText1Color);
         textY += textY_step;
 
+        // Counts and sums include the dropped short calls. Those of sampled routines are estimated from their traced calls.
+        const auto routineStats = m_workload->routineStatsOf(selectedWorkItem.routineName);
+        const double samplingScale = routineStats.samplingScale;
+        const char* const estimatePrefix = (samplingScale != 1.0) ? "~" : "";
+
+        const auto callCount = static_cast<int64_t>(static_cast<double>(histogram.size() + routineStats.droppedCount) * samplingScale + 0.5);
         m_textRenderer.RenderText(textX, textY, "Cnt", metricTextColor);
-        m_textRenderer.RenderText(textX + textX_tab, textY, std::to_string(histogram.size()).c_str(), cfg->WorkItemText2Color);
+        m_textRenderer.RenderText(textX + textX_tab, textY, (estimatePrefix + std::to_string(callCount)).c_str(), cfg->WorkItemText2Color);
         textY += textY_step;
 
-        const auto durationSum = std::accumulate(std::begin(histogram), std::end(histogram), int64_t{0}, [](int64_t v, const Workload::WorkItem* wi) { return v + wi->duration(); });
+        const auto tracedDurationSum = std::accumulate(std::begin(histogram), std::end(histogram), int64_t{0}, [](int64_t v, const Workload::WorkItem* wi) { return v + wi->duration(); });
+        const auto durationSum = static_cast<int64_t>(static_cast<double>(tracedDurationSum + routineStats.droppedDurationNs) * samplingScale);
         m_textRenderer.RenderText(textX, textY, "Sum", metricTextColor);
-        m_textRenderer.RenderText(textX + textX_tab, textY, FormatDuration(durationSum, 4), cfg->WorkItemText2Color);
+        m_textRenderer.RenderText(textX + textX_tab, textY, (estimatePrefix + FormatDuration(durationSum, 4)).c_str(), cfg->WorkItemText2Color);
         textY += textY_step;
 
         m_textRenderer.RenderText(textX, textY, "Max", metricTextColor);
@@ -102,7 +109,7 @@ void HistogramView::Draw()
         textY += textY_step;
 
         m_textRenderer.RenderText(textX, textY, "Avg", metricTextColor);
-        m_textRenderer.RenderText(textX + textX_tab, textY, FormatDuration(durationSum / histogram.size(), 4), cfg->WorkItemText2Color);
+        m_textRenderer.RenderText(textX + textX_tab, textY, FormatDuration(durationSum / std::max(callCount, int64_t{1}), 4), cfg->WorkItemText2Color);
         textY += textY_step;
 
         m_textRenderer.RenderText(textX, textY, "Med", metricTextColor);
@@ -112,6 +119,173 @@ void HistogramView::Draw()
         m_textRenderer.RenderText(textX, textY, "Min", metricTextColor);
         m_textRenderer.RenderText(textX + textX_tab, textY, FormatDuration(histogram[0]->duration(), 4), cfg->WorkItemText2Color);
         textY += textY_step;
+
+        // Arguments of the work item, each followed by the fit of the durations of the routine to it (e.g. ns per byte).
+        for (uint8_t argIdx = 0; argIdx < selectedWorkItem.argCount; ++argIdx)
+        {
+            const auto& arg = m_workload->spanArgs[selectedWorkItem.argsIdx + argIdx];
+            auto argText = std::string{arg.name} + " " + std::to_string(arg.value);
+
+            const auto* const argCorrelation = m_workload->argCorrelationOf(selectedWorkItem.routineName, arg.name);
+            if (argCorrelation != nullptr && argCorrelation->sampleCount > 2 && argCorrelation->nsPerUnit != 0.0)
+            {
+                char fitText[64];
+                std::snprintf(fitText, sizeof(fitText), "  r %.2f, %.3gns/", argCorrelation->correlation, argCorrelation->nsPerUnit);
+                argText += fitText + std::string{arg.name};
+            }
+
+            m_textRenderer.RenderText(textX, textY, "Arg", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, argText.c_str(), cfg->WorkItemText2Color);
+            textY += textY_step;
+        }
+
+        // Performance counters of the work item, each followed by its average per call of the routine.
+        const auto* const perfCounters = m_workload->perfCountersOf(selectedWorkItem);
+        const auto* const routinePerfCounters = m_workload->routinePerfCountersOf(selectedWorkItem.routineName);
+        if (perfCounters != nullptr && routinePerfCounters != nullptr)
+        {
+            using profane::PerfCounter;
+
+            const auto renderCounter = [&](const char* label, const std::string& text) {
+                m_textRenderer.RenderText(textX, textY, label, metricTextColor);
+                m_textRenderer.RenderText(textX + textX_tab, textY, text.c_str(), cfg->WorkItemText2Color);
+                textY += textY_step;
+            };
+
+            char counterText[64];
+
+            if (perfCounters->has(PerfCounter::Cycles) && perfCounters->has(PerfCounter::Instructions) && (*perfCounters)[PerfCounter::Cycles] > 0)
+            {
+                const double ipc = static_cast<double>((*perfCounters)[PerfCounter::Instructions]) / static_cast<double>((*perfCounters)[PerfCounter::Cycles]);
+                std::snprintf(counterText, sizeof(counterText), "%.2f instr/cycle (avg %.2f)", ipc, routinePerfCounters->instructionsPerCycle());
+                renderCounter("IPC", counterText);
+            }
+
+            if (perfCounters->has(PerfCounter::CacheMisses))
+            {
+                std::snprintf(counterText, sizeof(counterText), "%llu cache misses (avg %.3g)", static_cast<unsigned long long>((*perfCounters)[PerfCounter::CacheMisses]), routinePerfCounters->perCall(PerfCounter::CacheMisses));
+                renderCounter("Mis", counterText);
+            }
+
+            if (perfCounters->has(PerfCounter::TaskClock))
+            {
+                const auto avgTaskClockNs = static_cast<int64_t>(routinePerfCounters->perCall(PerfCounter::TaskClock));
+                renderCounter("CPU", FormatDuration(static_cast<int64_t>((*perfCounters)[PerfCounter::TaskClock]), 4) + " (avg " + FormatDuration(avgTaskClockNs, 4) + ")");
+            }
+
+            if (perfCounters->has(PerfCounter::PageFaults))
+            {
+                std::snprintf(counterText, sizeof(counterText), "%llu page faults (avg %.3g)", static_cast<unsigned long long>((*perfCounters)[PerfCounter::PageFaults]), routinePerfCounters->perCall(PerfCounter::PageFaults));
+                renderCounter("PgF", counterText);
+            }
+        }
+
+        // Heap allocations of the work item, followed by the routine's rank among all the routines by self bytes allocated per call.
+        const auto* const routineAllocations = m_workload->routineAllocationsOf(selectedWorkItem.routineName);
+        if (perfCounters != nullptr && perfCounters->allocationsCounted && routineAllocations != nullptr)
+        {
+            const auto& routinesByAllocatedBytes = m_workload->routinesByAllocatedBytes;
+            const auto rank = std::find(std::begin(routinesByAllocatedBytes), std::end(routinesByAllocatedBytes), selectedWorkItem.routineName) - std::begin(routinesByAllocatedBytes) + 1;
+
+            char allocationText[96];
+            std::snprintf(allocationText, sizeof(allocationText), "%llu B in %llu (avg %.4g B/call, self %.4g, #%d of %d)",
+                static_cast<unsigned long long>(perfCounters->allocatedBytes), static_cast<unsigned long long>(perfCounters->allocationCount),
+                routineAllocations->bytesPerCall(), routineAllocations->selfBytesPerCall(), static_cast<int>(rank), static_cast<int>(routinesByAllocatedBytes.size()));
+
+            m_textRenderer.RenderText(textX, textY, "Alc", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, allocationText, cfg->WorkItemText2Color);
+            textY += textY_step;
+        }
+
+        // Time the work item has spent off the CPU (i.e. blocked or preempted), followed by the average of the routine and its on-CPU share.
+        const auto* const routineCpuTime = m_workload->routineCpuTimeOf(selectedWorkItem.routineName);
+        if (perfCounters != nullptr && perfCounters->cpuTimeMeasured && routineCpuTime != nullptr)
+        {
+            const auto offCpuNs = static_cast<int64_t>(selectedWorkItem.stopTimeNs - selectedWorkItem.startTimeNs - perfCounters->cpuTimeNs);
+            char onCpuText[32];
+            std::snprintf(onCpuText, sizeof(onCpuText), ", %.1f%% on CPU)", routineCpuTime->onCpuRatio() * 100.0);
+
+            m_textRenderer.RenderText(textX, textY, "Off", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, (FormatDuration(offCpuNs, 4) + " (avg " + FormatDuration(static_cast<int64_t>(routineCpuTime->offCpuNsPerCall()), 4) + onCpuText).c_str(), cfg->WorkItemText2Color);
+            textY += textY_step;
+        }
+
+        // CPUs of the work item and its context switches, voluntary (blocking) and involuntary (preemption).
+        if (perfCounters != nullptr && perfCounters->scheduled)
+        {
+            auto schedulingText = "CPU " + std::to_string(perfCounters->startCpu);
+            if (perfCounters->stopCpu != perfCounters->startCpu)
+                schedulingText += " -> " + std::to_string(perfCounters->stopCpu) + " (migrated)";
+            schedulingText += ", " + std::to_string(perfCounters->voluntarySwitches) + " vol + " + std::to_string(perfCounters->involuntarySwitches) + " invol switches";
+
+            m_textRenderer.RenderText(textX, textY, "Sch", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, schedulingText.c_str(), cfg->WorkItemText2Color);
+            textY += textY_step;
+        }
+
+        if (routineStats.droppedCount > 0)
+        {
+            const auto droppedText = std::to_string(routineStats.droppedCount) + " <" + FormatDuration(static_cast<int64_t>(m_workload->minSpanDurationNs), 3);
+            m_textRenderer.RenderText(textX, textY, "Drp", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, droppedText.c_str(), cfg->WorkItemText2Color);
+            textY += textY_step;
+        }
+
+        if (samplingScale != 1.0)
+        {
+            char samplingText[32];
+            std::snprintf(samplingText, sizeof(samplingText), "1/%.1f", samplingScale);
+            m_textRenderer.RenderText(textX, textY, "Smp", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, samplingText, cfg->WorkItemText2Color);
+            textY += textY_step;
+        }
+
+        if (m_workload->tracerOverheadCompensated)
+        {
+            const auto overheadText = "-" + FormatDuration(static_cast<int64_t>(selectedWorkItem.overheadNs), 3) + " (" + FormatDuration(static_cast<int64_t>(m_workload->spanOverheadNs), 3) + "/item)";
+            m_textRenderer.RenderText(textX, textY, "Ovh", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, overheadText.c_str(), cfg->WorkItemText2Color);
+            textY += textY_step;
+        }
+
+        // End-to-end latency of the task the work item belongs to, compared against the median of all the tasks.
+        if (selectedWorkItem.taskId != 0)
+        {
+            const auto& task = m_workload->tasks.at(selectedWorkItem.taskId);
+            const auto& taskLatenciesNs = m_workload->taskLatenciesNs;
+            const auto medianLatencyNs = taskLatenciesNs[taskLatenciesNs.size() / 2];
+
+            m_textRenderer.RenderText(textX, textY, "Tsk", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, ("#" + std::to_string(task.taskId) + " of " + std::to_string(task.workItems.size()) + " items").c_str(), cfg->WorkItemText2Color);
+            textY += textY_step;
+
+            m_textRenderer.RenderText(textX, textY, "E2E", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, (FormatDuration(static_cast<int64_t>(task.latencyNs), 4) + " (med " + FormatDuration(static_cast<int64_t>(medianLatencyNs), 4) + ")").c_str(), cfg->WorkItemText2Color);
+            textY += textY_step;
+
+            m_textRenderer.RenderText(textX, textY, "Que", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, FormatDuration(static_cast<int64_t>(task.queueingNs), 4), cfg->WorkItemText2Color);
+            textY += textY_step;
+        }
+
+        // Contention of the traced lock the work item waits for or holds, followed by the threads which have waited for it the longest.
+        const auto* const lockContention = m_workload->lockContentionOf(selectedWorkItem.workerName);
+        if (lockContention != nullptr)
+        {
+            const auto lockText = std::to_string(lockContention->waitCount) + " waits " + FormatDuration(static_cast<int64_t>(lockContention->waitNs), 4) +
+                " (p99 " + FormatDuration(static_cast<int64_t>(lockContention->p99WaitNs), 4) + ")";
+            m_textRenderer.RenderText(textX, textY, "Lck", metricTextColor);
+            m_textRenderer.RenderText(textX + textX_tab, textY, lockText.c_str(), cfg->WorkItemText2Color);
+            textY += textY_step;
+
+            for (size_t waiterIdx = 0; waiterIdx < std::min(lockContention->topWaiters.size(), size_t{3}); ++waiterIdx)
+            {
+                const auto& waiter = lockContention->topWaiters[waiterIdx];
+                m_textRenderer.RenderText(textX, textY, "Wtr", metricTextColor);
+                m_textRenderer.RenderText(textX + textX_tab, textY, (FormatDuration(static_cast<int64_t>(waiter.second), 4) + " " + waiter.first).c_str(), cfg->WorkItemText2Color);
+                textY += textY_step;
+            }
+        }
     }
 }
 
@@ -144,7 +144,28 @@ int main(int argc, char* args[])
 
             perfLogger->ProgramName = "Profane Analyser";
 
-            perfLogger->Enable(parsedCommandLine.perfLogOutputFilePath, parsedCommandLine.perfLogMaxSamples);
+            if (parsedCommandLine.perfLogEventBufferFilePath != nullptr)
+                perfLogger->EventBufferFilePath = parsedCommandLine.perfLogEventBufferFilePath;
+
+            auto recordingMode = profane::RecordingMode::KeepFirst;
+            if (parsedCommandLine.perfLogFlightRecorder)
+                recordingMode = profane::RecordingMode::FlightRecorder;
+            if (parsedCommandLine.perfLogStreaming)
+                recordingMode = profane::RecordingMode::Streaming;
+            if (parsedCommandLine.perfLogAggregate)
+                recordingMode = profane::RecordingMode::Aggregate;
+
+            perfLogger->Enable(parsedCommandLine.perfLogOutputFilePath, parsedCommandLine.perfLogMaxSamples, recordingMode);
+            profane::SetEnabledCategories(parsedCommandLine.perfLogCategories);
+
+            if (parsedCommandLine.perfLogSnapshotFilePrefix != nullptr)
+            {
+#if PROFANE_HAS_SIGNALS
+                perfLogger->EnableSnapshotSignal(parsedCommandLine.perfLogSnapshotFilePrefix);
+#else
+                throw std::runtime_error("Performance log snapshots upon a signal are not supported on this platform");
+#endif
+            }
         }
 
         PERFTRACE("Main.main");
@@ -157,7 +178,7 @@ int main(int argc, char* args[])
         cfgObj.ProgramDirPath = parsedCommandLine.programDirPath;
 
         {
-            PERFTRACE("Main.test-1");
+            PERFTRACE_IN(PerfCategory::Test, "Main.test-1");
 
             constexpr const char* workerRoutineNames[] = {
                 "z-1.1", "z-1.2", "z-1.3", "z-1.4", "z-1.5", "z-1.6",
@@ -168,10 +189,14 @@ int main(int argc, char* args[])
                 "z-6.1", "z-6.2", "z-6.3", "z-6.4", "z-6.5", "z-6.6",
             };
 
+            // PERFTRACE_IN registers a single name per call site, so the varying names are registered in advance.
+            profane::RoutineId workerRoutineIds[36];
+            std::transform(std::begin(workerRoutineNames), std::end(workerRoutineNames), std::begin(workerRoutineIds), profane::RegisterRoutine);
+
             std::function<void(int, int)> depthTest;
 
             depthTest = [&](int level, int phase) {
-                PERFTRACE(workerRoutineNames[6 * level + phase]);
+                PERFTRACE_ROUTINE_IN(PerfCategory::Test, workerRoutineIds[6 * level + phase]);
 
                 if (level > 0)
                     depthTest(level - 1, phase);
@@ -184,14 +209,28 @@ int main(int argc, char* args[])
         }
 
         {
-            PERFTRACE("Main.test-2");
+            PERFTRACE_IN(PerfCategory::Test, "Main.test-2");
 
             for (int i = 0; i < 1000; ++i)
             {
-                PERFTRACE("Main.test");
+                PERFTRACE_IN(PerfCategory::Test, "Main.test");
+                PERFCOUNTER_IN(PerfCategory::Test, "Main.test-counter", i % 100);
             }
         }
 
+        if (parsedCommandLine.recoverFilePath != nullptr)
+        {
+            if (parsedCommandLine.inputFilePath == nullptr)
+                throw std::runtime_error("Input file path expected to recover '" + std::string{parsedCommandLine.recoverFilePath} + "' into");
+
+            std::ofstream outFile{parsedCommandLine.inputFilePath, std::ofstream::binary};
+            if (!outFile.is_open())
+                throw std::runtime_error("Cannot open input file '" + std::string{parsedCommandLine.inputFilePath} + "' for writing");
+
+            PERFTRACE("Main.RecoverEventBuffer");
+            PerfLogger::RecoverEventBuffer(parsedCommandLine.recoverFilePath, outFile);
+        }
+
         if (parsedCommandLine.inputFilePath != nullptr)
         {
             std::ifstream inFile{parsedCommandLine.inputFilePath, std::ifstream::binary};
@@ -205,7 +244,7 @@ int main(int argc, char* args[])
                 }
 
                 PERFTRACE("Main.BuildWorkload");
-                workload.reset(new Workload{BuildWorkload(std::move(content))});
+                workload.reset(new Workload{BuildWorkload(std::move(content), parsedCommandLine.compensateTracerOverhead)});
             }
             else
             {
@@ -216,6 +255,70 @@ int main(int argc, char* args[])
         if (workload.get() == nullptr)
             return -1;
 
+        if (workload->droppedEventCount > 0)
+            std::cerr << "warning: " << workload->droppedEventCount << " events have been lost by the tracer, as it has run out of free chunks" << std::endl;
+
+        if (parsedCommandLine.printAllocationRanking)
+        {
+            if (workload->routinesByAllocatedBytes.empty())
+                std::cout << "No heap allocations counted in the input file." << std::endl;
+
+            for (size_t rank = 0; rank < workload->routinesByAllocatedBytes.size(); ++rank)
+            {
+                const char* const routineName = workload->routinesByAllocatedBytes[rank];
+                const auto& routineAllocations = workload->routineAllocations.at(routineName);
+                std::printf("%4zu. %12.1f self B/call %12.1f B/call %10.2f allocs/call %10llu calls  %s\n", rank + 1, routineAllocations.selfBytesPerCall(), routineAllocations.bytesPerCall(),
+                    routineAllocations.allocationsPerCall(), static_cast<unsigned long long>(routineAllocations.workItemCount), routineName);
+            }
+
+            return 0;
+        }
+
+        if (parsedCommandLine.printLockContentions)
+        {
+            if (workload->lockContentions.empty())
+                std::cout << "No traced locks in the input file." << std::endl;
+
+            for (const auto& lockContention : workload->lockContentions)
+            {
+                std::printf("%s: %llu waits %s (p99 %s)", lockContention.lockName,
+                    static_cast<unsigned long long>(lockContention.waitCount), FormatDuration(static_cast<int64_t>(lockContention.waitNs), 4).c_str(),
+                    FormatDuration(static_cast<int64_t>(lockContention.p99WaitNs), 4).c_str());
+                if (lockContention.holdCount > 0)
+                    std::printf(", %llu holds %s", static_cast<unsigned long long>(lockContention.holdCount), FormatDuration(static_cast<int64_t>(lockContention.holdNs), 4).c_str());
+                std::printf("\n");
+
+                for (const auto& waiter : lockContention.topWaiters)
+                    std::printf("    %12s  %s\n", FormatDuration(static_cast<int64_t>(waiter.second), 4).c_str(), waiter.first);
+            }
+
+            return 0;
+        }
+
+        // A file of the aggregated durations only has nothing to show on the time scale, so its routine table is printed instead.
+        if (parsedCommandLine.printRoutineAggregates || (workload->workers.empty() && (!workload->routineAggregates.empty() || workload->unaggregatedSpanCount > 0)))
+        {
+            if (workload->routineAggregates.empty())
+                std::cout << "No aggregated routines in the input file." << std::endl;
+            else
+                std::printf("%10s %12s %10s %10s %10s %10s %10s %10s %10s  %s\n", "calls", "total", "mean", "min", "p50", "p90", "p99", "p99.9", "max", "routine");
+
+            for (const auto& routineAggregate : workload->routineAggregates)
+            {
+                std::printf("%10llu %12s %10s %10s %10s %10s %10s %10s %10s  %s.%s\n", static_cast<unsigned long long>(routineAggregate.callCount),
+                    FormatDuration(static_cast<int64_t>(routineAggregate.totalNs), 4).c_str(), FormatDuration(static_cast<int64_t>(routineAggregate.meanNs()), 4).c_str(),
+                    FormatDuration(static_cast<int64_t>(routineAggregate.minNs), 4).c_str(), FormatDuration(static_cast<int64_t>(routineAggregate.p50Ns), 4).c_str(),
+                    FormatDuration(static_cast<int64_t>(routineAggregate.p90Ns), 4).c_str(), FormatDuration(static_cast<int64_t>(routineAggregate.p99Ns), 4).c_str(),
+                    FormatDuration(static_cast<int64_t>(routineAggregate.p999Ns), 4).c_str(), FormatDuration(static_cast<int64_t>(routineAggregate.maxNs), 4).c_str(),
+                    routineAggregate.workerName, routineAggregate.routineName);
+            }
+
+            if (workload->unaggregatedSpanCount > 0)
+                std::printf("%10llu spans could not be aggregated (e.g. of no routine identifier)\n", static_cast<unsigned long long>(workload->unaggregatedSpanCount));
+
+            return 0;
+        }
+
         sdl::LibraryRuntime sdl;
         GameApp gameApp;
         gameApp.Run();
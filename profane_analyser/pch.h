@@ -8,6 +8,7 @@
 #include <vector>
 #include <cassert>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
@@ -19,9 +20,12 @@
 #include <emscripten.h>
 #endif
 
+// PROFANE_ANALYSER_HEADLESS leaves SDL2 out for the sources which draw nothing, like workload.cpp built into profane_bench.
+#ifndef PROFANE_ANALYSER_HEADLESS
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
+#endif
 
 #include "profane/profane.h"
 
@@ -37,4 +41,18 @@ extern Config* cfg;
 
 #define CONCATENATE2(a, b) a ## b
 #define CONCATENATE(a, b) CONCATENATE2(a, b)
-#define PERFTRACE(workerRoutineName) const PerfLogger::Tracer CONCATENATE(_perftracer_, __LINE__) = (perfLogger != nullptr) ? perfLogger->Trace(workerRoutineName) : PerfLogger::Tracer{};
+// Categories of the performance traces of the analyser itself (see profane::IsCategoryEnabled()).
+namespace PerfCategory
+{
+    constexpr profane::CategoryId Main = 0;         // Coarse phases of the program.
+    constexpr profane::CategoryId Draw = 1;         // Fine-grained drawing of the views, traced many times per frame.
+    constexpr profane::CategoryId Test = 2;         // Synthetic traces exercising the tracer and the views.
+}
+
+// A trace of a disabled category costs a single test of the category mask, as the routine is registered upon the first enabled trace.
+#define PERFTRACE_ROUTINE_IN(category, routineId) const PerfLogger::Tracer CONCATENATE(_perftracer_, __LINE__) = (profane::IsCategoryEnabled<category>() && perfLogger != nullptr) ? perfLogger->Trace(routineId) : PerfLogger::Tracer{};
+#define PERFTRACE_IN(category, workerRoutineName) PERFTRACE_ROUTINE_IN(category, ([]{ static const profane::RoutineId routineId = profane::RegisterRoutine(workerRoutineName); return routineId; }()))
+#define PERFTRACE_ROUTINE(routineId) PERFTRACE_ROUTINE_IN(PerfCategory::Main, routineId)
+#define PERFTRACE(workerRoutineName) PERFTRACE_IN(PerfCategory::Main, workerRoutineName)
+#define PERFCOUNTER_IN(category, counterGroupCounterName, value) do { if (profane::IsCategoryEnabled<category>() && perfLogger != nullptr) { static const profane::RoutineId _perfcounter_ = profane::RegisterRoutine(counterGroupCounterName); perfLogger->TraceCounter(_perfcounter_, (value)); } } while (false)
+#define PERFCOUNTER(counterGroupCounterName, value) PERFCOUNTER_IN(PerfCategory::Main, counterGroupCounterName, value)
@@ -167,7 +167,7 @@ TextRenderer::TextRenderer(SDL_Renderer* renderer) :
 
 SDL_Texture* TextRenderer::PrepareText(const std::string& text)
 {
-    PERFTRACE("TextRenderer.PrepareText");
+    PERFTRACE_IN(PerfCategory::Draw, "TextRenderer.PrepareText");
     assert(!text.empty());
     auto finding = m_inscriptions.find(text);
     if (finding == std::end(m_inscriptions))
@@ -189,7 +189,7 @@ SDL_Texture* TextRenderer::PrepareText(const std::string& text)
 
 SDL_Rect TextRenderer::RenderText(int x, int y, SDL_Texture* texture, SDL_Color color)
 {
-    PERFTRACE("TextRenderer.RenderText");
+    PERFTRACE_IN(PerfCategory::Draw, "TextRenderer.RenderText");
     int width, height;
     SDL_QueryTexture(texture, nullptr, nullptr, &width, &height);
 
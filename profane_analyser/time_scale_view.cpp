@@ -30,6 +30,13 @@ void TimeScaleView::Camera::ResetToViewAllWorkload(const Workload& workload)
             widthNs = std::max(widthNs, static_cast<int64_t>(workItem.stopTimeNs - workload.startTimeNs));
         }
     }
+    for (const auto& counterGroupKV : workload.counterGroups)
+    {
+        for (const auto& counterKV : counterGroupKV.second.counters)
+        {
+            widthNs = std::max(widthNs, static_cast<int64_t>(counterKV.second.timesNs.back() - workload.startTimeNs));
+        }
+    }
 }
 
 
@@ -137,6 +144,19 @@ void TimeScaleView::HandleEvent(const SDL_Event& generalEvent)
             break;
         }
 
+        case SDL_KEYDOWN:
+        {
+            const auto& event = reinterpret_cast<const SDL_KeyboardEvent&>(generalEvent);
+
+            if (event.keysym.sym == SDLK_c && !m_workload->cpuLanes.empty())
+            {
+                m_showCpuLanes = !m_showCpuLanes;
+                hack_histogramView->SelectWorkItem(nullptr, -1);
+            }
+
+            break;
+        }
+
         case SDL_MOUSEWHEEL:
         {
             const auto& event = reinterpret_cast<const SDL_MouseWheelEvent&>(generalEvent);
@@ -181,7 +201,13 @@ void TimeScaleView::Draw()
 
     int workerOffsetY = -m_camera.topPx + 22;
 
-    for (const auto& workerKV : m_workload->workers)
+    const Workload::WorkItem* pointedWorkItem = nullptr;
+    const Workload::StackSample* pointedStackSample = nullptr;
+
+    // The lanes of the CPUs hold copies of the work items, so a work item is selected by its source in its worker.
+    const auto& lanes = m_showCpuLanes ? m_workload->cpuLanes : m_workload->workers;
+
+    for (const auto& workerKV : lanes)
     {
         const auto& worker = workerKV.second;
 
@@ -201,6 +227,7 @@ void TimeScaleView::Draw()
         m_textRenderer.RenderText(3, workerOffsetY + 1, worker.name, cfg->WorkerBannerTextColor);
         workerOffsetY += 20;
 
+        m_workerTopPxs[worker.name] = workerOffsetY;
         m_pixelWideBlockDeferredRenderer.Reset(workerOffsetY, worker.stackLevels);
 
         int wi_idx = -1;
@@ -241,35 +268,113 @@ void TimeScaleView::Draw()
             if (selectedWorkItem == nullptr && mouseX >= blockRect.x && mouseY >= blockRect.y && mouseX < blockRect.x + blockRect.w && mouseY < blockRect.y + blockRect.h)
             {
                 selectedWorkItem = &wi;
+                pointedWorkItem = &wi;
                 bgColor = LerpColor(bgColor, SDL_Color{255, 255, 255, 255}, 0.25f);
 
                 // TODO: Remove this lazy hack.
                 if (selectedWorkItem != nullptr && (mouseState & SDL_BUTTON(SDL_BUTTON_LEFT)))
                 {
-                    hack_histogramView->SelectWorkItem(worker.name, wi_idx);
+                    if (m_showCpuLanes)
+                        hack_histogramView->SelectWorkItem(wi.workerName, static_cast<int>(worker.sourceWorkItemIdxs[wi_idx]));
+                    else
+                        hack_histogramView->SelectWorkItem(worker.name, wi_idx);
                 }
             }
 
             SDL_SetRenderDrawColor(m_renderer, bgColor.r, bgColor.g, bgColor.b, bgColor.a);
 
-            PERFTRACE("TimeScaleView.Draw WorkItem");
+            PERFTRACE_IN(PerfCategory::Draw, "TimeScaleView.Draw WorkItem");
 
             SDL_RenderFillRect(m_renderer, &blockRect);
 
+            // The strip at the bottom of the block shows the part of the work item spent on the CPU, from the left, and off the CPU.
+            const auto* const perfCounters = m_workload->perfCountersOf(wi);
+            if (perfCounters != nullptr && perfCounters->cpuTimeMeasured && blockRect.w > 4)
+            {
+                const auto durationNs = wi.stopTimeNs - wi.startTimeNs;
+                const float onCpuRatio = (durationNs > 0) ? static_cast<float>(perfCounters->cpuTimeNs) / static_cast<float>(durationNs) : 1.0f;
+
+                SDL_Rect cpuRect { blockRect.x + 1, blockRect.y + blockRect.h - 5, blockRect.w - 2, 4 };
+                SDL_SetRenderDrawColor(m_renderer, cfg->WorkItemOffCpuColor.r, cfg->WorkItemOffCpuColor.g, cfg->WorkItemOffCpuColor.b, cfg->WorkItemOffCpuColor.a);
+                SDL_RenderFillRect(m_renderer, &cpuRect);
+
+                cpuRect.w = static_cast<int>(static_cast<float>(cpuRect.w) * onCpuRatio + 0.5f);
+                SDL_SetRenderDrawColor(m_renderer, cfg->WorkItemOnCpuColor.r, cfg->WorkItemOnCpuColor.g, cfg->WorkItemOnCpuColor.b, cfg->WorkItemOnCpuColor.a);
+                SDL_RenderFillRect(m_renderer, &cpuRect);
+            }
+
             SDL_SetRenderDrawColor(m_renderer, cfg->WorkItemBlockBorderColor.r, cfg->WorkItemBlockBorderColor.g, cfg->WorkItemBlockBorderColor.b, cfg->WorkItemBlockBorderColor.a);
             SDL_RenderDrawRects(m_renderer, &blockRect, 1);
 
             if (rightPx - leftPx > 32) {
-                m_textRenderer.RenderText(blockRect.x + 4, blockRect.y + 2, wi.routineName, cfg->WorkItemText1Color);
-                m_textRenderer.RenderText(blockRect.x + 4, blockRect.y + 20, FormatDuration(wi.stopTimeNs - wi.startTimeNs, 4).c_str(), cfg->WorkItemText2Color);
+                if (m_showCpuLanes)
+                    m_textRenderer.RenderText(blockRect.x + 4, blockRect.y + 2, (std::string{wi.workerName} + ": " + wi.routineName).c_str(), cfg->WorkItemText1Color);
+                else
+                    m_textRenderer.RenderText(blockRect.x + 4, blockRect.y + 2, wi.routineName, cfg->WorkItemText1Color);
+                m_textRenderer.RenderText(blockRect.x + 4, blockRect.y + 20, FormatDuration(wi.duration(), 4).c_str(), cfg->WorkItemText2Color);
             }
         }
 
         workerOffsetY += 1 + 40 * worker.stackLevels;
 
         m_pixelWideBlockDeferredRenderer.RenderAll();
+
+        if (!worker.stackSamples.empty())
+        {
+            if (workerOffsetY + 12 > 0 && workerOffsetY < rendererHeight)
+            {
+                PERFTRACE_IN(PerfCategory::Draw, "TimeScaleView.Draw StackSampleLane");
+                if (const auto* stackSample = DrawStackSampleLane(worker, workerOffsetY, rendererWidth))
+                    pointedStackSample = stackSample;
+            }
+
+            workerOffsetY += 13;
+        }
     }
 
+    // Arrows of the tasks link the work items of the workers, which are not drawn along with the CPUs.
+    if (!m_showCpuLanes)
+    {
+        PERFTRACE("TimeScaleView.Draw TaskFlows");
+        DrawTaskFlows(pointedWorkItem, rendererWidth);
+    }
+
+    for (const auto& counterGroupKV : m_workload->counterGroups)
+    {
+        const auto& counterGroup = counterGroupKV.second;
+
+        // Draw the counter group banner.
+        SDL_Rect counterBannerRect { 0, workerOffsetY, rendererWidth, 19};
+
+        SDL_Color counterBannerBgColor = cfg->CounterBannerBackgroundColor;
+        if (mouseY >= counterBannerRect.y && mouseY < counterBannerRect.y + counterBannerRect.h)
+        {
+            counterBannerBgColor = LerpColor(counterBannerBgColor, SDL_Color{255, 255, 255, 255}, 0.2f);
+        }
+
+        SDL_SetRenderDrawColor(m_renderer, counterBannerBgColor.r, counterBannerBgColor.g, counterBannerBgColor.b, counterBannerBgColor.a);
+        SDL_RenderFillRect(m_renderer, &counterBannerRect);
+        m_textRenderer.RenderText(3, workerOffsetY + 1, counterGroup.name, cfg->CounterBannerTextColor);
+        workerOffsetY += 20;
+
+        for (const auto& counterKV : counterGroup.counters)
+        {
+            // Lanes out of sight are skipped, so the drawing time does not depend on the number of counters below.
+            if (workerOffsetY + 40 > 0 && workerOffsetY < rendererHeight)
+            {
+                PERFTRACE_IN(PerfCategory::Draw, "TimeScaleView.Draw CounterLane");
+                DrawCounterLane(counterKV.second, workerOffsetY, rendererWidth);
+            }
+
+            workerOffsetY += 40;
+        }
+
+        workerOffsetY += 1;
+    }
+
+    if (pointedStackSample != nullptr)
+        DrawStackSampleFrames(*pointedStackSample);
+
     // Draw the time scale top ruler.
     //
     {
@@ -317,6 +422,196 @@ void TimeScaleView::Draw()
     m_textRenderer.RenderText(mouseX + 1, 22, FormatTimePoint(m_camera.PxToNs(mouseX)).c_str(), cfg->MouseMarkerColor);
 }
 
+// Draws arrows from every work item of a task to its next one, which starts after the former has stopped (e.g. upon a hand-over between workers).
+// The arrows of the pointed task are highlighted and its end-to-end latency is shown next to the mouse.
+//
+void TimeScaleView::DrawTaskFlows(const Workload::WorkItem* pointedWorkItem, int rendererWidth)
+{
+    const auto viewLeftNs = m_camera.PxToNs(0) + m_workload->startTimeNs;
+    const auto viewRightNs = m_camera.PxToNs(rendererWidth) + m_workload->startTimeNs;
+
+    auto workItemPoint = [&](const Workload::WorkItem& workItem, uint64_t timeNs) {
+        return SDL_Point{
+            static_cast<int>(std::max(std::min(m_camera.NsToPx(static_cast<int64_t>(timeNs) - m_workload->startTimeNs), int64_t{rendererWidth + 1}), int64_t{-1})),
+            m_workerTopPxs[workItem.workerName] + 40 * workItem.stackLevel + 20 };
+    };
+
+    for (const auto& taskKV : m_workload->tasks)
+    {
+        const auto& task = taskKV.second;
+        const auto taskStartNs = static_cast<int64_t>(task.workItems.front()->startTimeNs);
+
+        if (task.workItems.size() < 2 || taskStartNs > viewRightNs || taskStartNs + static_cast<int64_t>(task.latencyNs) < viewLeftNs)
+            continue;
+
+        const bool pointed = pointedWorkItem != nullptr && pointedWorkItem->taskId == task.taskId;
+        const SDL_Color color = pointed ? cfg->FlowArrowHighlightColor : cfg->FlowArrowColor;
+        SDL_SetRenderDrawColor(m_renderer, color.r, color.g, color.b, color.a);
+
+        // The work item stopped last so far, from which the arrow to the next stage begins.
+        const Workload::WorkItem* lastWorkItem = nullptr;
+
+        for (const Workload::WorkItem* workItem : task.workItems)
+        {
+            if (workItem->async)
+                continue;
+
+            if (lastWorkItem != nullptr && workItem->startTimeNs >= lastWorkItem->stopTimeNs)
+            {
+                const auto from = workItemPoint(*lastWorkItem, lastWorkItem->stopTimeNs);
+                const auto to = workItemPoint(*workItem, workItem->startTimeNs);
+
+                SDL_RenderDrawLine(m_renderer, from.x, from.y, to.x, to.y);
+                SDL_RenderDrawLine(m_renderer, to.x - 4, to.y - 3, to.x, to.y);
+                SDL_RenderDrawLine(m_renderer, to.x - 4, to.y + 3, to.x, to.y);
+            }
+
+            if (lastWorkItem == nullptr || workItem->stopTimeNs > lastWorkItem->stopTimeNs)
+                lastWorkItem = workItem;
+        }
+    }
+
+    if (pointedWorkItem != nullptr && pointedWorkItem->taskId != 0)
+    {
+        const auto& task = m_workload->tasks.at(pointedWorkItem->taskId);
+
+        int mouseX, mouseY;
+        SDL_GetMouseState(&mouseX, &mouseY);
+
+        const auto caption = "Task " + std::to_string(task.taskId) +
+            "  E2E " + FormatDuration(static_cast<int64_t>(task.latencyNs), 4) +
+            "  Queued " + FormatDuration(static_cast<int64_t>(task.queueingNs), 4);
+        m_textRenderer.RenderText(mouseX + 12, mouseY + 12, caption.c_str(), cfg->FlowArrowHighlightColor);
+    }
+}
+
+// Draws the counter as a step graph, in which every pixel column spans from the minimal to the maximal value held by the counter within the column time span.
+// Sample ranges are summarized by Workload::Counter::MinMax(), so the cost per column is logarithmic in the number of samples.
+//
+void TimeScaleView::DrawCounterLane(const Workload::Counter& counter, int topPx, int rendererWidth)
+{
+    SDL_Rect laneRect { 0, topPx, rendererWidth, 39 };
+    SDL_SetRenderDrawColor(m_renderer, cfg->CounterLaneBackgroundColor.r, cfg->CounterLaneBackgroundColor.g, cfg->CounterLaneBackgroundColor.b, cfg->CounterLaneBackgroundColor.a);
+    SDL_RenderFillRect(m_renderer, &laneRect);
+
+    const auto& timesNs = counter.timesNs;
+    const int64_t valueRange = std::max(counter.maxValue - counter.minValue, int64_t{1});
+
+    // The top and bottom pixels of the lane are left as a margin.
+    auto valueToPx = [&](int64_t value) {
+        return topPx + 37 - static_cast<int>(static_cast<double>(value - counter.minValue) * 35.0 / static_cast<double>(valueRange));
+    };
+
+    m_counterRects.clear();
+
+    auto sampleIter = std::begin(timesNs);
+
+    for (int x = 0; x < rendererWidth; ++x)
+    {
+        const auto columnStopNs = static_cast<uint64_t>(std::max(m_camera.PxToNs(x + 1) + m_workload->startTimeNs, int64_t{0}));
+        const auto columnStartIter = sampleIter;
+        sampleIter = std::lower_bound(sampleIter, std::end(timesNs), columnStopNs);
+
+        // The step of the last sample is not prolonged any further.
+        if (columnStartIter == std::end(timesNs))
+            break;
+
+        // The value held at the column start is that of the preceding sample.
+        auto beginIdx = static_cast<size_t>(columnStartIter - std::begin(timesNs));
+        const auto endIdx = static_cast<size_t>(sampleIter - std::begin(timesNs));
+
+        if (beginIdx > 0)
+            --beginIdx;
+        else if (endIdx == 0)
+            continue;
+
+        const auto minMax = counter.MinMax(beginIdx, endIdx);
+        const int topValuePx = valueToPx(minMax.second);
+        const int bottomValuePx = valueToPx(minMax.first);
+
+        m_counterRects.push_back(SDL_Rect{ x, topValuePx, 1, bottomValuePx - topValuePx + 1 });
+    }
+
+    SDL_SetRenderDrawColor(m_renderer, cfg->CounterLineColor.r, cfg->CounterLineColor.g, cfg->CounterLineColor.b, cfg->CounterLineColor.a);
+    SDL_RenderFillRects(m_renderer, m_counterRects.data(), static_cast<int>(m_counterRects.size()));
+
+    const auto caption = std::string{counter.name} + "  [" + std::to_string(counter.minValue) + " .. " + std::to_string(counter.maxValue) + "]";
+    m_textRenderer.RenderText(3, topPx + 2, caption.c_str(), cfg->CounterTextColor);
+}
+
+// Draws a tick for every pixel column holding any stack samples of the worker, in a thin lane below its work items.
+// Returns the sample nearest to the mouse, if it points at the lane no further than 2 pixels away from a tick.
+//
+const Workload::StackSample* TimeScaleView::DrawStackSampleLane(const Workload::Worker& worker, int topPx, int rendererWidth)
+{
+    SDL_Rect laneRect { 0, topPx, rendererWidth, 12 };
+    SDL_SetRenderDrawColor(m_renderer, cfg->StackSampleLaneBackgroundColor.r, cfg->StackSampleLaneBackgroundColor.g, cfg->StackSampleLaneBackgroundColor.b, cfg->StackSampleLaneBackgroundColor.a);
+    SDL_RenderFillRect(m_renderer, &laneRect);
+
+    int mouseX, mouseY;
+    SDL_GetMouseState(&mouseX, &mouseY);
+    const bool lanePointed = mouseY >= laneRect.y && mouseY < laneRect.y + laneRect.h;
+
+    const auto& stackSamples = worker.stackSamples;
+    const auto viewLeftNs = static_cast<uint64_t>(std::max(m_camera.PxToNs(0) + m_workload->startTimeNs, int64_t{0}));
+
+    auto sampleIter = std::lower_bound(std::begin(stackSamples), std::end(stackSamples), viewLeftNs, [](const Workload::StackSample& stackSample, uint64_t timeNs) {
+        return stackSample.timeNs < timeNs;
+    });
+
+    const Workload::StackSample* pointedStackSample = nullptr;
+    int pointedDistancePx = 3;
+    int lastTickPx = -1;
+
+    m_stackSampleRects.clear();
+
+    for (; sampleIter != std::end(stackSamples); ++sampleIter)
+    {
+        const auto tickPx = static_cast<int>(m_camera.NsToPx(static_cast<int64_t>(sampleIter->timeNs) - m_workload->startTimeNs));
+        if (tickPx >= rendererWidth)
+            break;
+
+        if (lanePointed && std::abs(tickPx - mouseX) < pointedDistancePx)
+        {
+            pointedStackSample = &*sampleIter;
+            pointedDistancePx = std::abs(tickPx - mouseX);
+        }
+
+        // Many samples may fall into a single column once zoomed out.
+        if (tickPx != lastTickPx)
+        {
+            m_stackSampleRects.push_back(SDL_Rect{ tickPx, topPx + 2, 1, 8 });
+            lastTickPx = tickPx;
+        }
+    }
+
+    SDL_SetRenderDrawColor(m_renderer, cfg->StackSampleColor.r, cfg->StackSampleColor.g, cfg->StackSampleColor.b, cfg->StackSampleColor.a);
+    SDL_RenderFillRects(m_renderer, m_stackSampleRects.data(), static_cast<int>(m_stackSampleRects.size()));
+
+    if (pointedStackSample != nullptr)
+    {
+        const SDL_Rect tickRect { static_cast<int>(m_camera.NsToPx(static_cast<int64_t>(pointedStackSample->timeNs) - m_workload->startTimeNs)) - 1, topPx, 3, 12 };
+        SDL_SetRenderDrawColor(m_renderer, cfg->StackSampleHighlightColor.r, cfg->StackSampleHighlightColor.g, cfg->StackSampleHighlightColor.b, cfg->StackSampleHighlightColor.a);
+        SDL_RenderFillRect(m_renderer, &tickRect);
+    }
+
+    return pointedStackSample;
+}
+
+// Lists the frames of the pointed stack sample next to the mouse, the sampled function on top.
+//
+void TimeScaleView::DrawStackSampleFrames(const Workload::StackSample& stackSample)
+{
+    int mouseX, mouseY;
+    SDL_GetMouseState(&mouseX, &mouseY);
+
+    for (uint8_t frameIdx = 0; frameIdx < stackSample.frameCount; ++frameIdx)
+    {
+        const char* const frameName = m_workload->stackFrames[stackSample.framesIdx + frameIdx];
+        m_textRenderer.RenderText(mouseX + 12, mouseY + 12 + 18 * frameIdx, frameName, cfg->StackSampleHighlightColor);
+    }
+}
+
 TimeScaleView::TimeScaleRuler TimeScaleView::FitTimeScaleRuler()
 {
     const auto minLabelSpacingNs = static_cast<double>(m_camera.widthNs) / (static_cast<double>(m_camera.rendererWidth) / static_cast<double>(cfg->MinTimeScaleLabelWidthPx));
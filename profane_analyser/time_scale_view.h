@@ -47,6 +47,10 @@ class TimeScaleView
     Workload* m_workload;
     Camera m_camera;
     PixelWideBlockDeferredRenderer m_pixelWideBlockDeferredRenderer;
+    std::vector<SDL_Rect> m_counterRects;
+    std::vector<SDL_Rect> m_stackSampleRects;
+    std::map<const char*, int> m_workerTopPxs;      // Top of the first stack level of every worker, as of the last drawn frame.
+    bool m_showCpuLanes = false;                    // Whether the lanes of the CPUs are shown instead of the workers (toggled with 'C').
 
 public:
     TimeScaleView(SDL_Renderer* renderer, TextRenderer& textRenderer, Workload& workload);
@@ -61,4 +65,8 @@ private:
     };
 
     TimeScaleRuler FitTimeScaleRuler();
+    void DrawTaskFlows(const Workload::WorkItem* pointedWorkItem, int rendererWidth);
+    void DrawCounterLane(const Workload::Counter& counter, int topPx, int rendererWidth);
+    const Workload::StackSample* DrawStackSampleLane(const Workload::Worker& worker, int topPx, int rendererWidth);
+    void DrawStackSampleFrames(const Workload::StackSample& stackSample);
 };
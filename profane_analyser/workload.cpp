@@ -25,16 +25,427 @@ void UpdateStackLevel(Workload::Worker& worker)
     worker.stackLevels = static_cast<uint8_t>(endTimesStack.size());
 }
 
-Workload BuildWorkload(profane::bin::FileContent&& fileContent)
+// Orders the work items of the task and finds how much of its latency has been spent between the work items.
+// Asynchronous spans are left out of the coverage, as they usually enclose the whole task including its waits in queues.
+//
+void UpdateTaskLatency(Workload::Task& task)
+{
+    auto& workItems = task.workItems;
+
+    std::stable_sort(std::begin(workItems), std::end(workItems), [](const Workload::WorkItem* w1, const Workload::WorkItem* w2) {
+        return w1->startTimeNs < w2->startTimeNs;
+    });
+
+    const uint64_t startTimeNs = workItems.front()->startTimeNs;
+    uint64_t stopTimeNs = startTimeNs;
+    uint64_t coveredUntilNs = startTimeNs;
+    uint64_t coveredNs = 0;
+
+    for (const Workload::WorkItem* workItem : workItems)
+    {
+        stopTimeNs = std::max(stopTimeNs, workItem->stopTimeNs);
+
+        if (workItem->async || workItem->stopTimeNs <= coveredUntilNs)
+            continue;
+
+        coveredNs += workItem->stopTimeNs - std::max(workItem->startTimeNs, coveredUntilNs);
+        coveredUntilNs = workItem->stopTimeNs;
+    }
+
+    task.latencyNs = stopTimeNs - startTimeNs;
+    task.queueingNs = task.latencyNs - coveredNs;
+}
+
+std::pair<int64_t, int64_t> Workload::Counter::MinMax(size_t beginIdx, size_t endIdx) const
+{
+    assert(beginIdx < endIdx && endIdx <= values.size());
+
+    std::pair<int64_t, int64_t> minMax { std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min() };
+
+    auto merge = [&](std::pair<int64_t, int64_t> blockMinMax) {
+        minMax.first = std::min(minMax.first, blockMinMax.first);
+        minMax.second = std::max(minMax.second, blockMinMax.second);
+    };
+
+    // Ascends the levels, taking the unpaired blocks at both ends of the range.
+    for (size_t level = 0; beginIdx < endIdx; ++level, beginIdx /= 2, endIdx /= 2)
+    {
+        auto blockMinMax = [&](size_t blockIdx) {
+            return (level == 0) ? std::make_pair(values[blockIdx], values[blockIdx]) : minMaxLevels[level - 1][blockIdx];
+        };
+
+        if (beginIdx % 2 == 1)
+            merge(blockMinMax(beginIdx++));
+
+        if (endIdx % 2 == 1)
+            merge(blockMinMax(--endIdx));
+    }
+
+    return minMax;
+}
+
+void UpdateMinMaxLevels(Workload::Counter& counter)
+{
+    if (counter.values.empty())
+        return;
+
+    counter.minValue = *std::min_element(std::begin(counter.values), std::end(counter.values));
+    counter.maxValue = *std::max_element(std::begin(counter.values), std::end(counter.values));
+
+    for (size_t blockCount = counter.values.size() / 2; blockCount > 0; blockCount /= 2)
+    {
+        std::vector<std::pair<int64_t, int64_t>> level(blockCount);
+
+        for (size_t blockIdx = 0; blockIdx < blockCount; ++blockIdx)
+        {
+            if (counter.minMaxLevels.empty())
+            {
+                level[blockIdx] = std::minmax(counter.values[2 * blockIdx], counter.values[2 * blockIdx + 1]);
+            }
+            else
+            {
+                const auto& lowerLevel = counter.minMaxLevels.back();
+                level[blockIdx] = std::make_pair(
+                    std::min(lowerLevel[2 * blockIdx].first, lowerLevel[2 * blockIdx + 1].first),
+                    std::max(lowerLevel[2 * blockIdx].second, lowerLevel[2 * blockIdx + 1].second));
+            }
+        }
+
+        counter.minMaxLevels.push_back(std::move(level));
+    }
+}
+
+// Excludes the tracer overhead of all the nested work items from the duration of every work item.
+// Work items are ordered by their start time, outer ones first, so the ancestors of a work item are those still open upon its start.
+//
+void CompensateTracerOverhead(Workload::Worker& worker, uint64_t spanOverheadNs)
+{
+    // Open work items along with the numbers of their descendants so far.
+    std::vector<std::pair<Workload::WorkItem*, uint64_t>> openWorkItems;
+
+    auto closeWorkItem = [&]() {
+        const auto closed = openWorkItems.back();
+        openWorkItems.pop_back();
+
+        closed.first->overheadNs = std::min(closed.second * spanOverheadNs, closed.first->stopTimeNs - closed.first->startTimeNs);
+
+        if (!openWorkItems.empty())
+            openWorkItems.back().second += closed.second + 1;
+    };
+
+    for (auto& workItem : worker.workItems)
+    {
+        if (workItem.async)
+            continue;
+
+        while (!openWorkItems.empty() && openWorkItems.back().first->stopTimeNs <= workItem.startTimeNs)
+            closeWorkItem();
+
+        openWorkItems.push_back(std::make_pair(&workItem, uint64_t{0}));
+    }
+
+    while (!openWorkItems.empty())
+        closeWorkItem();
+}
+
+// Sums the self allocations of the routines, i.e. those of their work items less those of the nested work items.
+// Work items are ordered by their start time, outer ones first, so the parent of a work item is the innermost one still open upon its start.
+//
+void UpdateSelfAllocations(Workload& workload, const Workload::Worker& worker)
+{
+    // Open work items along with the bytes allocated by their children so far.
+    std::vector<std::pair<const Workload::WorkItem*, uint64_t>> openWorkItems;
+
+    auto allocatedBytesOf = [&](const Workload::WorkItem& workItem) {
+        const auto* const perfCounters = workload.perfCountersOf(workItem);
+        return (perfCounters != nullptr && perfCounters->allocationsCounted) ? perfCounters->allocatedBytes : uint64_t{0};
+    };
+
+    auto closeWorkItem = [&]() {
+        const auto closed = openWorkItems.back();
+        openWorkItems.pop_back();
+
+        const auto allocatedBytes = allocatedBytesOf(*closed.first);
+        auto found = workload.routineAllocations.find(closed.first->routineName);
+        if (found != std::end(workload.routineAllocations))
+            found->second.selfAllocatedBytes += allocatedBytes - std::min(closed.second, allocatedBytes);
+
+        if (!openWorkItems.empty())
+            openWorkItems.back().second += allocatedBytes;
+    };
+
+    for (const auto& workItem : worker.workItems)
+    {
+        if (workItem.async)
+            continue;
+
+        while (!openWorkItems.empty() && openWorkItems.back().first->stopTimeNs <= workItem.startTimeNs)
+            closeWorkItem();
+
+        openWorkItems.push_back(std::make_pair(&workItem, uint64_t{0}));
+    }
+
+    while (!openWorkItems.empty())
+        closeWorkItem();
+}
+
+// Copies the work items with their CPUs recorded to the lanes of the CPUs they have started on.
+// The lanes are named with the CPU numbers padded to the same width, so that they are ordered by the number.
+//
+void BuildCpuLanes(Workload& workload)
+{
+    std::map<uint16_t, Workload::Worker> cpuLanes;
+
+    for (const auto& workerKV : workload.workers)
+    {
+        const auto& worker = workerKV.second;
+
+        for (size_t workItemIdx = 0; workItemIdx < worker.workItems.size(); ++workItemIdx)
+        {
+            const auto& workItem = worker.workItems[workItemIdx];
+            const auto* const perfCounters = workload.perfCountersOf(workItem);
+            if (perfCounters == nullptr || !perfCounters->scheduled)
+                continue;
+
+            auto& cpuLane = cpuLanes[perfCounters->startCpu];
+            cpuLane.workItems.push_back(workItem);
+            cpuLane.sourceWorkItemIdxs.push_back(static_cast<uint32_t>(workItemIdx));
+        }
+    }
+
+    if (cpuLanes.empty())
+        return;
+
+    const auto cpuNumberWidth = static_cast<int>(std::to_string(cpuLanes.rbegin()->first).size());
+
+    for (auto& cpuLaneKV : cpuLanes)
+    {
+        auto& cpuLane = cpuLaneKV.second;
+
+        char cpuLaneName[16];
+        std::snprintf(cpuLaneName, sizeof(cpuLaneName), "CPU %0*u", cpuNumberWidth, static_cast<unsigned>(cpuLaneKV.first));
+        workload.cpuLaneNames.push_back(cpuLaneName);
+        cpuLane.name = workload.cpuLaneNames.back().c_str();
+
+        // Work items of the workers are merged, so they are ordered again, along with the indices of their sources.
+        std::vector<uint32_t> order(cpuLane.workItems.size());
+        std::iota(std::begin(order), std::end(order), uint32_t{0});
+        std::stable_sort(std::begin(order), std::end(order), [&](uint32_t idx1, uint32_t idx2) {
+            const auto& w1 = cpuLane.workItems[idx1];
+            const auto& w2 = cpuLane.workItems[idx2];
+            return w1.startTimeNs < w2.startTimeNs || (w1.startTimeNs == w2.startTimeNs && w1.stopTimeNs > w2.stopTimeNs);
+        });
+
+        Workload::Worker& orderedCpuLane = workload.cpuLanes.insert(std::make_pair(cpuLane.name, Workload::Worker{cpuLane.name})).first->second;
+        for (const auto idx : order)
+        {
+            orderedCpuLane.workItems.push_back(cpuLane.workItems[idx]);
+            orderedCpuLane.sourceWorkItemIdxs.push_back(cpuLane.sourceWorkItemIdxs[idx]);
+        }
+
+        UpdateStackLevel(orderedCpuLane);
+    }
+}
+
+// Sums the waits for the locks traced by profane::TracedMutex and their holds, by the lock, i.e. by the worker of the work items.
+//
+std::vector<Workload::LockContention> SummarizeLockContentions(const Workload& workload, const std::vector<profane::bin::WorkItem>& workItems)
+{
+    const size_t maxTopWaiterCount = 5;
+
+    struct LockWaits
+    {
+        Workload::LockContention contention;
+        std::vector<uint64_t> waitsNs;
+        std::map<const char*, uint64_t> waiterWaitsNs;
+    };
+
+    std::map<const char*, LockWaits> lockWaits;
+
+    for (const auto& workItem : workItems)
+    {
+        if ((workItem.flags & (profane::WorkItemFlags::LockWait | profane::WorkItemFlags::LockHold)) == 0)
+            continue;
+
+        const char* const lockName = workload.dictionary[workItem.workerNameIdx].c_str();
+        auto& waits = lockWaits[lockName];
+        waits.contention.lockName = lockName;
+
+        const auto durationNs = workItem.stopTimeNs - workItem.startTimeNs;
+        if ((workItem.flags & profane::WorkItemFlags::LockWait) != 0)
+        {
+            ++waits.contention.waitCount;
+            waits.contention.waitNs += durationNs;
+            waits.waitsNs.push_back(durationNs);
+            waits.waiterWaitsNs[workload.dictionary[workItem.routineNameIdx].c_str()] += durationNs;
+        }
+        else
+        {
+            ++waits.contention.holdCount;
+            waits.contention.holdNs += durationNs;
+        }
+    }
+
+    std::vector<Workload::LockContention> lockContentions;
+
+    for (auto& lockWaitsKV : lockWaits)
+    {
+        auto& waits = lockWaitsKV.second;
+        auto& contention = waits.contention;
+
+        if (!waits.waitsNs.empty())
+        {
+            const auto p99Iter = std::begin(waits.waitsNs) + (waits.waitsNs.size() - 1) * 99 / 100;
+            std::nth_element(std::begin(waits.waitsNs), p99Iter, std::end(waits.waitsNs));
+            contention.p99WaitNs = *p99Iter;
+        }
+
+        contention.topWaiters.assign(std::begin(waits.waiterWaitsNs), std::end(waits.waiterWaitsNs));
+        std::sort(std::begin(contention.topWaiters), std::end(contention.topWaiters), [](const std::pair<const char*, uint64_t>& w1, const std::pair<const char*, uint64_t>& w2) {
+            return w1.second > w2.second;
+        });
+        contention.topWaiters.resize(std::min(contention.topWaiters.size(), maxTopWaiterCount));
+
+        lockContentions.push_back(std::move(contention));
+    }
+
+    std::sort(std::begin(lockContentions), std::end(lockContentions), [](const Workload::LockContention& lc1, const Workload::LockContention& lc2) {
+        return lc1.waitNs > lc2.waitNs;
+    });
+
+    return lockContentions;
+}
+
+// Fits the durations of the work items of a routine to the values of each of their arguments.
+// Sums are taken around the means, so that large values (e.g. byte counts) do not cost precision.
+//
+std::vector<Workload::ArgCorrelation> CorrelateArgs(const Workload& workload, const std::vector<Workload::WorkItem*>& workItems)
+{
+    struct Sums
+    {
+        size_t count = 0;
+        double value = 0.0;
+        double duration = 0.0;
+        double valueValue = 0.0;
+        double valueDuration = 0.0;
+        double durationDuration = 0.0;
+    };
+
+    std::map<const char*, Sums, Workload::CStrLess> argSums;
+
+    auto forEachArg = [&](auto func) {
+        for (const auto* workItem : workItems)
+        {
+            for (uint8_t argIdx = 0; argIdx < workItem->argCount; ++argIdx)
+                func(*workItem, workload.spanArgs[workItem->argsIdx + argIdx]);
+        }
+    };
+
+    forEachArg([&](const Workload::WorkItem& workItem, const Workload::SpanArg& arg) {
+        auto& sums = argSums[arg.name];
+        ++sums.count;
+        sums.value += static_cast<double>(arg.value);
+        sums.duration += static_cast<double>(workItem.duration());
+    });
+
+    for (auto& argSumsKV : argSums)
+    {
+        auto& sums = argSumsKV.second;
+        sums.value /= static_cast<double>(sums.count);
+        sums.duration /= static_cast<double>(sums.count);
+    }
+
+    forEachArg([&](const Workload::WorkItem& workItem, const Workload::SpanArg& arg) {
+        auto& sums = argSums[arg.name];
+        const double value = static_cast<double>(arg.value) - sums.value;
+        const double duration = static_cast<double>(workItem.duration()) - sums.duration;
+        sums.valueValue += value * value;
+        sums.valueDuration += value * duration;
+        sums.durationDuration += duration * duration;
+    });
+
+    std::vector<Workload::ArgCorrelation> argCorrelations;
+
+    for (const auto& argSumsKV : argSums)
+    {
+        const auto& sums = argSumsKV.second;
+
+        Workload::ArgCorrelation argCorrelation;
+        argCorrelation.argName = argSumsKV.first;
+        argCorrelation.sampleCount = sums.count;
+
+        if (sums.valueValue > 0.0)
+        {
+            argCorrelation.nsPerUnit = sums.valueDuration / sums.valueValue;
+            argCorrelation.fixedNs = sums.duration - argCorrelation.nsPerUnit * sums.value;
+
+            if (sums.durationDuration > 0.0)
+                argCorrelation.correlation = sums.valueDuration / std::sqrt(sums.valueValue * sums.durationDuration);
+        }
+
+        argCorrelations.push_back(argCorrelation);
+    }
+
+    return argCorrelations;
+}
+
+// Estimates the duration, which the given fraction of the aggregated calls do not exceed.
+// The calls of the bucket of the percentile are assumed to be spread evenly over the bucket.
+uint64_t EstimateDurationPercentileNs(const profane::bin::RoutineAggregate& aggregate, double fraction)
+{
+    const double rank = std::max(fraction * static_cast<double>(aggregate.callCount), 1.0);
+    uint64_t precedingCount = 0;
+
+    for (uint32_t bucketIdx = 0; bucketIdx < profane::bin::DurationBucketCount; ++bucketIdx)
+    {
+        const auto bucketCount = aggregate.bucketCounts[bucketIdx];
+        if (bucketCount == 0 || static_cast<double>(precedingCount + bucketCount) < rank)
+        {
+            precedingCount += bucketCount;
+            continue;
+        }
+
+        const double lowerNs = static_cast<double>(profane::bin::DurationBucketLowerBound(bucketIdx)) * aggregate.nsPerTick;
+        const double upperNs = (bucketIdx + 1 < profane::bin::DurationBucketCount)
+            ? static_cast<double>(profane::bin::DurationBucketLowerBound(bucketIdx + 1)) * aggregate.nsPerTick
+            : static_cast<double>(aggregate.maxDurationNs);
+        const double estimateNs = lowerNs + (upperNs - lowerNs) * (rank - static_cast<double>(precedingCount)) / static_cast<double>(bucketCount);
+
+        return std::min(std::max(static_cast<uint64_t>(estimateNs), aggregate.minDurationNs), aggregate.maxDurationNs);
+    }
+
+    return aggregate.maxDurationNs;
+}
+
+Workload BuildWorkload(profane::bin::FileContent&& fileContent, bool compensateTracerOverhead)
 {
     Workload workload;
 
     workload.dictionary = std::move(fileContent.dictionary);
     const auto& dictionary = workload.dictionary;
 
+    // Work items are not necessarily ordered by their start time (e.g. when the performance log has been streamed).
     if (!fileContent.workItems.empty())
     {
-        workload.startTimeNs = fileContent.workItems[0].startTimeNs;
+        workload.startTimeNs = std::min_element(std::begin(fileContent.workItems), std::end(fileContent.workItems), [](const profane::bin::WorkItem& w1, const profane::bin::WorkItem& w2) {
+            return w1.startTimeNs < w2.startTimeNs;
+        })->startTimeNs;
+    }
+
+    // Counter samples are ordered by their time within the file.
+    if (!fileContent.counterSamples.empty())
+    {
+        const auto counterStartTimeNs = static_cast<int64_t>(fileContent.counterSamples.front().timeNs);
+        workload.startTimeNs = fileContent.workItems.empty() ? counterStartTimeNs : std::min(workload.startTimeNs, counterStartTimeNs);
+    }
+
+    // Stack samples are ordered by their time within every thread only.
+    if (!fileContent.stackSamples.empty())
+    {
+        const auto stackStartTimeNs = static_cast<int64_t>(std::min_element(std::begin(fileContent.stackSamples), std::end(fileContent.stackSamples), [](const profane::bin::StackSample& s1, const profane::bin::StackSample& s2) {
+            return s1.timeNs < s2.timeNs;
+        })->timeNs);
+        workload.startTimeNs = (fileContent.workItems.empty() && fileContent.counterSamples.empty()) ? stackStartTimeNs : std::min(workload.startTimeNs, stackStartTimeNs);
     }
 
     for (const auto& workItem : fileContent.workItems)
@@ -46,20 +457,128 @@ Workload BuildWorkload(profane::bin::FileContent&& fileContent)
         Workload::Worker& worker = worker_iter->second;
 
         const char* const routineName = dictionary[workItem.routineNameIdx].c_str();
+        const auto argsIdx = static_cast<uint32_t>(workload.spanArgs.size());
+
+        for (uint32_t argIdx = workItem.argsIdx; argIdx < workItem.argsIdx + workItem.argCount; ++argIdx)
+        {
+            const auto& arg = fileContent.spanArgs[argIdx];
+            workload.spanArgs.push_back(Workload::SpanArg{dictionary[arg.nameIdx].c_str(), arg.value});
+        }
+
+        const bool allocationsCounted = (workItem.flags & profane::WorkItemFlags::Allocations) != 0;
+        const bool cpuTimeMeasured = (workItem.flags & profane::WorkItemFlags::CpuTime) != 0;
+        const bool scheduled = (workItem.flags & profane::WorkItemFlags::Scheduling) != 0;
+
+        auto perfCountersIdx = Workload::NoPerfCounters;
+        if (workItem.metricsIdx != profane::bin::NoMetrics)
+        {
+            const auto& metrics = fileContent.workItemMetrics[workItem.metricsIdx];
+
+            // The clock of the thread's CPU time is coarser than the wall clock, so it may slightly overrun the duration.
+            const auto durationNs = workItem.stopTimeNs - workItem.startTimeNs;
+            const auto cpuTimeNs = std::min(metrics.cpuTimeNs, durationNs);
+
+            perfCountersIdx = static_cast<uint32_t>(workload.perfCounters.size());
+            workload.perfCounters.push_back(Workload::PerfCounters{metrics.perfCounterMask});
+            std::copy(std::begin(metrics.perfCounters), std::end(metrics.perfCounters), workload.perfCounters.back().values);
+            workload.perfCounters.back().allocationsCounted = allocationsCounted;
+            workload.perfCounters.back().allocationCount = metrics.allocationCount;
+            workload.perfCounters.back().allocatedBytes = metrics.allocatedBytes;
+            workload.perfCounters.back().cpuTimeMeasured = cpuTimeMeasured;
+            workload.perfCounters.back().cpuTimeNs = cpuTimeNs;
+            workload.perfCounters.back().scheduled = scheduled;
+            workload.perfCounters.back().startCpu = metrics.startCpu;
+            workload.perfCounters.back().stopCpu = metrics.stopCpu;
+            workload.perfCounters.back().voluntarySwitches = metrics.voluntarySwitches;
+            workload.perfCounters.back().involuntarySwitches = metrics.involuntarySwitches;
+
+            if (metrics.perfCounterMask != 0)
+            {
+                auto& routinePerfCounters = workload.routinePerfCounters[routineName];
+                for (uint8_t counterIdx = 0; counterIdx < profane::PerfCounterCount; ++counterIdx)
+                {
+                    if ((metrics.perfCounterMask & (1u << counterIdx)) != 0)
+                    {
+                        ++routinePerfCounters.workItemCounts[counterIdx];
+                        routinePerfCounters.sums[counterIdx] += metrics.perfCounters[counterIdx];
+                    }
+                }
+            }
+
+            if (allocationsCounted)
+            {
+                auto& routineAllocations = workload.routineAllocations[routineName];
+                ++routineAllocations.workItemCount;
+                routineAllocations.allocationCount += metrics.allocationCount;
+                routineAllocations.allocatedBytes += metrics.allocatedBytes;
+            }
+
+            if (cpuTimeMeasured)
+            {
+                auto& routineCpuTime = workload.routineCpuTimes[routineName];
+                ++routineCpuTime.workItemCount;
+                routineCpuTime.durationNs += durationNs;
+                routineCpuTime.cpuTimeNs += cpuTimeNs;
+            }
+        }
+
         worker.workItems.push_back(Workload::WorkItem{
             routineName,
             workItem.startTimeNs,
             workItem.stopTimeNs,
+            0,
+            static_cast<uint8_t>(workload.spanArgs.size() - argsIdx),
+            (workItem.flags & profane::WorkItemFlags::Async) != 0,
+            argsIdx,
+            workerName,
+            workItem.taskId,
+            perfCountersIdx,
             0
         });
     }
 
+    workload.lockContentions = SummarizeLockContentions(workload, fileContent.workItems);
+
+    for (const auto& stackSample : fileContent.stackSamples)
+    {
+        const char* const workerName = dictionary[stackSample.workerNameIdx].c_str();
+        auto worker_iter = workload.workers.find(workerName);
+        if (worker_iter == std::end(workload.workers))
+            worker_iter = workload.workers.insert(std::make_pair(workerName, Workload::Worker{workerName})).first;
+
+        worker_iter->second.stackSamples.push_back(Workload::StackSample{
+            stackSample.timeNs,
+            static_cast<uint32_t>(workload.stackFrames.size()),
+            stackSample.frameCount
+        });
+
+        for (uint8_t frameIdx = 0; frameIdx < stackSample.frameCount; ++frameIdx)
+            workload.stackFrames.push_back(dictionary[stackSample.frameNameIdxs[frameIdx]].c_str());
+    }
+
     for (auto& workerKV : workload.workers)
     {
         Workload::Worker& worker = workerKV.second;
+
+        // Samples of the threads serving the same worker are interleaved.
+        std::stable_sort(std::begin(worker.stackSamples), std::end(worker.stackSamples), [](const Workload::StackSample& s1, const Workload::StackSample& s2) {
+            return s1.timeNs < s2.timeNs;
+        });
+
+        // Outer work items go first, so that they get lower stack levels than the nested ones starting at the same time.
+        std::stable_sort(std::begin(worker.workItems), std::end(worker.workItems), [](const Workload::WorkItem& w1, const Workload::WorkItem& w2) {
+            return w1.startTimeNs < w2.startTimeNs || (w1.startTimeNs == w2.startTimeNs && w1.stopTimeNs > w2.stopTimeNs);
+        });
+
         UpdateStackLevel(worker);
+
+        if (compensateTracerOverhead && fileContent.spanOverheadNs > 0)
+            CompensateTracerOverhead(worker, fileContent.spanOverheadNs);
     }
 
+    workload.spanOverheadNs = fileContent.spanOverheadNs;
+    workload.tracerOverheadCompensated = compensateTracerOverhead && fileContent.spanOverheadNs > 0;
+
     for (auto& workerKV : workload.workers)
     {
         Workload::Worker& worker = workerKV.second;
@@ -70,13 +589,47 @@ Workload BuildWorkload(profane::bin::FileContent&& fileContent)
             auto& histogramWorkItems = insertion.first->second;
             histogramWorkItems.push_back(&workItem);
 
+            if (workItem.taskId != 0)
+            {
+                auto& task = workload.tasks[workItem.taskId];
+                task.taskId = workItem.taskId;
+                task.workItems.push_back(&workItem);
+            }
         }
     }
 
+    for (auto& taskKV : workload.tasks)
+    {
+        UpdateTaskLatency(taskKV.second);
+        workload.taskLatenciesNs.push_back(taskKV.second.latencyNs);
+    }
+
+    std::sort(std::begin(workload.taskLatenciesNs), std::end(workload.taskLatenciesNs));
+
+    if (!workload.routineAllocations.empty())
+    {
+        for (const auto& workerKV : workload.workers)
+            UpdateSelfAllocations(workload, workerKV.second);
+
+        for (const auto& routineAllocationsKV : workload.routineAllocations)
+            workload.routinesByAllocatedBytes.push_back(routineAllocationsKV.first);
+
+        std::sort(std::begin(workload.routinesByAllocatedBytes), std::end(workload.routinesByAllocatedBytes), [&](const char* r1, const char* r2) {
+            return workload.routineAllocations.at(r1).selfBytesPerCall() > workload.routineAllocations.at(r2).selfBytesPerCall();
+        });
+    }
+
     for (auto& routineWorkItemHistogramKV : workload.routineToWorkItemHistogramMap)
     {
         auto& histogramWorkItems = routineWorkItemHistogramKV.second;
 
+        if (!workload.spanArgs.empty())
+        {
+            auto argCorrelations = CorrelateArgs(workload, histogramWorkItems);
+            if (!argCorrelations.empty())
+                workload.routineArgCorrelations[routineWorkItemHistogramKV.first] = std::move(argCorrelations);
+        }
+
         std::sort(std::begin(histogramWorkItems), std::end(histogramWorkItems), [&](Workload::WorkItem* w1, Workload::WorkItem* w2) {
             return w1->duration() < w2->duration();
         });
@@ -105,5 +658,79 @@ Workload BuildWorkload(profane::bin::FileContent&& fileContent)
         }
     }
 
+    // The CPU lanes copy the work items of the workers, so they are built once the work items have got their ratios.
+    BuildCpuLanes(workload);
+
+    for (const auto& counterSample : fileContent.counterSamples)
+    {
+        const char* const counterGroupName = dictionary[counterSample.counterGroupNameIdx].c_str();
+        auto counterGroup_iter = workload.counterGroups.find(counterGroupName);
+        if (counterGroup_iter == std::end(workload.counterGroups))
+            counterGroup_iter = workload.counterGroups.insert(std::make_pair(counterGroupName, Workload::CounterGroup{counterGroupName})).first;
+
+        const char* const counterName = dictionary[counterSample.counterNameIdx].c_str();
+        auto& counters = counterGroup_iter->second.counters;
+        auto counter_iter = counters.find(counterName);
+        if (counter_iter == std::end(counters))
+            counter_iter = counters.insert(std::make_pair(counterName, Workload::Counter{counterName})).first;
+
+        counter_iter->second.timesNs.push_back(counterSample.timeNs);
+        counter_iter->second.values.push_back(counterSample.value);
+    }
+
+    for (auto& counterGroupKV : workload.counterGroups)
+    {
+        for (auto& counterKV : counterGroupKV.second.counters)
+            UpdateMinMaxLevels(counterKV.second);
+    }
+
+    for (const auto& aggregate : fileContent.routineAggregates)
+    {
+        Workload::RoutineAggregate routineAggregate;
+        routineAggregate.workerName = dictionary[aggregate.workerNameIdx].c_str();
+        routineAggregate.routineName = dictionary[aggregate.routineNameIdx].c_str();
+        routineAggregate.callCount = aggregate.callCount;
+        routineAggregate.totalNs = aggregate.totalDurationNs;
+        routineAggregate.minNs = aggregate.minDurationNs;
+        routineAggregate.maxNs = aggregate.maxDurationNs;
+        routineAggregate.p50Ns = EstimateDurationPercentileNs(aggregate, 0.5);
+        routineAggregate.p90Ns = EstimateDurationPercentileNs(aggregate, 0.9);
+        routineAggregate.p99Ns = EstimateDurationPercentileNs(aggregate, 0.99);
+        routineAggregate.p999Ns = EstimateDurationPercentileNs(aggregate, 0.999);
+        workload.routineAggregates.push_back(routineAggregate);
+    }
+
+    std::sort(std::begin(workload.routineAggregates), std::end(workload.routineAggregates), [](const Workload::RoutineAggregate& r1, const Workload::RoutineAggregate& r2) {
+        return r1.totalNs > r2.totalNs;
+    });
+
+    workload.unaggregatedSpanCount = fileContent.unaggregatedSpanCount;
+
+    workload.minSpanDurationNs = fileContent.minSpanDurationNs;
+    workload.droppedEventCount = fileContent.droppedEventCount;
+
+    std::map<const char*, std::pair<uint64_t, uint64_t>> routineCallCounts;
+
+    for (const auto& routineStats : fileContent.routineStats)
+    {
+        const char* const routineName = dictionary[routineStats.routineNameIdx].c_str();
+        auto& stats = workload.routineStats[routineName];
+        stats.droppedCount += routineStats.droppedCount;
+        stats.droppedDurationNs += routineStats.droppedDurationNs;
+
+        if (routineStats.samplingMode != profane::SamplingMode::None)
+        {
+            auto& callCounts = routineCallCounts[routineName];
+            callCounts.first += routineStats.callCount;
+            callCounts.second += routineStats.tracedCount;
+        }
+    }
+
+    for (const auto& routineCallCountsKV : routineCallCounts)
+    {
+        if (routineCallCountsKV.second.second > 0)
+            workload.routineStats[routineCallCountsKV.first].samplingScale = static_cast<double>(routineCallCountsKV.second.first) / static_cast<double>(routineCallCountsKV.second.second);
+    }
+
     return workload;
 }
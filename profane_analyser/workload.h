@@ -9,32 +9,286 @@ struct Workload
         bool operator()(const char* a, const char* b) const { return std::strcmp(a, b) < 0; }
     };
 
+    // A numeric argument of a work item (see profane::SpanArgs).
+    struct SpanArg
+    {
+        const char* name;
+        int64_t value;
+    };
+
     struct WorkItem
     {
         const char* routineName;
         uint64_t startTimeNs;
         uint64_t stopTimeNs;
         uint8_t stackLevel;
+        uint8_t argCount;
+        bool async;                         // Whether it is an asynchronous span of the task (see profane::WorkItemFlags::Async).
+        uint32_t argsIdx;                   // Index of the first argument of the work item in Workload::spanArgs.
+        const char* workerName;
+        uint32_t taskId;                    // Identifier of the task the work item belongs to, or 0 if none.
+        uint32_t perfCountersIdx;           // Index of the performance counters of the work item in Workload::perfCounters, or NoPerfCounters.
+        uint64_t overheadNs;                // Tracer overhead of the nested work items, excluded from the duration if compensated.
 
-        uint64_t duration() const noexcept { return stopTimeNs - startTimeNs; }
+        uint64_t duration() const noexcept { return stopTimeNs - startTimeNs - overheadNs; }
         float durationRatio;
         float durationOrderRatio;
     };
 
+    static constexpr uint32_t NoPerfCounters = UINT32_MAX;
+
+    // Increments of the performance counters during a work item (see profane::PerfCounter), along with its heap allocations, CPU time and scheduling.
+    struct PerfCounters
+    {
+        uint8_t mask;
+        uint64_t values[profane::PerfCounterCount];
+        bool allocationsCounted;
+        uint64_t allocationCount;
+        uint64_t allocatedBytes;
+        bool cpuTimeMeasured;
+        uint64_t cpuTimeNs;                 // CPU time of the thread during the work item, no longer than its duration.
+        bool scheduled;                     // Whether the CPUs and the context switches have been recorded (see profane::SchedulingTraits).
+        uint16_t startCpu;
+        uint16_t stopCpu;
+        uint32_t voluntarySwitches;
+        uint32_t involuntarySwitches;
+
+        bool has(profane::PerfCounter counter) const noexcept { return (mask & (1u << static_cast<uint8_t>(counter))) != 0; }
+        uint64_t operator[](profane::PerfCounter counter) const noexcept { return values[static_cast<uint8_t>(counter)]; }
+    };
+
+    // Sums of the performance counters over the work items of a routine, which counted them.
+    struct RoutinePerfCounters
+    {
+        uint64_t workItemCounts[profane::PerfCounterCount] = {};
+        uint64_t sums[profane::PerfCounterCount] = {};
+
+        bool has(profane::PerfCounter counter) const noexcept { return workItemCounts[static_cast<uint8_t>(counter)] > 0; }
+
+        double perCall(profane::PerfCounter counter) const noexcept
+        {
+            const auto counterIdx = static_cast<uint8_t>(counter);
+            return static_cast<double>(sums[counterIdx]) / static_cast<double>(std::max(workItemCounts[counterIdx], uint64_t{1}));
+        }
+
+        // Instructions per cycle, 0 if either is not counted. Both are counted together, as a single group.
+        double instructionsPerCycle() const noexcept
+        {
+            const auto cycles = sums[static_cast<uint8_t>(profane::PerfCounter::Cycles)];
+            return (cycles > 0) ? static_cast<double>(sums[static_cast<uint8_t>(profane::PerfCounter::Instructions)]) / static_cast<double>(cycles) : 0.0;
+        }
+    };
+
+    // Sums of the heap allocations over the work items of a routine, which counted them.
+    // Allocations of a work item include those of the nested ones. Its self allocations do not.
+    struct RoutineAllocations
+    {
+        uint64_t workItemCount = 0;
+        uint64_t allocationCount = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t selfAllocatedBytes = 0;
+
+        double bytesPerCall() const noexcept { return static_cast<double>(allocatedBytes) / static_cast<double>(std::max(workItemCount, uint64_t{1})); }
+        double selfBytesPerCall() const noexcept { return static_cast<double>(selfAllocatedBytes) / static_cast<double>(std::max(workItemCount, uint64_t{1})); }
+        double allocationsPerCall() const noexcept { return static_cast<double>(allocationCount) / static_cast<double>(std::max(workItemCount, uint64_t{1})); }
+    };
+
+    // Sums of the CPU time of the thread over the work items of a routine, which measured it (see profane::ThreadCpuTimeTraits).
+    // The rest of their durations has been spent off the CPU, i.e. blocked or preempted.
+    struct RoutineCpuTime
+    {
+        uint64_t workItemCount = 0;
+        uint64_t durationNs = 0;
+        uint64_t cpuTimeNs = 0;
+
+        uint64_t offCpuNs() const noexcept { return durationNs - cpuTimeNs; }
+        double offCpuNsPerCall() const noexcept { return static_cast<double>(offCpuNs()) / static_cast<double>(std::max(workItemCount, uint64_t{1})); }
+        double onCpuRatio() const noexcept { return (durationNs > 0) ? static_cast<double>(cpuTimeNs) / static_cast<double>(durationNs) : 1.0; }
+    };
+
+    // A stack of the worker's thread sampled by the tracer (see profane::PerfLogger::StackSamplingInterval).
+    struct StackSample
+    {
+        uint64_t timeNs;
+        uint32_t framesIdx;                 // Index of the leaf frame of the sample in Workload::stackFrames, followed by the frames of its callers.
+        uint8_t frameCount;
+    };
+
     struct Worker
     {
         const char* name;
         std::vector<WorkItem> workItems;
         uint8_t stackLevels;
+        std::vector<StackSample> stackSamples;  // Ordered by time.
+        std::vector<uint32_t> sourceWorkItemIdxs;   // Of a CPU lane: index of every work item among those of its worker (given by its workerName).
     };
 
     using WorkerMap = std::map<const char*, Worker, CStrLess>;
 
     std::vector<std::string> dictionary;
     WorkerMap workers;
-    int64_t startTimeNs;
+
+    // Copies of the work items with their CPUs recorded, as lanes of the CPUs they have started on (e.g. "CPU 3"), i.e. the per-core view of the workers.
+    // Work items of different threads overlapping within a lane have competed for the CPU. Copies are ordered and stacked like those of a worker.
+    WorkerMap cpuLanes;
+    std::deque<std::string> cpuLaneNames;
+    int64_t startTimeNs = 0;
+
+    std::vector<SpanArg> spanArgs;
+    std::vector<PerfCounters> perfCounters;
+    std::vector<const char*> stackFrames;   // Function names of the frames of all the stack samples.
 
     std::map<const char*, std::vector<WorkItem*>> routineToWorkItemHistogramMap;
+
+    // Least squares fit of the durations of the work items of a routine to the values of one of their arguments, e.g. ns per byte.
+    struct ArgCorrelation
+    {
+        const char* argName;
+        size_t sampleCount = 0;
+        double nsPerUnit = 0.0;             // Slope of the fitted line.
+        double fixedNs = 0.0;               // Intercept of the fitted line, i.e. the estimated duration for the argument value of 0.
+        double correlation = 0.0;           // Pearson correlation coefficient of the durations and the values, from -1 to 1.
+    };
+
+    std::map<const char*, std::vector<ArgCorrelation>> routineArgCorrelations;
+    std::map<const char*, RoutinePerfCounters> routinePerfCounters;
+    std::map<const char*, RoutineAllocations> routineAllocations;
+    std::map<const char*, RoutineCpuTime> routineCpuTimes;
+    std::vector<const char*> routinesByAllocatedBytes;  // Routines with counted allocations, the most self bytes allocated per call first.
+
+    // Work items of a task, possibly handed over between many workers, ordered by their start time.
+    struct Task
+    {
+        uint32_t taskId;
+        std::vector<WorkItem*> workItems;
+        uint64_t latencyNs = 0;             // From the start of the first work item to the stop of the last one.
+        uint64_t queueingNs = 0;            // Part of the latency not covered by any work item but asynchronous spans, i.e. spent waiting between stages.
+    };
+
+    std::map<uint32_t, Task> tasks;
+    std::vector<uint64_t> taskLatenciesNs;  // Latencies of all the tasks in ascending order.
+
+    // Contention of a lock traced by profane::TracedMutex, i.e. of the worker of the waits for it (see profane::WorkItemFlags::LockWait).
+    struct LockContention
+    {
+        const char* lockName;
+        uint64_t waitCount = 0;
+        uint64_t waitNs = 0;
+        uint64_t p99WaitNs = 0;
+        uint64_t holdCount = 0;                                     // 0 unless the holds of the lock are traced.
+        uint64_t holdNs = 0;
+        std::vector<std::pair<const char*, uint64_t>> topWaiters;  // Wait routines (i.e. the waiting threads) with their total wait, the longest first.
+    };
+
+    std::vector<LockContention> lockContentions;    // The longest total wait first.
+
+    // Durations of the calls of a routine aggregated by the tracer instead of its work items (see profane::RecordingMode::Aggregate).
+    // Percentiles are estimated from the duration buckets, which are up to a quarter of their lower bound wide.
+    struct RoutineAggregate
+    {
+        const char* workerName;
+        const char* routineName;
+        uint64_t callCount = 0;
+        uint64_t totalNs = 0;
+        uint64_t minNs = 0;
+        uint64_t maxNs = 0;
+        uint64_t p50Ns = 0;
+        uint64_t p90Ns = 0;
+        uint64_t p99Ns = 0;
+        uint64_t p999Ns = 0;
+
+        double meanNs() const noexcept { return static_cast<double>(totalNs) / static_cast<double>(std::max(callCount, uint64_t{1})); }
+    };
+
+    std::vector<RoutineAggregate> routineAggregates;    // The longest total duration first.
+    uint64_t unaggregatedSpanCount = 0;                 // Spans the tracer has failed to aggregate, e.g. of no routine identifier.
+
+    // Calls of a routine missing from its work items.
+    struct RoutineStats
+    {
+        double samplingScale = 1.0;         // Ratio of all the calls to the traced calls, by which the counts and sums of a sampled routine are scaled up.
+        uint64_t droppedCount = 0;          // Number of traced calls dropped for being shorter than minSpanDurationNs.
+        uint64_t droppedDurationNs = 0;
+    };
+
+    // Samples of a counter ordered by time, along with the minima and maxima of their aligned blocks, so that any range of samples is summarized in logarithmic time.
+    struct Counter
+    {
+        const char* name;
+        std::vector<uint64_t> timesNs;
+        std::vector<int64_t> values;
+        std::vector<std::vector<std::pair<int64_t, int64_t>>> minMaxLevels;     // Level k holds the (min, max) of the blocks of 2^(k+1) samples.
+        int64_t minValue = 0;
+        int64_t maxValue = 0;
+
+        std::pair<int64_t, int64_t> MinMax(size_t beginIdx, size_t endIdx) const;
+    };
+
+    struct CounterGroup
+    {
+        const char* name;
+        std::map<const char*, Counter, CStrLess> counters;
+    };
+
+    using CounterGroupMap = std::map<const char*, CounterGroup, CStrLess>;
+
+    CounterGroupMap counterGroups;
+
+    std::map<const char*, RoutineStats> routineStats;
+    uint64_t minSpanDurationNs = 0;
+    uint64_t spanOverheadNs = 0;            // Duration added by the tracer to the parent of every work item.
+    bool tracerOverheadCompensated = false;
+    uint64_t droppedEventCount = 0;         // Events lost by the tracer for want of room in its event pool.
+
+    RoutineStats routineStatsOf(const char* routineName) const
+    {
+        auto found = routineStats.find(routineName);
+        return (found != std::end(routineStats)) ? found->second : RoutineStats{};
+    }
+
+    const RoutinePerfCounters* routinePerfCountersOf(const char* routineName) const
+    {
+        auto found = routinePerfCounters.find(routineName);
+        return (found != std::end(routinePerfCounters)) ? &found->second : nullptr;
+    }
+
+    const RoutineAllocations* routineAllocationsOf(const char* routineName) const
+    {
+        auto found = routineAllocations.find(routineName);
+        return (found != std::end(routineAllocations)) ? &found->second : nullptr;
+    }
+
+    const LockContention* lockContentionOf(const char* workerName) const
+    {
+        auto found = std::find_if(std::begin(lockContentions), std::end(lockContentions), [&](const LockContention& lc) { return std::strcmp(lc.lockName, workerName) == 0; });
+        return (found != std::end(lockContentions)) ? &*found : nullptr;
+    }
+
+    const RoutineCpuTime* routineCpuTimeOf(const char* routineName) const
+    {
+        auto found = routineCpuTimes.find(routineName);
+        return (found != std::end(routineCpuTimes)) ? &found->second : nullptr;
+    }
+
+    const PerfCounters* perfCountersOf(const WorkItem& workItem) const
+    {
+        return (workItem.perfCountersIdx != NoPerfCounters) ? &perfCounters[workItem.perfCountersIdx] : nullptr;
+    }
+
+    const ArgCorrelation* argCorrelationOf(const char* routineName, const char* argName) const
+    {
+        auto found = routineArgCorrelations.find(routineName);
+        if (found == std::end(routineArgCorrelations))
+            return nullptr;
+
+        for (const auto& argCorrelation : found->second)
+        {
+            if (std::strcmp(argCorrelation.argName, argName) == 0)
+                return &argCorrelation;
+        }
+
+        return nullptr;
+    }
 };
 
-Workload BuildWorkload(profane::bin::FileContent&& fileContent);
+Workload BuildWorkload(profane::bin::FileContent&& fileContent, bool compensateTracerOverhead = false);
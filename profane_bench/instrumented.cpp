@@ -0,0 +1,8 @@
+#include <cstdint>
+
+// Built with -finstrument-functions, so that the cost of the hooks of profane_instrument.cpp can be measured by calling it.
+//
+__attribute__((noinline)) uint64_t InstrumentedCall(uint64_t value)
+{
+    return value * 2654435761u + 1;
+}
@@ -0,0 +1,482 @@
+#include <atomic>
+#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "profane/profane.h"
+#include "workload.h"
+
+#if PROFANE_BENCH_INSTRUMENT
+#include "profane/profane_instrument.h"
+
+uint64_t InstrumentedCall(uint64_t value);
+#endif
+
+using BenchClock = std::chrono::steady_clock;
+
+// Prints the results as aligned tables, or as lines "<table>,<row>,<column>,<value>" which are easy to compare between releases.
+//
+class Report
+{
+    bool m_machineReadable;
+    bool m_empty = true;
+    size_t m_rowHeaderWidth = 0;
+    std::string m_tableName;
+    std::vector<std::string> m_columns;
+
+public:
+    explicit Report(bool machineReadable) :
+        m_machineReadable{machineReadable}
+    {
+    }
+
+    void StartTable(const std::string& tableName, const std::string& rowHeader, std::vector<std::string> columns)
+    {
+        m_tableName = tableName;
+        m_columns = std::move(columns);
+        m_rowHeaderWidth = std::max<size_t>(rowHeader.size(), 13);
+
+        if (m_machineReadable)
+        {
+            if (m_empty)
+                std::cout << "table,row,column,value" << std::endl;
+        }
+        else
+        {
+            if (!m_empty)
+                std::cout << std::endl;
+
+            std::cout << std::left << std::setw(m_rowHeaderWidth) << rowHeader << std::right;
+            for (const auto& column : m_columns)
+                std::cout << "  " << std::setw(std::max<size_t>(column.size(), 8)) << column;
+            std::cout << std::endl;
+        }
+
+        m_empty = false;
+    }
+
+    void AddRow(const std::string& row, const std::vector<double>& values, int precision = 1)
+    {
+        assert(values.size() == m_columns.size());
+
+        if (m_machineReadable)
+        {
+            for (size_t columnIdx = 0; columnIdx < values.size(); ++columnIdx)
+                std::cout << m_tableName << ',' << row << ',' << m_columns[columnIdx] << ',' << std::fixed << std::setprecision(precision + 2) << values[columnIdx] << std::endl;
+        }
+        else
+        {
+            std::cout << std::left << std::setw(m_rowHeaderWidth) << row << std::right;
+            for (size_t columnIdx = 0; columnIdx < values.size(); ++columnIdx)
+                std::cout << "  " << std::setw(std::max<size_t>(m_columns[columnIdx].size(), 8)) << std::fixed << std::setprecision(precision) << values[columnIdx];
+            std::cout << std::endl;
+        }
+    }
+};
+
+// Measures the average cost of a Trace() call followed by the Tracer destruction, while the given number of threads trace at once.
+// The cost is the CPU time available to the threads divided by the number of traces, so it is not inflated when there are more threads than cores.
+// In RecordingMode::Aggregate the traces update the duration histogram of the routine instead of filling the event pool.
+// Returns the cost in nanoseconds.
+//
+template<typename Traits>
+double MeasureTraceCost(unsigned threadCount, uint32_t tracesPerThread, profane::RecordingMode recordingMode = profane::RecordingMode::KeepFirst)
+{
+    static const auto routineId = profane::RegisterRoutine("Bench.Trace");
+
+    profane::PerfLogger<Traits> perfLogger;
+    std::ostringstream out;
+    perfLogger.Enable(out, threadCount * tracesPerThread, recordingMode);
+
+    std::atomic<unsigned> readyThreadCount = {0};
+    std::atomic<bool> started = {false};
+    std::vector<std::thread> threads;
+
+    for (unsigned threadIdx = 0; threadIdx < threadCount; ++threadIdx)
+    {
+        threads.emplace_back([&]() {
+            ++readyThreadCount;
+            while (!started)
+                std::this_thread::yield();
+
+            for (uint32_t traceIdx = 0; traceIdx < tracesPerThread; ++traceIdx)
+            {
+                const auto tracer = perfLogger.Trace(routineId);
+            }
+        });
+    }
+
+    while (readyThreadCount != threadCount)
+        std::this_thread::yield();
+
+    const auto startTime = BenchClock::now();
+    started = true;
+
+    for (auto& thread : threads)
+        thread.join();
+
+    const auto stopTime = BenchClock::now();
+
+    // The events are not needed, so skip writing them out.
+    perfLogger.Disable();
+
+    const auto coreCount = std::min(threadCount, std::max(std::thread::hardware_concurrency(), 1u));
+    const auto elapsedNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stopTime - startTime).count());
+    return elapsedNs * coreCount / (static_cast<double>(threadCount) * tracesPerThread);
+}
+
+// Measures the average cost of a Trace() call of a routine, whose calls are all sampled out by the given sampling mode.
+// Returns the cost in nanoseconds.
+//
+template<typename Traits>
+double MeasureSampledOutCost(profane::SamplingMode samplingMode, double samplingRate, uint32_t traceCount)
+{
+    static const auto routineId = profane::RegisterRoutine("Bench.Sampled");
+
+    profane::PerfLogger<Traits> perfLogger;
+    perfLogger.SamplingRules = { profane::SamplingRule{"Bench.Sampled", samplingMode, samplingRate} };
+    std::ostringstream out;
+    perfLogger.Enable(out, 1);
+
+    const auto startTime = BenchClock::now();
+
+    for (uint32_t traceIdx = 0; traceIdx < traceCount; ++traceIdx)
+    {
+        const auto tracer = perfLogger.Trace(routineId);
+    }
+
+    const auto stopTime = BenchClock::now();
+
+    perfLogger.Disable();
+
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stopTime - startTime).count()) / traceCount;
+}
+
+// Measures the average cost of a TraceCategory() call of a category, which is compiled in, but not enabled.
+// Returns the cost in nanoseconds.
+//
+template<typename Traits>
+double MeasureDisabledCategoryCost(uint32_t traceCount)
+{
+    constexpr profane::CategoryId category = 7;
+    static const auto routineId = profane::RegisterRoutine("Bench.Disabled");
+
+    profane::PerfLogger<Traits> perfLogger;
+    std::ostringstream out;
+    perfLogger.Enable(out, 1);
+
+    const auto enabledCategories = profane::EnabledCategories();
+    profane::SetEnabledCategories(~(profane::CategoryMask{1} << category));
+
+    const auto startTime = BenchClock::now();
+
+    for (uint32_t traceIdx = 0; traceIdx < traceCount; ++traceIdx)
+    {
+        const auto tracer = perfLogger.template TraceCategory<category>(routineId);
+    }
+
+    const auto stopTime = BenchClock::now();
+
+    profane::SetEnabledCategories(enabledCategories);
+    perfLogger.Disable();
+
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stopTime - startTime).count()) / traceCount;
+}
+
+#if PROFANE_BENCH_INSTRUMENT
+// Measures the average cost of a call of a function instrumented with -finstrument-functions, which is either recorded or too short to be.
+// Returns the cost in nanoseconds, including the call itself.
+//
+double MeasureInstrumentedCallCost(std::chrono::nanoseconds minDuration, uint32_t callCount)
+{
+    profane::instrument::SetMinDuration(minDuration);
+
+    auto& perfLogger = profane::instrument::Logger();
+    std::ostringstream out;
+    perfLogger.Enable(out, callCount);
+
+    uint64_t value = 0;
+    const auto startTime = BenchClock::now();
+
+    for (uint32_t callIdx = 0; callIdx < callCount; ++callIdx)
+        value = InstrumentedCall(value);
+
+    const auto stopTime = BenchClock::now();
+
+    perfLogger.Disable();
+
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stopTime - startTime).count()) / callCount;
+}
+#endif
+
+// Measures the average cost of an uncontended lock and unlock of a std::mutex, or of a TracedMutex recording its holds or not.
+// Returns the cost in nanoseconds.
+//
+template<typename Mutex, typename Traits>
+double MeasureUncontendedLockCost(Mutex& mutex, profane::PerfLogger<Traits>& perfLogger, uint32_t lockCount)
+{
+    std::ostringstream out;
+    perfLogger.Enable(out, lockCount);
+
+    const auto startTime = BenchClock::now();
+
+    for (uint32_t lockIdx = 0; lockIdx < lockCount; ++lockIdx)
+    {
+        std::lock_guard<Mutex> lock{mutex};
+    }
+
+    const auto stopTime = BenchClock::now();
+
+    perfLogger.Disable();
+
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stopTime - startTime).count()) / lockCount;
+}
+
+// Throughput of writing and reading back the work items of a performance log.
+//
+struct FormatThroughput
+{
+    double writeItemsPerS;
+    double writeBytesPerS;
+    double readBytesPerS;
+};
+
+// Measures the throughput of BinaryWriter::WriteWorkItem() when the routine names are drawn from a dictionary of the given cardinality,
+// and then the throughput of bin::Read() of the written performance log.
+// Every name is indexed at least once, so the cost of growing the dictionary is included.
+//
+FormatThroughput MeasureFormatThroughput(uint32_t cardinality, uint32_t itemCount)
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::string> routineNames;
+    routineNames.reserve(cardinality);
+    for (uint32_t nameIdx = 0; nameIdx < cardinality; ++nameIdx)
+        routineNames.push_back("R" + std::to_string(nameIdx));
+
+    itemCount = std::max(itemCount, cardinality);
+
+    std::ostringstream out;
+    profane::bin::BinaryWriter writer{out, "profane_bench", "WriteWorkItem"};
+
+    const auto baseTime = Clock::now();
+    const auto writeStartTime = BenchClock::now();
+
+    for (uint32_t itemIdx = 0; itemIdx < itemCount; ++itemIdx)
+    {
+        const auto itemTime = baseTime + std::chrono::nanoseconds{itemIdx};
+        profane::WorkItemProto<Clock> workItemProto {};
+        workItemProto.startTime = itemTime;
+        workItemProto.stopTime = itemTime;
+        workItemProto.categoryName = "Bench";
+        workItemProto.workerName = "Worker";
+        workItemProto.routineName = routineNames[itemIdx % cardinality];
+        writer.WriteWorkItem(std::move(workItemProto));
+    }
+
+    writer.Finish();
+
+    const auto writeStopTime = BenchClock::now();
+
+    std::istringstream in{out.str()};
+    const auto byteCount = static_cast<double>(in.str().size());
+
+    const auto readStartTime = BenchClock::now();
+    const auto fileContent = profane::bin::Read(in);
+    const auto readStopTime = BenchClock::now();
+
+    if (fileContent.workItems.size() != itemCount)
+        throw std::runtime_error("Read " + std::to_string(fileContent.workItems.size()) + " work items out of " + std::to_string(itemCount) + " written");
+
+    const auto writeElapsedS = std::chrono::duration_cast<std::chrono::duration<double>>(writeStopTime - writeStartTime).count();
+    const auto readElapsedS = std::chrono::duration_cast<std::chrono::duration<double>>(readStopTime - readStartTime).count();
+    return FormatThroughput{itemCount / writeElapsedS, byteCount / writeElapsedS, byteCount / readElapsedS};
+}
+
+// Measures the throughput of PerfLogger::Finish(), i.e. ordering the events of a few threads and writing them out.
+// Returns the number of events finished per second.
+//
+template<typename Traits>
+double MeasureFinishThroughput(uint32_t eventCount)
+{
+    static const auto routineId = profane::RegisterRoutine("Bench.Finish");
+    constexpr unsigned ThreadCount = 4;
+
+    profane::PerfLogger<Traits> perfLogger;
+    std::ostringstream out;
+    perfLogger.Enable(out, eventCount);
+
+    std::vector<std::thread> threads;
+
+    for (unsigned threadIdx = 0; threadIdx < ThreadCount; ++threadIdx)
+    {
+        threads.emplace_back([&]() {
+            for (uint32_t traceIdx = 0; traceIdx < eventCount / ThreadCount; ++traceIdx)
+            {
+                const auto tracer = perfLogger.Trace(routineId);
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    const auto startTime = BenchClock::now();
+    perfLogger.Finish();
+    const auto stopTime = BenchClock::now();
+
+    const auto elapsedS = std::chrono::duration_cast<std::chrono::duration<double>>(stopTime - startTime).count();
+    return (eventCount / ThreadCount * ThreadCount) / elapsedS;
+}
+
+// Writes a performance log of the given number of work items, spread over a few workers.
+// Every fourth work item encloses the next three, so that the stack levels are exercised.
+//
+std::string WriteSyntheticLog(uint32_t itemCount)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr uint32_t WorkerCount = 8;
+    constexpr uint32_t RoutineCount = 100;
+
+    std::ostringstream out;
+    profane::bin::BinaryWriter writer{out, "profane_bench", "BuildWorkload"};
+
+    const auto baseTime = Clock::now();
+
+    for (uint32_t itemIdx = 0; itemIdx < itemCount; ++itemIdx)
+    {
+        const uint32_t workerIdx = itemIdx % WorkerCount;
+        const uint32_t workerItemIdx = itemIdx / WorkerCount;
+        const auto groupTime = baseTime + std::chrono::nanoseconds{workerItemIdx / 4 * 400};
+        const uint32_t childIdx = workerItemIdx % 4;
+
+        const auto startTime = (childIdx == 0) ? groupTime : groupTime + std::chrono::nanoseconds{10 + (childIdx - 1) * 120 + itemIdx % 7};
+        const auto stopTime = (childIdx == 0) ? groupTime + std::chrono::nanoseconds{390} : startTime + std::chrono::nanoseconds{100};
+
+        profane::WorkItemProto<Clock> workItemProto {};
+        workItemProto.startTime = startTime;
+        workItemProto.stopTime = stopTime;
+        workItemProto.categoryName = "Bench";
+        workItemProto.workerName = "Worker" + std::to_string(workerIdx);
+        workItemProto.routineName = "R" + std::to_string(itemIdx % RoutineCount);
+        writer.WriteWorkItem(std::move(workItemProto));
+    }
+
+    writer.Finish();
+    return out.str();
+}
+
+// Measures the time of building the workload of the analyser from a performance log of the given number of work items.
+// Returns the time in seconds.
+//
+double MeasureBuildWorkloadTime(uint32_t itemCount)
+{
+    std::istringstream in{WriteSyntheticLog(itemCount)};
+    auto fileContent = profane::bin::Read(in);
+
+    const auto startTime = BenchClock::now();
+    const auto workload = BuildWorkload(std::move(fileContent));
+    const auto stopTime = BenchClock::now();
+
+    return std::chrono::duration_cast<std::chrono::duration<double>>(stopTime - startTime).count();
+}
+
+int main(int argc, char* args[])
+{
+    try
+    {
+        uint32_t tracesPerThread = 100000;
+        uint32_t workItemCount = 2000000;
+        uint32_t maxEventCount = 1000000;
+        unsigned maxThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+        bool machineReadable = false;
+
+        for (int idx = 1; idx < argc; ++idx)
+        {
+            if (std::strcmp("-n", args[idx]) == 0 && idx + 1 < argc)
+                tracesPerThread = static_cast<uint32_t>(std::stoul(args[++idx]));
+            else if (std::strcmp("-t", args[idx]) == 0 && idx + 1 < argc)
+                maxThreadCount = static_cast<unsigned>(std::stoul(args[++idx]));
+            else if (std::strcmp("-w", args[idx]) == 0 && idx + 1 < argc)
+                workItemCount = static_cast<uint32_t>(std::stoul(args[++idx]));
+            else if (std::strcmp("-e", args[idx]) == 0 && idx + 1 < argc)
+                maxEventCount = static_cast<uint32_t>(std::stoul(args[++idx]));
+            else if (std::strcmp("-m", args[idx]) == 0)
+                machineReadable = true;
+            else
+                throw std::runtime_error("Unknown argument '" + std::string{args[idx]} + "' (usage: profane_bench [-n <traces per thread>] [-t <max thread count>] [-w <work items to write>] [-e <max event count>] [-m])");
+        }
+
+        Report report{machineReadable};
+
+        report.StartTable("trace", "threads", {"ns/trace", "ns/trace(tsc)", "ns/trace(cpu)", "ns/trace(agg)"});
+
+        for (unsigned threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2)
+        {
+            const auto costNs = MeasureTraceCost<profane::ActorBasedTraits>(threadCount, tracesPerThread);
+            const auto tscCostNs = MeasureTraceCost<profane::TscActorBasedTraits>(threadCount, tracesPerThread);
+            const auto cpuTimeCostNs = MeasureTraceCost<profane::ThreadCpuTimeActorBasedTraits>(threadCount, tracesPerThread);
+            const auto aggregateCostNs = MeasureTraceCost<profane::ActorBasedTraits>(threadCount, tracesPerThread, profane::RecordingMode::Aggregate);
+            report.AddRow(std::to_string(threadCount), {costNs, tscCostNs, cpuTimeCostNs, aggregateCostNs});
+        }
+
+        report.StartTable("sampled-out", "sampling", {"ns/trace"});
+        report.AddRow("every-nth", {MeasureSampledOutCost<profane::ActorBasedTraits>(profane::SamplingMode::EveryNth, 1e9, tracesPerThread)});
+        report.AddRow("probabilistic", {MeasureSampledOutCost<profane::ActorBasedTraits>(profane::SamplingMode::Probabilistic, 0.0, tracesPerThread)});
+        report.AddRow("disabled-cat", {MeasureDisabledCategoryCost<profane::ActorBasedTraits>(100 * tracesPerThread)}, 2);
+
+#if PROFANE_BENCH_INSTRUMENT
+        report.StartTable("instrument", "call", {"ns/call"});
+        report.AddRow("recorded", {MeasureInstrumentedCallCost(std::chrono::nanoseconds{0}, tracesPerThread)});
+        report.AddRow("too-short", {MeasureInstrumentedCallCost(std::chrono::microseconds{1}, tracesPerThread)});
+#endif
+
+        {
+            profane::PerfLogger<profane::ActorBasedTraits> perfLogger;
+            std::mutex mutex;
+            profane::TracedMutex<> tracedMutex{perfLogger, "Bench"};
+            profane::TracedMutex<> holdTracedMutex{perfLogger, "Bench", true};
+
+            report.StartTable("lock", "mutex", {"ns/lock"});
+            report.AddRow("std::mutex", {MeasureUncontendedLockCost(mutex, perfLogger, tracesPerThread)});
+            report.AddRow("TracedMutex", {MeasureUncontendedLockCost(tracedMutex, perfLogger, tracesPerThread)});
+            report.AddRow("TracedMutex(holds)", {MeasureUncontendedLockCost(holdTracedMutex, perfLogger, tracesPerThread)});
+        }
+
+        report.StartTable("finish", "events", {"Mevents/s"});
+
+        for (uint32_t eventCount = 10000; eventCount <= maxEventCount; eventCount *= 10)
+            report.AddRow(std::to_string(eventCount), {MeasureFinishThroughput<profane::ActorBasedTraits>(eventCount) / 1e6}, 2);
+
+        report.StartTable("format", "names", {"Mitems/s(write)", "MB/s(write)", "MB/s(read)"});
+
+        for (uint32_t cardinality = 10; cardinality <= 1000000; cardinality *= 10)
+        {
+            const auto throughput = MeasureFormatThroughput(cardinality, workItemCount);
+            report.AddRow(std::to_string(cardinality), {throughput.writeItemsPerS / 1e6, throughput.writeBytesPerS / 1e6, throughput.readBytesPerS / 1e6}, 2);
+        }
+
+        report.StartTable("workload", "events", {"ms(build)", "ns/event"});
+
+        for (uint32_t eventCount = 10000; eventCount <= maxEventCount; eventCount *= 10)
+        {
+            const auto buildTimeS = MeasureBuildWorkloadTime(eventCount);
+            report.AddRow(std::to_string(eventCount), {buildTimeS * 1e3, buildTimeS * 1e9 / eventCount});
+        }
+
+        return 0;
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << "error: " << ex.what() << std::endl;
+        return -1;
+    }
+}
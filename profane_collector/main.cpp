@@ -0,0 +1,99 @@
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "profane/profane.h"
+
+#if !PROFANE_HAS_MMAP
+#error profane_collector needs POSIX shared memory.
+#endif
+
+namespace
+{
+    volatile std::sig_atomic_t g_stopRequested = 0;
+
+    void OnStopSignal(int)
+    {
+        g_stopRequested = 1;
+    }
+}
+
+// Creates the shared memory segment, to which the processes traced by PerfLogger::EnableSharedMemory() publish their work items,
+// and merges them into a single performance log file until interrupted (or for the given duration).
+//
+int main(int argc, char* args[])
+{
+    try
+    {
+        std::string segmentName = "/profane";
+        uint32_t regionCount = 16;
+        uint64_t regionSizeKiB = 4 * 1024;
+        double durationS = 0.0;
+        const char* outFileName = nullptr;
+
+        for (int idx = 1; idx < argc; ++idx)
+        {
+            if (std::strcmp("-n", args[idx]) == 0 && idx + 1 < argc)
+                segmentName = args[++idx];
+            else if (std::strcmp("-p", args[idx]) == 0 && idx + 1 < argc)
+                regionCount = static_cast<uint32_t>(std::stoul(args[++idx]));
+            else if (std::strcmp("-s", args[idx]) == 0 && idx + 1 < argc)
+                regionSizeKiB = std::stoull(args[++idx]);
+            else if (std::strcmp("-d", args[idx]) == 0 && idx + 1 < argc)
+                durationS = std::stod(args[++idx]);
+            else if (args[idx][0] != '-' && outFileName == nullptr)
+                outFileName = args[idx];
+            else
+                throw std::runtime_error("Unknown argument '" + std::string{args[idx]} + "'");
+        }
+
+        if (outFileName == nullptr)
+            throw std::runtime_error("usage: profane_collector [-n <segment name>] [-p <max process count>] [-s <region size in KiB>] [-d <duration in seconds>] <output file>");
+
+        std::ofstream outFile{outFileName, std::ofstream::binary};
+        if (!outFile.is_open())
+            throw std::runtime_error("Cannot open output file '" + std::string{outFileName} + "' for writing");
+
+        profane::shm::Collector collector{segmentName, regionCount, regionSizeKiB * 1024};
+        profane::bin::BinaryWriter writer{outFile, "profane_collector", "Merged from shared memory segment " + segmentName};
+
+        std::signal(SIGINT, OnStopSignal);
+        std::signal(SIGTERM, OnStopSignal);
+
+        std::cerr << "Collecting from shared memory segment " << segmentName << " (" << regionCount << " processes at most), interrupt to stop." << std::endl;
+
+        const auto startTime = std::chrono::steady_clock::now();
+        size_t recordCount = 0;
+
+        while (g_stopRequested == 0)
+        {
+            if (durationS > 0.0 && std::chrono::steady_clock::now() - startTime >= std::chrono::duration<double>{durationS})
+                break;
+
+            const auto drainedCount = collector.Drain(writer);
+            recordCount += drainedCount;
+
+            if (drainedCount == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        }
+
+        recordCount += collector.Drain(writer);
+        writer.Finish();
+
+        std::cerr << "Collected " << recordCount << " records to " << outFileName << std::endl;
+
+        if (collector.DroppedRecordCount() > 0)
+            std::cerr << "warning: " << collector.DroppedRecordCount() << " records have been dropped by the processes, as their regions have been full" << std::endl;
+        return 0;
+    }
+    catch (std::exception& ex)
+    {
+        std::cerr << "error: " << ex.what() << std::endl;
+        return -1;
+    }
+}
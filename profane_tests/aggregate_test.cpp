@@ -0,0 +1,116 @@
+// Checks that RecordingMode::Aggregate keeps counting the spans of all kinds, however many more of them are traced than the event pool holds.
+
+#include <profane/profane.h>
+
+#include <sstream>
+
+namespace
+{
+    int failureCount = 0;
+
+    void Check(bool condition, const char* description)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << description << std::endl;
+            ++failureCount;
+        }
+    }
+
+    const profane::bin::RoutineAggregate* FindAggregate(const profane::bin::FileContent& content, const char* routineName)
+    {
+        for (const auto& aggregate : content.routineAggregates)
+        {
+            if (content.dictionary[aggregate.routineNameIdx] == routineName)
+                return &aggregate;
+        }
+
+        return nullptr;
+    }
+
+    uint64_t BucketSum(const profane::bin::RoutineAggregate& aggregate)
+    {
+        uint64_t callCount = 0;
+        for (const auto bucketCount : aggregate.bucketCounts)
+            callCount += bucketCount;
+        return callCount;
+    }
+}
+
+int main()
+{
+    using Logger = profane::PerfLogger<profane::ActorBasedTraits>;
+
+    constexpr uint32_t ThreadCount = 4;
+    constexpr uint32_t SpansPerThread = 20000;
+
+    std::ostringstream out;
+    Logger logger;
+    logger.Enable(out, 1, profane::RecordingMode::Aggregate);
+
+    const auto outerId = profane::RegisterRoutine("Test.Outer");
+    const auto innerId = profane::RegisterRoutine("Test.Inner");
+    const auto spanId = profane::RegisterRoutine("Test.Span");
+    const auto asyncId = profane::RegisterRoutine("Test.Async");
+    const auto holdId = profane::RegisterRoutine("Lock.Lock hold");
+
+    profane::TracedMutex<profane::ActorBasedTraits> mutex{logger, "Lock", true};
+
+    std::vector<std::thread> threads;
+
+    for (uint32_t threadIdx = 0; threadIdx < ThreadCount; ++threadIdx)
+    {
+        threads.emplace_back([&]() {
+            for (uint32_t spanIdx = 0; spanIdx < SpansPerThread; ++spanIdx)
+            {
+                auto outer = logger.Trace(outerId);
+                auto inner = logger.Trace(innerId);
+
+                // Stopped out of order.
+                outer.Stop();
+                inner.Stop();
+
+                const auto now = profane::ActorBasedTraits::Clock::now();
+                logger.TraceSpan(now, now, profane::ActorBasedTraits::EventData{spanId});
+
+                auto asyncSpan = logger.TraceAsync(asyncId);
+                asyncSpan.End();
+
+                std::lock_guard<decltype(mutex)> lock{mutex};
+            }
+
+            // Of no routine identifier.
+            logger.Trace(profane::RoutineId{0});
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    // Stopped by another thread.
+    auto movedTracer = logger.Trace(outerId);
+    std::thread{[&]() { auto tracer = std::move(movedTracer); }}.join();
+
+    logger.Finish();
+
+    std::istringstream in{out.str()};
+    const auto content = profane::bin::Read(in);
+
+    const uint64_t expectedCount = ThreadCount * SpansPerThread;
+
+    Check(content.workItems.empty(), "no work items are written");
+
+    for (const auto routineName : {"Outer", "Inner", "Span", "Async"})
+    {
+        const auto* const aggregate = FindAggregate(content, routineName);
+        Check(aggregate != nullptr && aggregate->callCount == expectedCount, "every span of the routine is aggregated");
+        Check(aggregate != nullptr && BucketSum(*aggregate) == expectedCount, "the buckets of the routine sum up to its call count");
+    }
+
+    const auto* const hold = FindAggregate(content, "Lock hold");
+    Check(hold != nullptr && hold->callCount == expectedCount && holdId != 0, "every lock hold is aggregated");
+
+    Check(content.unaggregatedSpanCount == ThreadCount + 1, "the spans of no routine identifier and the moved one are counted as unaggregated");
+
+    return (failureCount == 0) ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+// Checks that RecordingMode::FlightRecorder keeps the latest events of every thread in order, once they have wrapped around the event pool many times,
+// and that a span stopped after its event has been overwritten does not corrupt the newer event.
+
+#include <profane/profane.h>
+
+#include <sstream>
+
+namespace
+{
+    int failureCount = 0;
+
+    void Check(bool condition, const char* description)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << description << std::endl;
+            ++failureCount;
+        }
+    }
+}
+
+int main()
+{
+    using Logger = profane::PerfLogger<profane::ActorBasedTraits>;
+
+    constexpr uint32_t ThreadCount = 2;
+    constexpr uint32_t SpansPerThread = 20000;
+    constexpr uint32_t EventCount = 1024;
+    constexpr uint32_t EventsPerChunk = 64;
+    constexpr int64_t ThreadStride = 1000000;
+
+    std::ostringstream out;
+    Logger logger;
+    logger.EventsPerChunk = EventsPerChunk;
+    logger.Enable(out, EventCount, profane::RecordingMode::FlightRecorder);
+
+    const auto spanId = profane::RegisterRoutine("Test.Span");
+    const auto longId = profane::RegisterRoutine("Test.Long");
+    const auto seqId = profane::RegisterRoutine("Test.seq");
+
+    std::vector<std::thread> threads;
+
+    for (uint32_t threadIdx = 0; threadIdx < ThreadCount; ++threadIdx)
+    {
+        threads.emplace_back([&, threadIdx]() {
+            // Open while its event is overwritten.
+            auto longSpan = logger.Trace(longId);
+
+            for (uint32_t spanIdx = 0; spanIdx < SpansPerThread; ++spanIdx)
+            {
+                auto span = logger.Trace(spanId);
+                span.Arg(seqId, threadIdx * ThreadStride + spanIdx);
+            }
+
+            longSpan.Stop();
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    logger.Finish();
+
+    std::istringstream in{out.str()};
+    const auto content = profane::bin::Read(in);
+
+    std::vector<std::vector<int64_t>> threadSeqs(ThreadCount);
+    bool spansWhole = true;
+
+    for (const auto& workItem : content.workItems)
+    {
+        if (workItem.stopTimeNs < workItem.startTimeNs)
+            spansWhole = false;
+
+        if (content.dictionary[workItem.routineNameIdx] != "Span")
+            continue;
+
+        if (workItem.argCount != 1 || content.dictionary[content.spanArgs[workItem.argsIdx].nameIdx] != "seq")
+        {
+            spansWhole = false;
+            continue;
+        }
+
+        const auto seq = content.spanArgs[workItem.argsIdx].value;
+        threadSeqs[static_cast<size_t>(seq / ThreadStride)].push_back(seq % ThreadStride);
+    }
+
+    Check(spansWhole, "every span keeps its argument and ends after it starts");
+    Check(content.workItems.size() <= EventCount, "no more events are kept than the pool holds");
+
+    size_t keptCount = 0;
+    for (const auto& seqs : threadSeqs)
+    {
+        // A thread, which has found all the chunks claimed by the others, keeps no events.
+        if (seqs.empty())
+            continue;
+
+        keptCount += seqs.size();
+
+        bool consecutive = seqs.back() == SpansPerThread - 1;
+        for (size_t seqIdx = 1; seqIdx < seqs.size(); ++seqIdx)
+            consecutive = consecutive && seqs[seqIdx] == seqs[seqIdx - 1] + 1;
+
+        Check(consecutive, "the spans of a thread are the latest ones in order");
+    }
+
+    // Every thread may have its current chunk filled partially.
+    Check(keptCount + 2 * ThreadCount + ThreadCount * EventsPerChunk >= EventCount, "the pool is kept full of the latest events");
+
+    return (failureCount == 0) ? 0 : 1;
+}
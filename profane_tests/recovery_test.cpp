@@ -0,0 +1,126 @@
+// Checks that RecoverEventBuffer() rebuilds the performance log from the event buffer file of a process stopped in the middle of its tracing,
+// i.e. with events not stopped yet and the slots of its current chunk not written yet.
+
+#include <profane/profane.h>
+
+#include <sstream>
+
+namespace
+{
+    int failureCount = 0;
+
+    void Check(bool condition, const char* description)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << description << std::endl;
+            ++failureCount;
+        }
+    }
+
+    std::string ReadFile(const char* path)
+    {
+        std::ifstream in{path, std::ifstream::binary};
+        return std::string{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    }
+
+    void WriteFile(const char* path, const std::string& data)
+    {
+        std::ofstream out{path, std::ofstream::binary};
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+}
+
+int main()
+{
+#if PROFANE_HAS_MMAP
+    using Logger = profane::PerfLogger<profane::ActorBasedTraits>;
+
+    constexpr uint32_t SpanCount = 100;
+    const char* const eventBufferFilePath = "recovery_test.events";
+    const char* const crashedFilePath = "recovery_test.crashed";
+    const char* const truncatedFilePath = "recovery_test.truncated";
+
+    std::ostringstream out;
+    Logger logger;
+    logger.ProgramName = "recovery_test";
+    logger.EventsPerChunk = 64;
+    logger.EventBufferFilePath = eventBufferFilePath;
+    logger.Enable(out, 1024);
+
+    const auto spanId = profane::RegisterRoutine("Test.Span");
+    const auto openId = profane::RegisterRoutine("Test.Open");
+    const auto seqId = profane::RegisterRoutine("Test.seq");
+
+    auto openSpan = logger.Trace(openId);
+
+    for (uint32_t spanIdx = 0; spanIdx < SpanCount; ++spanIdx)
+    {
+        auto span = logger.Trace(spanId);
+        span.Arg(seqId, spanIdx);
+    }
+
+    // The file as the process would have left it, had it crashed now.
+    const std::string eventBuffer = ReadFile(eventBufferFilePath);
+    WriteFile(crashedFilePath, eventBuffer);
+    const auto eventsPos = reinterpret_cast<const profane::bin::EventBufferHeader*>(eventBuffer.data())->eventsPos;
+    WriteFile(truncatedFilePath, eventBuffer.substr(0, static_cast<size_t>(eventsPos) + 16));
+
+    openSpan.Stop();
+    logger.Disable();
+
+    std::ostringstream recovered;
+    Logger::RecoverEventBuffer(crashedFilePath, recovered);
+
+    std::istringstream in{recovered.str()};
+    const auto content = profane::bin::Read(in);
+
+    Check(content.dictionary[content.programNameIdx] == "recovery_test", "the program name is recovered");
+    Check(content.workItems.size() == SpanCount + 1, "every traced event is recovered, the open one included");
+
+    uint64_t latestStopTimeNs = 0;
+    int64_t nextSeq = 0;
+    bool spansWhole = true;
+    const profane::bin::WorkItem* open = nullptr;
+
+    for (const auto& workItem : content.workItems)
+    {
+        latestStopTimeNs = std::max(latestStopTimeNs, workItem.stopTimeNs);
+
+        if (content.dictionary[workItem.workerNameIdx] != "Test")
+            spansWhole = false;
+
+        if (content.dictionary[workItem.routineNameIdx] == "Open")
+        {
+            open = &workItem;
+            continue;
+        }
+
+        spansWhole = spansWhole && content.dictionary[workItem.routineNameIdx] == "Span" && workItem.argCount == 1
+            && content.dictionary[content.spanArgs[workItem.argsIdx].nameIdx] == "seq" && content.spanArgs[workItem.argsIdx].value == nextSeq++
+            && workItem.stopTimeNs >= workItem.startTimeNs;
+    }
+
+    Check(spansWhole, "the stopped spans are recovered in order with their routine names and arguments");
+    Check(open != nullptr && open->stopTimeNs == latestStopTimeNs && open->startTimeNs <= content.workItems.back().startTimeNs,
+        "the open span is stopped at the latest time stamp");
+
+    bool truncatedRejected = false;
+    try
+    {
+        std::ostringstream truncated;
+        Logger::RecoverEventBuffer(truncatedFilePath, truncated);
+    }
+    catch (const std::runtime_error&)
+    {
+        truncatedRejected = true;
+    }
+
+    Check(truncatedRejected, "a truncated event buffer file is rejected");
+
+    std::remove(crashedFilePath);
+    std::remove(truncatedFilePath);
+#endif
+
+    return (failureCount == 0) ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+// Checks that every column written by bin::BinaryWriter is read back as it has been written: the work items with their arguments, flags and metrics,
+// the counter samples, the stack samples, the routine statistics and aggregates, and the manifest.
+
+#include <profane/profane.h>
+
+#include <random>
+#include <sstream>
+
+namespace
+{
+    using ProtoClock = std::chrono::system_clock;
+
+    int failureCount = 0;
+
+    void Check(bool condition, const char* description)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << description << std::endl;
+            ++failureCount;
+        }
+    }
+
+    ProtoClock::time_point TimePoint(uint64_t timeNs)
+    {
+        return ProtoClock::time_point{std::chrono::duration_cast<ProtoClock::duration>(std::chrono::nanoseconds{timeNs})};
+    }
+
+    // Builds the work item of the index, so that the columns take values of various sizes, and most of the work items have no arguments or metrics.
+    //
+    profane::WorkItemProto<ProtoClock> MakeWorkItem(uint32_t itemIdx, std::mt19937_64& random, profane::RoutineId routineId, const std::vector<profane::RoutineId>& argIds)
+    {
+        profane::WorkItemProto<ProtoClock> workItem {};
+
+        const uint64_t startTimeNs = 1000000000000ull + itemIdx * 1000ull + random() % 500;
+        workItem.startTime = TimePoint(startTimeNs);
+        workItem.stopTime = TimePoint(startTimeNs + random() % (uint64_t{1} << (itemIdx % 40)));
+
+        if (itemIdx % 4 == 0)
+        {
+            workItem.routineId = routineId;
+        }
+        else
+        {
+            workItem.workerName = "Worker " + std::to_string(itemIdx % 5);
+            workItem.routineName = "Routine " + std::to_string(itemIdx % 7);
+        }
+
+        workItem.categoryName = (itemIdx % 3 == 0) ? "Category" : "";
+        workItem.comment = (itemIdx % 11 == 0) ? "Comment " + std::to_string(itemIdx) : "";
+        workItem.taskId = (itemIdx % 4 == 1) ? static_cast<uint32_t>(random()) : 0;
+        workItem.flags = static_cast<uint8_t>(random() % 2 ? profane::WorkItemFlags::Async : 0) | static_cast<uint8_t>(random() % 3 == 0 ? profane::WorkItemFlags::LockHold : 0);
+
+        workItem.args.count = static_cast<uint8_t>(itemIdx % (profane::SpanArgs::Capacity + 1));
+        for (uint8_t argIdx = 0; argIdx < workItem.args.count; ++argIdx)
+        {
+            workItem.args.ids[argIdx] = argIds[argIdx];
+            workItem.args.values[argIdx] = (itemIdx % 17 == 0) ? std::numeric_limits<int64_t>::min() : static_cast<int64_t>(random()) >> (itemIdx % 64);
+        }
+
+        if (itemIdx % 5 == 0)
+        {
+            workItem.flags |= profane::WorkItemFlags::Allocations;
+            workItem.allocationCount = random() % 1000;
+            workItem.allocatedBytes = random() % 1000000;
+        }
+
+        if (itemIdx % 6 == 0)
+        {
+            workItem.flags |= profane::WorkItemFlags::CpuTime;
+            workItem.cpuTimeNs = random() % 1000000000;
+        }
+
+        if (itemIdx % 7 == 0)
+        {
+            workItem.flags |= profane::WorkItemFlags::Scheduling;
+            workItem.startCpu = static_cast<uint16_t>(random() % 64);
+            workItem.stopCpu = static_cast<uint16_t>(random() % 64);
+            workItem.voluntarySwitches = static_cast<uint32_t>(random() % 100);
+            workItem.involuntarySwitches = static_cast<uint32_t>(random() % 100000);
+        }
+
+        if (itemIdx % 13 == 0)
+        {
+            workItem.perfCounterMask = static_cast<uint8_t>(random() % (1 << profane::PerfCounterCount));
+            for (uint8_t counter = 0; counter < profane::PerfCounterCount; ++counter)
+            {
+                if ((workItem.perfCounterMask & (1 << counter)) != 0)
+                    workItem.perfCounters[counter] = random() >> (random() % 64);
+            }
+        }
+
+        return workItem;
+    }
+
+    bool MetricsMatch(const profane::WorkItemProto<ProtoClock>& expected, const profane::bin::WorkItemMetrics& metrics)
+    {
+        return metrics.perfCounterMask == expected.perfCounterMask
+            && std::equal(std::begin(expected.perfCounters), std::end(expected.perfCounters), std::begin(metrics.perfCounters))
+            && metrics.allocationCount == expected.allocationCount
+            && metrics.allocatedBytes == expected.allocatedBytes
+            && metrics.cpuTimeNs == expected.cpuTimeNs
+            && metrics.startCpu == expected.startCpu
+            && metrics.stopCpu == expected.stopCpu
+            && metrics.voluntarySwitches == expected.voluntarySwitches
+            && metrics.involuntarySwitches == expected.involuntarySwitches;
+    }
+
+    void CheckWorkItemsAndSamples()
+    {
+        constexpr uint32_t WorkItemCount = 5000;
+        constexpr uint32_t CounterSampleCount = 300;
+        constexpr uint32_t StackSampleCount = 100;
+
+        const auto routineId = profane::RegisterRoutine("Registered.Routine");
+        const auto counterId = profane::RegisterRoutine("Queue.depth");
+        // Registered routines are identified by the pointers to their names, so the names have to outlive them.
+        static std::deque<std::string> argNames;
+        std::vector<profane::RoutineId> argIds;
+        for (uint8_t argIdx = 0; argIdx < profane::SpanArgs::Capacity; ++argIdx)
+        {
+            argNames.push_back("Arg.arg" + std::to_string(argIdx));
+            argIds.push_back(profane::RegisterRoutine(argNames.back().c_str()));
+        }
+
+        std::mt19937_64 random{42};
+        std::vector<profane::WorkItemProto<ProtoClock>> workItems;
+        std::vector<profane::bin::CounterSample> counterSamples;
+
+        std::ostringstream out;
+        {
+            profane::bin::BinaryWriter writer{out, "round_trip_test", "Every column"};
+            writer.WorkItemsPerSection = 1000;
+            writer.CounterSamplesPerSection = 100;
+            writer.StackSamplesPerSection = 30;
+
+            for (uint32_t itemIdx = 0; itemIdx < WorkItemCount; ++itemIdx)
+            {
+                workItems.push_back(MakeWorkItem(itemIdx, random, routineId, argIds));
+                auto workItem = workItems.back();
+                writer.WriteWorkItem(std::move(workItem));
+            }
+
+            for (uint32_t sampleIdx = 0; sampleIdx < CounterSampleCount; ++sampleIdx)
+            {
+                const profane::bin::CounterSample sample { 2000000000000ull + sampleIdx * 997ull, 0, 0, static_cast<int64_t>(random()) >> (sampleIdx % 64) };
+                counterSamples.push_back(sample);
+                writer.WriteCounterSample(counterId, TimePoint(sample.timeNs), sample.value);
+            }
+
+            std::vector<std::string> frameNames;
+            for (uint32_t frameIdx = 0; frameIdx < profane::bin::StackSampleMaxDepth + 8; ++frameIdx)
+                frameNames.push_back("Frame " + std::to_string(frameIdx));
+            std::vector<profane::StringRef> frameNameRefs(std::begin(frameNames), std::end(frameNames));
+
+            for (uint32_t sampleIdx = 0; sampleIdx < StackSampleCount; ++sampleIdx)
+            {
+                const auto frameCount = static_cast<uint32_t>(1 + sampleIdx % frameNameRefs.size());
+                if (sampleIdx % 2 == 0)
+                    writer.WriteStackSample(TimePoint(3000000000000ull + sampleIdx), routineId, "", frameNameRefs.data(), frameCount);
+                else
+                    writer.WriteStackSample(TimePoint(3000000000000ull + sampleIdx), 0, "Sampled", frameNameRefs.data(), frameCount);
+            }
+
+            writer.AddRoutineStats(routineId, profane::SamplingMode::EveryNth, 10.0, 1000, 100, 7, 12345);
+            writer.SetMinSpanDuration(std::chrono::nanoseconds{250});
+            writer.SetSpanOverhead(std::chrono::nanoseconds{31});
+            writer.SetDroppedEventCount(77);
+            writer.Finish();
+        }
+
+        std::istringstream in{out.str()};
+        const auto content = profane::bin::Read(in);
+        const auto& dictionary = content.dictionary;
+
+        Check(dictionary[content.programNameIdx] == "round_trip_test" && dictionary[content.descriptionIdx] == "Every column", "the program name and the description are read");
+        Check(content.minSpanDurationNs == 250 && content.spanOverheadNs == 31 && content.droppedEventCount == 77, "the manifest is read");
+        Check(content.workItems.size() == WorkItemCount, "every work item is read");
+
+        bool timesMatch = true;
+        bool namesMatch = true;
+        bool taskIdsFlagsMatch = true;
+        bool argsMatch = true;
+        bool metricsMatch = true;
+
+        for (size_t itemIdx = 0; itemIdx < std::min<size_t>(workItems.size(), content.workItems.size()); ++itemIdx)
+        {
+            const auto& expected = workItems[itemIdx];
+            const auto& workItem = content.workItems[itemIdx];
+
+            using std::chrono::duration_cast;
+            using std::chrono::nanoseconds;
+            timesMatch = timesMatch
+                && workItem.startTimeNs == static_cast<uint64_t>(duration_cast<nanoseconds>(expected.startTime.time_since_epoch()).count())
+                && workItem.stopTimeNs == static_cast<uint64_t>(duration_cast<nanoseconds>(expected.stopTime.time_since_epoch()).count());
+
+            const bool registered = expected.routineId != 0;
+            namesMatch = namesMatch
+                && dictionary[workItem.workerNameIdx] == (registered ? "Registered" : expected.workerName)
+                && dictionary[workItem.routineNameIdx] == (registered ? "Routine" : expected.routineName)
+                && dictionary[workItem.categoryNameIdx] == expected.categoryName
+                && dictionary[workItem.commentNameIdx] == expected.comment;
+
+            taskIdsFlagsMatch = taskIdsFlagsMatch && workItem.taskId == expected.taskId && workItem.flags == expected.flags;
+
+            argsMatch = argsMatch && workItem.argCount == expected.args.count;
+            for (uint8_t argIdx = 0; argsMatch && argIdx < workItem.argCount; ++argIdx)
+            {
+                const auto& arg = content.spanArgs[workItem.argsIdx + argIdx];
+                argsMatch = dictionary[arg.nameIdx] == "arg" + std::to_string(argIdx) && arg.value == expected.args.values[argIdx];
+            }
+
+            profane::bin::WorkItemMetrics expectedMetrics;
+            if (profane::bin::MetricsOf(expected, expectedMetrics))
+                metricsMatch = metricsMatch && workItem.metricsIdx != profane::bin::NoMetrics && MetricsMatch(expected, content.workItemMetrics[workItem.metricsIdx]);
+            else
+                metricsMatch = metricsMatch && workItem.metricsIdx == profane::bin::NoMetrics;
+        }
+
+        Check(timesMatch, "the start and stop times are read");
+        Check(namesMatch, "the worker, routine, category and comment names are read");
+        Check(taskIdsFlagsMatch, "the task identifiers and the flags are read");
+        Check(argsMatch, "the span arguments are read");
+        Check(metricsMatch, "the metrics are read for the work items having them only");
+
+        bool counterSamplesMatch = content.counterSamples.size() == CounterSampleCount;
+        for (size_t sampleIdx = 0; counterSamplesMatch && sampleIdx < CounterSampleCount; ++sampleIdx)
+        {
+            const auto& sample = content.counterSamples[sampleIdx];
+            counterSamplesMatch = sample.timeNs == counterSamples[sampleIdx].timeNs && sample.value == counterSamples[sampleIdx].value
+                && dictionary[sample.counterGroupNameIdx] == "Queue" && dictionary[sample.counterNameIdx] == "depth";
+        }
+
+        Check(counterSamplesMatch, "the counter samples are read");
+
+        bool stackSamplesMatch = content.stackSamples.size() == StackSampleCount;
+        for (uint32_t sampleIdx = 0; stackSamplesMatch && sampleIdx < StackSampleCount; ++sampleIdx)
+        {
+            const auto& sample = content.stackSamples[sampleIdx];
+            const auto frameCount = std::min(1 + sampleIdx % (profane::bin::StackSampleMaxDepth + 8), profane::bin::StackSampleMaxDepth);
+
+            stackSamplesMatch = sample.timeNs == 3000000000000ull + sampleIdx && sample.frameCount == frameCount
+                && dictionary[sample.workerNameIdx] == (sampleIdx % 2 == 0 ? "Registered" : "Sampled");
+            for (uint32_t frameIdx = 0; stackSamplesMatch && frameIdx < sample.frameCount; ++frameIdx)
+                stackSamplesMatch = dictionary[sample.frameNameIdxs[frameIdx]] == "Frame " + std::to_string(frameIdx);
+        }
+
+        Check(stackSamplesMatch, "the stack samples are read, cut off at StackSampleMaxDepth frames");
+
+        Check(content.routineStats.size() == 1 && dictionary[content.routineStats[0].workerNameIdx] == "Registered"
+            && dictionary[content.routineStats[0].routineNameIdx] == "Routine" && content.routineStats[0].samplingMode == profane::SamplingMode::EveryNth
+            && content.routineStats[0].samplingRate == 10.0 && content.routineStats[0].callCount == 1000 && content.routineStats[0].tracedCount == 100
+            && content.routineStats[0].droppedCount == 7 && content.routineStats[0].droppedDurationNs == 12345, "the routine statistics are read");
+    }
+
+    void CheckRoutineAggregates()
+    {
+        const auto routineId = profane::RegisterRoutine("Aggregated.Routine");
+
+        uint64_t bucketCounts[profane::bin::DurationBucketCount] = {};
+        for (uint32_t bucketIdx = 0; bucketIdx < profane::bin::DurationBucketCount; bucketIdx += 7)
+            bucketCounts[bucketIdx] = bucketIdx + 1;
+
+        std::ostringstream out;
+        {
+            profane::bin::BinaryWriter writer{out, "round_trip_test", "Aggregates"};
+            writer.AddRoutineAggregate(routineId, 1234, 5678900, 12, 345678, 0.5, bucketCounts);
+            writer.SetUnaggregatedSpanCount(5);
+            writer.Finish();
+        }
+
+        std::istringstream in{out.str()};
+        const auto content = profane::bin::Read(in);
+
+        Check(content.workItems.empty() && content.unaggregatedSpanCount == 5, "the unaggregated span count is read");
+        Check(content.routineAggregates.size() == 1, "the routine aggregate is read");
+
+        if (content.routineAggregates.size() == 1)
+        {
+            const auto& aggregate = content.routineAggregates[0];
+            Check(content.dictionary[aggregate.workerNameIdx] == "Aggregated" && content.dictionary[aggregate.routineNameIdx] == "Routine"
+                && aggregate.callCount == 1234 && aggregate.totalDurationNs == 5678900 && aggregate.minDurationNs == 12 && aggregate.maxDurationNs == 345678
+                && aggregate.nsPerTick == 0.5 && std::equal(std::begin(bucketCounts), std::end(bucketCounts), std::begin(aggregate.bucketCounts)),
+                "the columns of the routine aggregate are read");
+        }
+    }
+}
+
+int main()
+{
+    CheckWorkItemsAndSamples();
+    CheckRoutineAggregates();
+
+    return (failureCount == 0) ? 0 : 1;
+}
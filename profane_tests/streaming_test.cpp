@@ -0,0 +1,76 @@
+// Checks that RecordingMode::Streaming accounts for every traced span, either written or counted as dropped, however many more of them are traced than the event pool holds.
+
+#include <profane/profane.h>
+
+#include <sstream>
+
+namespace
+{
+    int failureCount = 0;
+
+    void Check(bool condition, const char* description)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED: " << description << std::endl;
+            ++failureCount;
+        }
+    }
+}
+
+int main()
+{
+    using Logger = profane::PerfLogger<profane::ActorBasedTraits>;
+
+    constexpr uint32_t ThreadCount = 4;
+    constexpr uint32_t SpansPerThread = 50000;
+    constexpr uint32_t EventCount = 4096;
+
+    std::ostringstream out;
+    Logger logger;
+    logger.EventsPerChunk = 256;
+    logger.Enable(out, EventCount, profane::RecordingMode::Streaming);
+
+    const auto outerId = profane::RegisterRoutine("Test.Outer");
+    const auto innerId = profane::RegisterRoutine("Test.Inner");
+    const auto asyncId = profane::RegisterRoutine("Test.Async");
+
+    std::vector<std::thread> threads;
+
+    for (uint32_t threadIdx = 0; threadIdx < ThreadCount; ++threadIdx)
+    {
+        threads.emplace_back([&]() {
+            for (uint32_t spanIdx = 0; spanIdx < SpansPerThread / 4; ++spanIdx)
+            {
+                auto outer = logger.Trace(outerId);
+
+                {
+                    auto inner = logger.Trace(innerId);
+                }
+
+                // Stopped out of order.
+                auto inner = logger.Trace(innerId);
+                outer.Stop();
+                inner.Stop();
+
+                auto asyncSpan = logger.TraceAsync(asyncId);
+                asyncSpan.End();
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    logger.Finish();
+
+    std::istringstream in{out.str()};
+    const auto content = profane::bin::Read(in);
+
+    const uint64_t tracedCount = ThreadCount * SpansPerThread;
+
+    Check(content.workItems.size() > EventCount, "the chunks are recycled once written");
+    Check(content.workItems.size() + content.droppedEventCount == tracedCount, "every span is either written or counted as dropped");
+
+    return (failureCount == 0) ? 0 : 1;
+}